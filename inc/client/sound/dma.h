@@ -47,3 +47,7 @@ extern dma_t    dma;
 extern int      s_paintedtime;
 
 extern cvar_t   *s_khz;
+
+#if USE_TESTS
+int DMA_TestMixer(int repeat);
+#endif
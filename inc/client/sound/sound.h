@@ -37,6 +37,7 @@ void S_Activate(void);
 void S_BeginRegistration(void);
 qhandle_t S_RegisterSound(const char *sample);
 void S_EndRegistration(void);
+void S_FinishRegistration(void);
 
 void OGG_Play(void);
 void OGG_Stop(void);
@@ -96,6 +96,7 @@ int FS_FPrintf(qhandle_t f, const char *format, ...) q_printf(2, 3);
 int FS_ReadLine(qhandle_t f, char *buffer, size_t size);
 
 int FS_Flush(qhandle_t f);
+unsigned FS_WriteStalls(qhandle_t f);
 
 int64_t FS_Tell(qhandle_t f);
 int FS_Seek(qhandle_t f, int64_t offset, int whence);
@@ -39,6 +39,8 @@ typedef struct netchan_s {
     int         dropped;            // between last packet and previous
     unsigned    total_dropped;      // for statistics
     unsigned    total_received;
+    unsigned    total_fragments;    // outgoing fragments sent
+    unsigned    total_retransmits;  // reliable messages resent
 
     unsigned    last_received;      // for timeouts
     unsigned    last_sent;          // for retransmits
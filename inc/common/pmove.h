@@ -43,6 +43,7 @@ typedef struct {
 } pmoveParams_t;
 
 void Pmove(pmove_t *pmove, pmoveParams_t *params);
+void PmoveBatch(pmove_t **moves, int count, pmoveParams_t *params);
 
 void PmoveInit(pmoveParams_t *pmp);
 void PmoveEnableQW(pmoveParams_t *pmp);
@@ -24,7 +24,7 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 
 #define MAX_DLIGHTS     32
 #define MAX_ENTITIES    2048
-#define MAX_PARTICLES   16384
+#define MAX_PARTICLES   65536
 #define MAX_LIGHTSTYLES 256
 
 #define POWERSUIT_SCALE     4.0f
@@ -28,6 +28,7 @@ void MVD_Register(void);
 void MVD_Shutdown(void);
 void MVD_RemoveClient(struct client_s *client);
 int MVD_Frame(void);
+bool MVD_ConvertFrame(void);
 void MVD_PrepWorldFrame(void);
 
 void MVD_GameClientDrop(edict_t *ent, const char *prefix, const char *reason);
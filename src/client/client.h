@@ -127,6 +127,12 @@ typedef struct centity_s {
 
 extern centity_t    cl_entities[MAX_EDICTS];
 
+// world space bounds of a solid entity, for trace culling
+typedef struct {
+    vec3_t      absmin, absmax;
+    int         index;              // into cl.solidEntities
+} csolid_t;
+
 #define MAX_CLIENTWEAPONMODELS        256       // PGM -- upped from 16 to fit the chainfist vwep
 
 typedef struct clientinfo_s {
@@ -203,6 +209,12 @@ typedef struct client_state_s {
     usercmd_t    cmds[CMD_BACKUP];    // each mesage will send several old cmds
     unsigned     cmdNumber;
     short        predicted_origins[CMD_BACKUP][3];    // for debug comparing against server
+    pmove_state_t   predicted_states[CMD_BACKUP];       // pmove results of committed cmds
+    vec3_t          predicted_viewangles[CMD_BACKUP];
+    bool            predicted_valid;    // predicted_states are based on the current frame
+    int             predicted_frame;    // server frame number they were built from
+    unsigned        predicted_ack;      // acknowledged cmd they were built from
+    unsigned        predicted_last;     // last cmd number in predicted_states
     client_history_t    history[CMD_BACKUP];
     int         initialSeq;
 
@@ -218,6 +230,9 @@ typedef struct client_state_s {
     // rebuilt each valid frame
     centity_t       *solidEntities[MAX_PACKET_ENTITIES];
     int             numSolidEntities;
+    csolid_t        solidBounds[MAX_PACKET_ENTITIES];   // sorted by absmin[0]
+    int             numSolidBounds;
+    float           solidMaxWidth;      // largest absmax[0] - absmin[0]
 
     centity_state_t baselines[MAX_EDICTS];
 
@@ -424,14 +439,16 @@ typedef struct client_static_s {
 #define R_FPS   cls.measure.fps[1]
 #define C_MPS   cls.measure.fps[2]
 #define C_PPS   cls.measure.fps[3]
+#define C_PMPS  cls.measure.fps[4]
 #define C_FRAMES    cls.measure.frames[0]
 #define R_FRAMES    cls.measure.frames[1]
 #define M_FRAMES    cls.measure.frames[2]
 #define P_FRAMES    cls.measure.frames[3]
+#define PM_FRAMES   cls.measure.frames[4]
     struct {
         unsigned    time;
-        int         frames[4];
-        int         fps[4];
+        int         frames[5];
+        int         fps[5];
         int         ping;
     } measure;
 
@@ -486,6 +503,10 @@ typedef struct client_static_s {
         qhandle_t   recording;
         unsigned    time_start;
         unsigned    time_frames;
+        unsigned    bench_msec;         // time spent in demobench loop
+        unsigned    bench_frames;       // number of frames interpolated
+        unsigned    bench_messages;     // number of messages parsed
+        size_t      bench_allocs;       // number of Z_Malloc/Z_Realloc calls made
         int         last_server_frame;  // number of server frame the last svc_frame was written
         int         frames_written;     // number of frames written to demo file
         int         frames_dropped;     // number of svc_frames that didn't fit
@@ -498,9 +519,15 @@ typedef struct client_static_s {
         sizebuf_t   buffer;
         demosnap_t  **snapshots;
         int         numsnapshots;
+        char        indexname[MAX_OSPATH];  // seek index file name
+        bool        indexed;    // snapshots cover the whole demo
+        bool        indexing;   // don't finish demo on EOF
+        bool        indexfailed;    // don't retry writing index
+        uint32_t    checksum;   // of demo contents, for index validation
         bool        paused;
         bool        seeking;
         bool        eof;
+        bool        benchmark;  // parse without rendering
         msgEsFlags_t    esFlags;        // for snapshots/recording
     } demo;
     struct {
@@ -695,6 +722,7 @@ void CL_RegisterSounds(void);
 void CL_RegisterBspModels(void);
 void CL_RegisterVWepModels(void);
 void CL_PrepRefresh(void);
+void CL_PrepLevel(void);
 void CL_UpdateConfigstring(int index);
 
 
@@ -804,6 +832,7 @@ extern qhandle_t    gun_model;
 void V_Init(void);
 void V_Shutdown(void);
 void V_RenderView(void);
+void V_ClearScene(void);
 void V_AddEntity(entity_t *ent);
 void V_AddParticle(particle_t *p);
 void V_AddLight(const vec3_t org, float intensity, float r, float g, float b);
@@ -849,6 +878,7 @@ void CL_InitTEnts(void);
 void CL_PredictAngles(void);
 void CL_PredictMovement(void);
 void CL_CheckPredictionError(void);
+void CL_LinkSolidEntities(void);
 void CL_Trace(trace_t *tr, const vec3_t start, const vec3_t mins, const vec3_t maxs, const vec3_t end, int contentmask);
 
 
@@ -860,8 +890,6 @@ void CL_Trace(trace_t *tr, const vec3_t start, const vec3_t mins, const vec3_t m
 #define INSTANT_PARTICLE    -10000.0f
 
 typedef struct cparticle_s {
-    struct cparticle_s    *next;
-
     float   time;
 
     vec3_t  org;
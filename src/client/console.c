@@ -79,6 +79,8 @@ typedef struct console_s {
     char *remotePassword;
 
     load_state_t loadstate;
+    unsigned    loadstart;                  // when current load state was entered
+    unsigned    loadtimes[LOAD_SOUNDS + 1]; // msec spent in each load state
 } console_t;
 
 static console_t    con;
@@ -554,14 +556,52 @@ void Con_SetColor(color_index_t color)
     con.color = color;
 }
 
+static const char *const load_names[LOAD_SOUNDS + 1] = {
+    NULL, "map", "models", "images", "clients", "sounds"
+};
+
+static void Con_FormatLoadTimes(char *buffer, size_t size)
+{
+    size_t len = 0;
+
+    *buffer = 0;
+    for (int i = LOAD_MAP; i <= LOAD_SOUNDS; i++) {
+        if (!con.loadtimes[i])
+            continue;
+        len += Q_scnprintf(buffer + len, size - len, "%s%s %u",
+                           len ? ", " : "", load_names[i], con.loadtimes[i]);
+    }
+
+    if (len)
+        Q_strlcat(buffer, " ms", size);
+}
+
 /*
 =================
 CL_LoadState
+
+Time spent in each state is accumulated, since level loading may enter
+a state more than once.
 =================
 */
 void CL_LoadState(load_state_t state)
 {
+    unsigned now = Sys_Milliseconds();
+
+    if (con.loadstate == LOAD_NONE) {
+        memset(con.loadtimes, 0, sizeof(con.loadtimes));
+    } else {
+        con.loadtimes[con.loadstate] += now - con.loadstart;
+        if (state == LOAD_NONE) {
+            char buffer[MAX_STRING_CHARS];
+
+            Con_FormatLoadTimes(buffer, sizeof(buffer));
+            Com_DPrintf("Loaded %s: %s\n", cl.mapname, buffer);
+        }
+    }
+
     con.loadstate = state;
+    con.loadstart = now;
     SCR_UpdateScreen();
     if (vid.pump_events)
         vid.pump_events();
@@ -926,7 +966,13 @@ static void Con_DrawSolidConsole(void)
         }
 
         if (text) {
-            Q_snprintf(buffer, sizeof(buffer), "Loading %s...", text);
+            char times[MAX_QPATH * 2];
+
+            Con_FormatLoadTimes(times, sizeof(times));
+            if (*times)
+                Q_snprintf(buffer, sizeof(buffer), "Loading %s... (%s)", text, times);
+            else
+                Q_snprintf(buffer, sizeof(buffer), "Loading %s...", text);
 
             // draw it
             y = vislines - CON_PRESTEP + CHAR_HEIGHT * 2;
@@ -21,6 +21,8 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 //
 
 #include "client.h"
+#include "common/intreadwrite.h"
+#include "common/mdfour.h"
 
 static byte     demo_buffer[MAX_MSGLEN];
 
@@ -28,6 +30,10 @@ static cvar_t   *cl_demosnaps;
 static cvar_t   *cl_demomsglen;
 static cvar_t   *cl_demowait;
 static cvar_t   *cl_demosuspendtoggle;
+static cvar_t   *cl_demoindex;
+
+#define MIN_SNAPSHOTS   64
+#define MAX_SNAPSHOTS   250000000
 
 // =========================================================================
 
@@ -240,6 +246,7 @@ static size_t format_demo_status(char *buffer, size_t size)
 {
     size_t len = format_demo_size(buffer, size);
     int min, sec, frames = cls.demo.frames_written;
+    unsigned stalls;
 
     sec = frames / 10; frames %= 10;
     min = sec / 60; sec %= 60;
@@ -259,6 +266,12 @@ static size_t format_demo_status(char *buffer, size_t size)
                            cls.demo.others_dropped == 1 ? "" : "s");
     }
 
+    stalls = FS_WriteStalls(cls.demo.recording);
+    if (stalls) {
+        len += Q_scnprintf(buffer + len, size - len, ", %u write stall%s",
+                           stalls, stalls == 1 ? "" : "s");
+    }
+
     return len;
 }
 
@@ -326,7 +339,7 @@ static void CL_Record_f(void)
     entity_packed_t pack;
     char            *s;
     qhandle_t       f;
-    unsigned        mode = FS_MODE_WRITE;
+    unsigned        mode = FS_MODE_WRITE | FS_FLAG_ASYNC;
     size_t          size = Cvar_ClampInteger(
                                cl_demomsglen,
                                MIN_PACKETLEN,
@@ -630,6 +643,162 @@ static int read_next_message(qhandle_t f)
     return 1;
 }
 
+/*
+====================
+Demo seek index
+
+Snapshots built during playback are saved into a sidecar file once the
+end of demo is reached, and loaded back when the demo is played again, so
+that seeking in any direction doesn't need to parse the whole demo.
+====================
+*/
+
+#define DEMO_INDEX_MAGIC    MakeRawLong('D','I','D','X')
+#define DEMO_INDEX_VERSION  2
+
+#define DEMO_INDEX_HEADER   36
+#define DEMO_INDEX_SNAP     16
+#define DEMO_INDEX_SAMPLE   0x10000
+
+static void write_index_header(byte *p)
+{
+    WL32(p +  0, DEMO_INDEX_MAGIC);
+    WL32(p +  4, DEMO_INDEX_VERSION);
+    WL64(p +  8, cls.demo.file_offset);
+    WL64(p + 16, cls.demo.file_size);
+    WL32(p + 24, cls.demo.esFlags);
+    WL32(p + 28, cls.demo.checksum);
+    WL32(p + 32, cls.demo.numsnapshots);
+}
+
+// checksum of the first and last blocks of demo, so that a demo
+// re-recorded to the same size doesn't pick up a stale index
+static uint32_t demo_checksum(void)
+{
+    qhandle_t f = cls.demo.playback;
+    int64_t pos = FS_Tell(f);
+    int64_t len = min(cls.demo.file_size, DEMO_INDEX_SAMPLE);
+    byte *buf = Z_Malloc(len * 2);
+    uint32_t sum = 0;
+
+    if (FS_Seek(f, cls.demo.file_offset, SEEK_SET) >= 0 &&
+        FS_Read(buf, len, f) == len &&
+        FS_Seek(f, cls.demo.file_offset + cls.demo.file_size - len, SEEK_SET) >= 0 &&
+        FS_Read(buf + len, len, f) == len)
+        sum = Com_BlockChecksum(buf, len * 2);
+
+    FS_Seek(f, pos, SEEK_SET);
+    Z_Free(buf);
+    return sum;
+}
+
+static void save_demo_index(void)
+{
+    byte buffer[DEMO_INDEX_HEADER];
+    demosnap_t *snap;
+    qhandle_t f;
+    int i, ret;
+
+    if (cls.demo.indexed || cls.demo.indexfailed || !cls.demo.numsnapshots || !cls.demo.file_size)
+        return;
+
+    // don't retry on every EOF
+    cls.demo.indexfailed = true;
+
+    ret = FS_OpenFile(cls.demo.indexname, &f, FS_MODE_WRITE);
+    if (!f) {
+        Com_EPrintf("Couldn't write %s: %s\n", cls.demo.indexname, Q_ErrorString(ret));
+        return;
+    }
+
+    write_index_header(buffer);
+    FS_Write(buffer, DEMO_INDEX_HEADER, f);
+
+    for (i = 0; i < cls.demo.numsnapshots; i++) {
+        snap = cls.demo.snapshots[i];
+        WL64(buffer + 0, snap->filepos);
+        WL32(buffer + 8, snap->framenum);
+        WL32(buffer + 12, snap->msglen);
+        FS_Write(buffer, DEMO_INDEX_SNAP, f);
+        FS_Write(snap->data, snap->msglen, f);
+    }
+
+    ret = FS_CloseFile(f);
+    if (ret < 0) {
+        Com_EPrintf("Couldn't write %s: %s\n", cls.demo.indexname, Q_ErrorString(ret));
+        return;
+    }
+
+    Com_DPrintf("Wrote %d snapshots to %s\n", cls.demo.numsnapshots, cls.demo.indexname);
+    cls.demo.indexfailed = false;
+    cls.demo.indexed = true;
+}
+
+static void load_demo_index(void)
+{
+    byte header[DEMO_INDEX_HEADER];
+    demosnap_t *snap;
+    byte *data, *p, *end;
+    uint32_t i, count;
+    size_t msglen;
+    int len;
+
+    cls.demo.indexed = false;
+
+    if (cl_demoindex->integer <= 0)
+        return;
+
+    len = FS_LoadFile(cls.demo.indexname, (void **)&data);
+    if (!data)
+        return;
+
+    write_index_header(header);
+    if (len < DEMO_INDEX_HEADER || memcmp(data, header, DEMO_INDEX_HEADER - 4)) {
+        Com_DPrintf("Ignoring stale %s\n", cls.demo.indexname);
+        goto done;
+    }
+
+    count = RL32(data + 32);
+    if (!count) {
+        goto done;
+    }
+
+    p = data + DEMO_INDEX_HEADER;
+    end = data + len;
+
+    CL_FreeDemoSnapshots();
+
+    for (i = 0; i < count; i++) {
+        if (end - p < DEMO_INDEX_SNAP)
+            break;
+        msglen = RL32(p + 12);
+        if (end - p - DEMO_INDEX_SNAP < msglen || msglen > MAX_MSGLEN)
+            break;
+
+        snap = Z_Malloc(sizeof(*snap) + msglen - 1);
+        snap->filepos = RL64(p);
+        snap->framenum = RL32(p + 8);
+        snap->msglen = msglen;
+        memcpy(snap->data, p + DEMO_INDEX_SNAP, msglen);
+        p += DEMO_INDEX_SNAP + msglen;
+
+        cls.demo.snapshots = Z_Realloc(cls.demo.snapshots, sizeof(snap) * ALIGN(cls.demo.numsnapshots + 1, MIN_SNAPSHOTS));
+        cls.demo.snapshots[cls.demo.numsnapshots++] = snap;
+    }
+
+    if (i < count) {
+        Com_WPrintf("%s is truncated\n", cls.demo.indexname);
+        CL_FreeDemoSnapshots();
+        goto done;
+    }
+
+    Com_DPrintf("Loaded %d snapshots from %s\n", cls.demo.numsnapshots, cls.demo.indexname);
+    cls.demo.indexed = true;
+
+done:
+    FS_FreeFile(data);
+}
+
 static void finish_demo(int ret)
 {
     const char *s = Cvar_VariableString("nextserver");
@@ -671,6 +840,9 @@ static int parse_next_message(int wait)
     int ret;
 
     ret = read_next_message(cls.demo.playback);
+    if (ret == 0 && cl_demoindex->integer > 0) {
+        save_demo_index();
+    }
     if (ret < 0 || (ret == 0 && wait == 0)) {
         finish_demo(ret);
         return -1;
@@ -744,6 +916,7 @@ static void CL_PlayDemo_f(void)
     CL_Disconnect(ERR_RECONNECT);
 
     cls.demo.playback = f;
+    Q_concat(cls.demo.indexname, sizeof(cls.demo.indexname), name, ".idx");
     cls.state = ca_connected;
     Q_strlcpy(cls.servername, COM_SkipPath(name), sizeof(cls.servername));
     cls.serverAddress.type = NA_LOOPBACK;
@@ -761,6 +934,39 @@ static void CL_PlayDemo_f(void)
     }
 }
 
+/*
+====================
+CL_DemoBench_f
+
+Plays back demos without rendering as fast as possible, measuring parsing
+and entity interpolation throughput. Remaining demos are chained through
+`nextserver'.
+====================
+*/
+static void CL_DemoBench_f(void)
+{
+    char buffer[MAX_STRING_CHARS];
+
+    if (Cmd_Argc() < 2) {
+        Com_Printf("Usage: %s <filename> [...]\n", Cmd_Argv(0));
+        return;
+    }
+
+    if (Cmd_Argc() > 2) {
+        Q_concat(buffer, sizeof(buffer), Cmd_Argv(0), " ", Cmd_ArgsFrom(2));
+    } else {
+        buffer[0] = 0;
+    }
+
+    CL_PlayDemo_f();
+    if (!cls.demo.playback) {
+        return;
+    }
+
+    cls.demo.benchmark = true;
+    Cvar_Set("nextserver", buffer);
+}
+
 static void CL_Demo_c(genctx_t *ctx, int argnum)
 {
     if (argnum == 1) {
@@ -768,9 +974,6 @@ static void CL_Demo_c(genctx_t *ctx, int argnum)
     }
 }
 
-#define MIN_SNAPSHOTS   64
-#define MAX_SNAPSHOTS   250000000
-
 /*
 ====================
 CL_EmitDemoSnapshot
@@ -904,6 +1107,8 @@ void CL_FirstDemoFrame(void)
     if (ofs > 0 && ofs < len) {
         cls.demo.file_offset = ofs;
         cls.demo.file_size = len - ofs;
+        if (cl_demoindex->integer > 0)
+            cls.demo.checksum = demo_checksum();
     }
 
     // begin timedemo
@@ -918,8 +1123,13 @@ void CL_FirstDemoFrame(void)
         cls.demo.time_start = Sys_Milliseconds();
     }
 
-    // force initial snapshot
-    cls.demo.last_snapshot = INT_MIN;
+    // use snapshots saved by previous playback, or force initial snapshot
+    load_demo_index();
+    if (cls.demo.indexed) {
+        cls.demo.last_snapshot = cls.demo.snapshots[cls.demo.numsnapshots - 1]->framenum;
+    } else {
+        cls.demo.last_snapshot = INT_MIN;
+    }
 }
 
 /*
@@ -938,81 +1148,15 @@ void CL_FreeDemoSnapshots(void)
 
 /*
 ====================
-CL_Seek_f
+seek_demo
 ====================
 */
-static void CL_Seek_f(void)
+static void seek_demo(int64_t dest, bool byte_seek, bool back_seek)
 {
     demosnap_t *snap;
-    int i, j, ret, index, frames, prev;
-    int64_t dest;
-    bool byte_seek, back_seek;
+    int i, j, ret, index, prev;
     char *from, *to;
 
-    if (Cmd_Argc() < 2) {
-        Com_Printf("Usage: %s [+-]<timespec|percent>[%%]\n", Cmd_Argv(0));
-        return;
-    }
-
-#if USE_MVD_CLIENT
-    if (sv_running->integer == ss_broadcast) {
-        Cbuf_InsertText(&cmd_buffer, va("mvdseek \"%s\" @@\n", Cmd_Argv(1)));
-        return;
-    }
-#endif
-
-    if (!cls.demo.playback) {
-        Com_Printf("Not playing a demo.\n");
-        return;
-    }
-
-    to = Cmd_Argv(1);
-
-    if (strchr(to, '%')) {
-        char *suf;
-        float percent = strtof(to, &suf);
-        if (suf == to || strcmp(suf, "%") || !isfinite(percent)) {
-            Com_Printf("Invalid percentage.\n");
-            return;
-        }
-
-        if (!cls.demo.file_size) {
-            Com_Printf("Unknown file size, can't seek.\n");
-            return;
-        }
-
-        percent = Q_clipf(percent, 0, 100);
-        dest = cls.demo.file_offset + cls.demo.file_size * percent / 100;
-
-        byte_seek = true;
-        back_seek = dest < FS_Tell(cls.demo.playback);
-    } else {
-        if (*to == '-' || *to == '+') {
-            // relative to current frame
-            if (!Com_ParseTimespec(to + 1, &frames)) {
-                Com_Printf("Invalid relative timespec.\n");
-                return;
-            }
-            if (*to == '-')
-                frames = -frames;
-            dest = cls.demo.frames_read + frames;
-        } else {
-            // relative to first frame
-            if (!Com_ParseTimespec(to, &i)) {
-                Com_Printf("Invalid absolute timespec.\n");
-                return;
-            }
-            dest = i;
-            frames = i - cls.demo.frames_read;
-        }
-
-        if (!frames)
-            return; // already there
-
-        byte_seek = false;
-        back_seek = frames < 0;
-    }
-
     if (!back_seek && cls.demo.eof && cl_demowait->integer)
         return; // already at end
 
@@ -1034,6 +1178,10 @@ static void CL_Seek_f(void)
     if (back_seek || cls.demo.last_snapshot > cls.demo.frames_read) {
         snap = find_snapshot(dest, byte_seek);
 
+        // don't go back if seeking forward from after the snapshot
+        if (snap && !back_seek && snap->framenum <= cls.demo.frames_read)
+            snap = NULL;
+
         if (snap) {
             Com_DPrintf("found snap at %d\n", snap->framenum);
             ret = FS_Seek(cls.demo.playback, snap->filepos, SEEK_SET);
@@ -1076,7 +1224,10 @@ static void CL_Seek_f(void)
             break;
 
         ret = read_next_message(cls.demo.playback);
-        if (ret == 0 && cl_demowait->integer) {
+        if (ret == 0 && cl_demoindex->integer > 0) {
+            save_demo_index();
+        }
+        if (ret == 0 && (cl_demowait->integer || cls.demo.indexing)) {
             cls.demo.eof = true;
             break;
         }
@@ -1131,6 +1282,132 @@ done:
     cls.demo.seeking = false;
 }
 
+/*
+====================
+CL_Seek_f
+====================
+*/
+static void CL_Seek_f(void)
+{
+    int i, frames;
+    int64_t dest;
+    bool byte_seek, back_seek;
+    char *to;
+
+    if (Cmd_Argc() < 2) {
+        Com_Printf("Usage: %s [+-]<timespec|percent>[%%]\n", Cmd_Argv(0));
+        return;
+    }
+
+#if USE_MVD_CLIENT
+    if (sv_running->integer == ss_broadcast) {
+        Cbuf_InsertText(&cmd_buffer, va("mvdseek \"%s\" @@\n", Cmd_Argv(1)));
+        return;
+    }
+#endif
+
+    if (!cls.demo.playback) {
+        Com_Printf("Not playing a demo.\n");
+        return;
+    }
+
+    to = Cmd_Argv(1);
+
+    if (strchr(to, '%')) {
+        char *suf;
+        float percent = strtof(to, &suf);
+        if (suf == to || strcmp(suf, "%") || !isfinite(percent)) {
+            Com_Printf("Invalid percentage.\n");
+            return;
+        }
+
+        if (!cls.demo.file_size) {
+            Com_Printf("Unknown file size, can't seek.\n");
+            return;
+        }
+
+        percent = Q_clipf(percent, 0, 100);
+        dest = cls.demo.file_offset + cls.demo.file_size * percent / 100;
+
+        byte_seek = true;
+        back_seek = dest < FS_Tell(cls.demo.playback);
+    } else {
+        if (*to == '-' || *to == '+') {
+            // relative to current frame
+            if (!Com_ParseTimespec(to + 1, &frames)) {
+                Com_Printf("Invalid relative timespec.\n");
+                return;
+            }
+            if (*to == '-')
+                frames = -frames;
+            dest = cls.demo.frames_read + frames;
+        } else {
+            // relative to first frame
+            if (!Com_ParseTimespec(to, &i)) {
+                Com_Printf("Invalid absolute timespec.\n");
+                return;
+            }
+            dest = i;
+            frames = i - cls.demo.frames_read;
+        }
+
+        if (!frames)
+            return; // already there
+
+        byte_seek = false;
+        back_seek = frames < 0;
+    }
+
+    seek_demo(dest, byte_seek, back_seek);
+}
+
+/*
+====================
+CL_DemoIndex_f
+
+Builds seek index for the demo being played by skipping to the end of it
+and saves it immediately, instead of waiting for playback to finish.
+====================
+*/
+static void CL_DemoIndex_f(void)
+{
+    int frames;
+
+    if (!cls.demo.playback) {
+        Com_Printf("Not playing a demo.\n");
+        return;
+    }
+
+    if (cls.demo.indexed) {
+        Com_Printf("%s is up to date.\n", cls.demo.indexname);
+        return;
+    }
+
+    if (!cls.demo.file_size) {
+        Com_Printf("Unknown file size, can't index.\n");
+        return;
+    }
+
+    if (cl_demosnaps->integer <= 0) {
+        Com_Printf("Demo snapshots are disabled.\n");
+        return;
+    }
+
+    // skip to the end and return back
+    frames = cls.demo.frames_read;
+    cls.demo.indexfailed = false;   // explicit request, try again
+    cls.demo.indexing = true;
+    seek_demo(cls.demo.file_offset + cls.demo.file_size, true, false);
+    cls.demo.indexing = false;
+
+    save_demo_index();
+    seek_demo(frames, false, frames < cls.demo.frames_read);
+
+    if (cls.demo.indexed) {
+        Com_Printf("Wrote %d snapshots to %s.\n", cls.demo.numsnapshots, cls.demo.indexname);
+    }
+}
+
 static void parse_info_string(demoInfo_t *info, int clientNum, int index, const cs_remap_t *csr)
 {
     char string[MAX_QPATH], *p;
@@ -1285,6 +1562,43 @@ void CL_CleanupDemos(void)
     memset(&cls.demo, 0, sizeof(cls.demo));
 }
 
+static void run_benchmark(void)
+{
+    unsigned start = Sys_Milliseconds();
+    size_t allocs = Z_AllocCount();
+    float sec;
+    int framenum;
+
+    while (cls.state == ca_active && !cls.demo.eof) {
+        framenum = cl.frame.number;
+        if (parse_next_message(1))
+            break;
+        cls.demo.bench_messages++;
+
+        if (cl.frame.number == framenum || !cl.frame.valid)
+            continue;
+
+        // build refresh entity list like V_RenderView does
+        cl.time = cl.servertime;
+        V_ClearScene();
+        CL_AddEntities();
+        cls.demo.bench_frames++;
+    }
+
+    cls.demo.bench_msec += Sys_Milliseconds() - start;
+    cls.demo.bench_allocs += Z_AllocCount() - allocs;
+
+    if (!cls.demo.eof)
+        return; // map change, continue on next frame
+
+    sec = max(cls.demo.bench_msec, 1) * 0.001f;
+    Com_Printf("%s: %u frames, %u messages, %.2f seconds: %.1f fps, %.1f msg/s, %zu allocations\n",
+               cls.servername, cls.demo.bench_frames, cls.demo.bench_messages, sec,
+               cls.demo.bench_frames / sec, cls.demo.bench_messages / sec, cls.demo.bench_allocs);
+
+    finish_demo(0);
+}
+
 /*
 ====================
 CL_DemoFrame
@@ -1301,6 +1615,11 @@ void CL_DemoFrame(int msec)
         return;
     }
 
+    if (cls.demo.benchmark) {
+        run_benchmark();
+        return;
+    }
+
     if (com_timedemo->integer) {
         parse_next_message(0);
         cl.time = cl.servertime;
@@ -1332,6 +1651,8 @@ static const cmdreg_t c_demo[] = {
     { "suspend", CL_Suspend_f },
     { "resume", CL_Resume_f },
     { "seek", CL_Seek_f },
+    { "demo_index", CL_DemoIndex_f },
+    { "demobench", CL_DemoBench_f, CL_Demo_c },
 
     { NULL }
 };
@@ -1347,6 +1668,7 @@ void CL_InitDemos(void)
     cl_demomsglen = Cvar_Get("cl_demomsglen", va("%d", MAX_PACKETLEN_WRITABLE_DEFAULT), 0);
     cl_demowait = Cvar_Get("cl_demowait", "0", 0);
     cl_demosuspendtoggle = Cvar_Get("cl_demosuspendtoggle", "1", 0);
+    cl_demoindex = Cvar_Get("cl_demoindex", "1", 0);
 
     Cmd_Register(c_demo);
 }
@@ -833,9 +833,33 @@ PARTICLE MANAGEMENT
 ==============================================================
 */
 
-static cparticle_t  *active_particles, *free_particles;
+/*
+Effects fill in particles through CL_AllocParticle, which hands out
+entries from a staging list. CL_AddParticles then moves new particles
+into packed per-field arrays and updates the whole pool with simple
+loops the compiler can vectorize. Dead particles are removed by moving
+the last particle into their slot, so the pool stays contiguous.
+*/
 
-static cparticle_t  particles[MAX_PARTICLES];
+static cparticle_t  staged_particles[MAX_PARTICLES];
+static int          num_staged_particles;
+
+static struct {
+    float       org[3][MAX_PARTICLES];
+    float       vel[3][MAX_PARTICLES];
+    float       accel[3][MAX_PARTICLES];
+    float       time[MAX_PARTICLES];
+    float       alpha[MAX_PARTICLES];
+    float       alphavel[MAX_PARTICLES];
+    float       brightness[MAX_PARTICLES];
+    int         color[MAX_PARTICLES];
+    color_t     rgba[MAX_PARTICLES];
+    int         count;
+
+    // per frame results
+    float       lifetime[MAX_PARTICLES];
+    float       fade[MAX_PARTICLES];
+} particles;
 
 extern uint32_t d_8to24table[256];
 
@@ -850,28 +874,16 @@ void FX_Init(void)
 
 static void CL_ClearParticles(void)
 {
-    int     i;
-
-    free_particles = &particles[0];
-    active_particles = NULL;
-
-    for (i = 0; i < MAX_PARTICLES - 1; i++)
-        particles[i].next = &particles[i + 1];
-    particles[i].next = NULL;
+    num_staged_particles = 0;
+    particles.count = 0;
 }
 
 cparticle_t *CL_AllocParticle(void)
 {
-    cparticle_t *p;
-
-    if (!free_particles)
+    if (particles.count + num_staged_particles >= MAX_PARTICLES)
         return NULL;
-    p = free_particles;
-    free_particles = p->next;
-    p->next = active_particles;
-    active_particles = p;
 
-    return p;
+    return &staged_particles[num_staged_particles++];
 }
 
 /*
@@ -1917,6 +1929,52 @@ void CL_TeleportParticles(const vec3_t org)
 extern int          r_numparticles;
 extern particle_t   r_particles[MAX_PARTICLES];
 
+// moves particles spawned this frame into the pool
+static void CL_FlushParticles(void)
+{
+    const cparticle_t   *p;
+    int                 i, j, n;
+
+    for (i = 0; i < num_staged_particles; i++) {
+        p = &staged_particles[i];
+        n = particles.count++;
+
+        for (j = 0; j < 3; j++) {
+            particles.org[j][n] = p->org[j];
+            particles.vel[j][n] = p->vel[j];
+            particles.accel[j][n] = p->accel[j];
+        }
+        particles.time[n] = p->time;
+        particles.alpha[n] = p->alpha;
+        particles.alphavel[n] = p->alphavel;
+        particles.brightness[n] = p->brightness;
+        particles.color[n] = p->color;
+        particles.rgba[n] = p->rgba;
+    }
+
+    num_staged_particles = 0;
+}
+
+// removes particle by moving the last one into its place
+static void CL_RemoveParticle(int i)
+{
+    int j, n = --particles.count;
+
+    for (j = 0; j < 3; j++) {
+        particles.org[j][i] = particles.org[j][n];
+        particles.vel[j][i] = particles.vel[j][n];
+        particles.accel[j][i] = particles.accel[j][n];
+    }
+    particles.time[i] = particles.time[n];
+    particles.alpha[i] = particles.alpha[n];
+    particles.alphavel[i] = particles.alphavel[n];
+    particles.brightness[i] = particles.brightness[n];
+    particles.color[i] = particles.color[n];
+    particles.rgba[i] = particles.rgba[n];
+    particles.lifetime[i] = particles.lifetime[n];
+    particles.fade[i] = particles.fade[n];
+}
+
 /*
 ===============
 CL_AddParticles
@@ -1924,67 +1982,53 @@ CL_AddParticles
 */
 void CL_AddParticles(void)
 {
-    cparticle_t     *p, *next;
-    float           alpha;
-    float           time = 0, time2;
-    int             color;
-    cparticle_t     *active, *tail;
+    float           *lifetime = particles.lifetime;
+    float           *fade = particles.fade;
+    float           time, time2, alpha;
+    bool            instant;
+    int             i, count;
     particle_t      *part;
 
-    active = NULL;
-    tail = NULL;
+    CL_FlushParticles();
 
-    for (p = active_particles; p; p = next) {
-        next = p->next;
+    // fade out, instant particles are drawn once at full alpha
+    for (i = 0; i < particles.count; i++) {
+        instant = particles.alphavel[i] == INSTANT_PARTICLE;
+        time = (cl.time - particles.time[i]) * 0.001f;
+        alpha = particles.alpha[i] + time * particles.alphavel[i];
 
-        if (p->alphavel != INSTANT_PARTICLE) {
-            time = (cl.time - p->time) * 0.001f;
-            alpha = p->alpha + time * p->alphavel;
-            if (alpha <= 0) {
-                // faded out
-                p->next = free_particles;
-                free_particles = p;
-                continue;
-            }
-        } else {
-            alpha = p->alpha;
-        }
+        lifetime[i] = time;
+        fade[i] = instant ? particles.alpha[i] : alpha;
+        particles.alpha[i] = instant ? 0.0f : particles.alpha[i];
+        particles.alphavel[i] = instant ? 0.0f : particles.alphavel[i];
+    }
 
-        if (r_numparticles >= MAX_PARTICLES)
-            break;
-        part = &r_particles[r_numparticles++];
-
-        p->next = NULL;
-        if (!tail)
-            active = tail = p;
-        else {
-            tail->next = p;
-            tail = p;
-        }
+    // remove faded out particles
+    for (i = 0; i < particles.count; ) {
+        if (fade[i] <= 0)
+            CL_RemoveParticle(i);
+        else
+            i++;
+    }
 
-        if (alpha > 1.0f)
-            alpha = 1;
-        color = p->color;
+    count = min(particles.count, MAX_PARTICLES - r_numparticles);
+    part = &r_particles[r_numparticles];
+    r_numparticles += count;
 
+    for (i = 0; i < count; i++, part++) {
+        time = lifetime[i];
         time2 = time * time;
 
-        part->origin[0] = p->org[0] + p->vel[0] * time + p->accel[0] * time2;
-        part->origin[1] = p->org[1] + p->vel[1] * time + p->accel[1] * time2;
-        part->origin[2] = p->org[2] + p->vel[2] * time + p->accel[2] * time2;
+        part->origin[0] = particles.org[0][i] + particles.vel[0][i] * time + particles.accel[0][i] * time2;
+        part->origin[1] = particles.org[1][i] + particles.vel[1][i] * time + particles.accel[1][i] * time2;
+        part->origin[2] = particles.org[2][i] + particles.vel[2][i] * time + particles.accel[2][i] * time2;
 
-        part->rgba = p->rgba;
-        part->color = color;
-		part->brightness = p->brightness;
-        part->alpha = alpha;
+        part->rgba = particles.rgba[i];
+        part->color = particles.color[i];
+		part->brightness = particles.brightness[i];
+        part->alpha = min(fade[i], 1.0f);
 		part->radius = 0.f;
-
-        if (p->alphavel == INSTANT_PARTICLE) {
-            p->alphavel = 0.0f;
-            p->alpha = 0.0f;
-        }
     }
-
-    active_particles = active;
 }
 
 
@@ -397,6 +397,9 @@ void CL_DeltaFrame(void)
         parse_entity_update(&cl.entityStates[j]);
     }
 
+    // sort solid entities for prediction traces
+    CL_LinkSolidEntities();
+
     // fire events. due to footstep tracing this must be after updating entities.
     for (i = 0; i < cl.frame.numEntities; i++) {
         j = (cl.frame.firstEntity + i) & PARSE_ENTITIES_MASK;
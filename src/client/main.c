@@ -1678,9 +1678,7 @@ void CL_Begin(void)
 
     Cvar_FixCheats();
 
-    CL_PrepRefresh();
-    CL_LoadState(LOAD_SOUNDS);
-    CL_RegisterSounds();
+    CL_PrepLevel();
     LOC_LoadLocations();
     CL_LoadState(LOAD_NONE);
     cls.state = ca_precached;
@@ -1723,9 +1721,7 @@ static void CL_Precache_f(void)
     // demos use different precache sequence
     if (cls.demo.playback) {
         CL_RegisterBspModels();
-        CL_PrepRefresh();
-        CL_LoadState(LOAD_SOUNDS);
-        CL_RegisterSounds();
+        CL_PrepLevel();
         CL_LoadState(LOAD_NONE);
         cls.state = ca_precached;
         return;
@@ -2245,6 +2241,11 @@ static size_t CL_Pps_m(char *buffer, size_t size)
     return Q_scnprintf(buffer, size, "%i", C_PPS);
 }
 
+static size_t CL_Pmps_m(char *buffer, size_t size)
+{
+    return Q_scnprintf(buffer, size, "%i", C_PMPS);
+}
+
 static size_t CL_Ping_m(char *buffer, size_t size)
 {
     return Q_scnprintf(buffer, size, "%i", cls.measure.ping);
@@ -2422,9 +2423,7 @@ void CL_RestartFilesystem(bool total)
         UI_OpenMenu(UIMENU_DEFAULT);
     } else if (cls_state >= ca_loading && cls_state <= ca_active) {
         CL_LoadState(LOAD_MAP);
-        CL_PrepRefresh();
-        CL_LoadState(LOAD_SOUNDS);
-        CL_RegisterSounds();
+        CL_PrepLevel();
         CL_LoadState(LOAD_NONE);
     } else if (cls_state == ca_cinematic) {
         SCR_ReloadCinematic();
@@ -2913,6 +2912,7 @@ static void CL_InitLocal(void)
     Cmd_AddMacro("r_fps", R_Fps_m);
     Cmd_AddMacro("cl_mps", CL_Mps_m);   // moves per second
     Cmd_AddMacro("cl_pps", CL_Pps_m);   // packets per second
+    Cmd_AddMacro("cl_pmps", CL_Pmps_m); // pmoves per second
     Cmd_AddMacro("cl_ping", CL_Ping_m);
     Cmd_AddMacro("cl_lag", CL_Lag_m);
     Cmd_AddMacro("cl_health", CL_Health_m);
@@ -3060,7 +3060,7 @@ static void CL_MeasureStats(void)
     }
 
     // measure main/refresh frame counts
-    for (i = 0; i < 4; i++) {
+    for (i = 0; i < q_countof(cls.measure.fps); i++) {
         cls.measure.fps[i] = cls.measure.frames[i];
         cls.measure.frames[i] = 0;
     }
@@ -192,10 +192,13 @@ void CL_LoadClientinfo(clientinfo_t *ci, const char *s)
 
 /*
 =================
-CL_RegisterSounds
+CL_QueueSounds
+
+Registers sounds and starts loading them. Decoding may still be running
+on sound loader threads when this returns.
 =================
 */
-void CL_RegisterSounds(void)
+static void CL_QueueSounds(void)
 {
     int i;
     char    *s;
@@ -211,6 +214,17 @@ void CL_RegisterSounds(void)
     S_EndRegistration();
 }
 
+/*
+=================
+CL_RegisterSounds
+=================
+*/
+void CL_RegisterSounds(void)
+{
+    CL_QueueSounds();
+    S_FinishRegistration();
+}
+
 /*
 =================
 CL_RegisterBspModels
@@ -336,24 +350,51 @@ static qhandle_t CL_RegisterImage(const char *s)
 
 /*
 =================
-CL_PrepRefresh
+CL_BeginPrepRefresh
 
-Call before entering a new level, or after changing dlls
+Starts refresh registration and loads client infos, which are needed
+before sounds can be registered.
 =================
 */
-void CL_PrepRefresh(void)
+static bool CL_BeginPrepRefresh(void)
 {
     int         i;
     char        *name;
 
     if (!cls.ref_initialized)
-        return;
+        return false;
     if (!cl.mapname[0])
-        return;     // no map loaded
+        return false;   // no map loaded
 
     // register models, pics, and skins
     R_BeginRegistration(cl.mapname);
 
+    CL_LoadState(LOAD_CLIENTS);
+    for (i = 0; i < MAX_CLIENTS; i++) {
+        name = cl.configstrings[cl.csr.playerskins + i];
+        if (!name[0]) {
+            continue;
+        }
+        CL_LoadClientinfo(&cl.clientinfo[i], name);
+    }
+
+    CL_LoadClientinfo(&cl.baseclientinfo, "unnamed\\male/grunt");
+
+    return true;
+}
+
+/*
+=================
+CL_EndPrepRefresh
+
+Registers models and images and finishes refresh registration.
+=================
+*/
+static void CL_EndPrepRefresh(void)
+{
+    int         i;
+    char        *name;
+
     CL_LoadState(LOAD_MODELS);
 
     CL_RegisterTEntModels();
@@ -389,17 +430,6 @@ void CL_PrepRefresh(void)
         cl.image_precache[i] = CL_RegisterImage(name);
     }
 
-    CL_LoadState(LOAD_CLIENTS);
-    for (i = 0; i < MAX_CLIENTS; i++) {
-        name = cl.configstrings[cl.csr.playerskins + i];
-        if (!name[0]) {
-            continue;
-        }
-        CL_LoadClientinfo(&cl.clientinfo[i], name);
-    }
-
-    CL_LoadClientinfo(&cl.baseclientinfo, "unnamed\\male/grunt");
-
     // set sky textures and speed
     CL_SetSky();
 
@@ -415,6 +445,42 @@ void CL_PrepRefresh(void)
     OGG_Play();
 }
 
+/*
+=================
+CL_PrepRefresh
+
+Call before entering a new level, or after changing dlls
+=================
+*/
+void CL_PrepRefresh(void)
+{
+    if (CL_BeginPrepRefresh())
+        CL_EndPrepRefresh();
+}
+
+/*
+=================
+CL_PrepLevel
+
+Registers all media for a new level. Sound files are read and queued for
+loader threads as soon as client infos are known, so that sound decoding
+overlaps with model and image registration.
+=================
+*/
+void CL_PrepLevel(void)
+{
+    bool ref = CL_BeginPrepRefresh();
+
+    CL_LoadState(LOAD_SOUNDS);
+    CL_QueueSounds();
+
+    if (ref)
+        CL_EndPrepRefresh();
+
+    CL_LoadState(LOAD_SOUNDS);
+    S_FinishRegistration();
+}
+
 /*
 =================
 CL_UpdateConfigstring
@@ -70,6 +70,131 @@ void CL_CheckPredictionError(void)
     VectorScale(delta, 0.125f, cl.prediction_error);
 }
 
+/*
+====================
+CL_LinkSolidEntities
+
+Calculates world space bounds of solid entities and sorts them along X
+axis, so that traces only need to check entities near the swept box.
+Called each time a valid frame is parsed.
+====================
+*/
+static int solidcmp(const void *p1, const void *p2)
+{
+    const csolid_t *s1 = p1;
+    const csolid_t *s2 = p2;
+
+    if (s1->absmin[0] < s2->absmin[0])
+        return -1;
+    if (s1->absmin[0] > s2->absmin[0])
+        return 1;
+    return s1->index - s2->index;
+}
+
+void CL_LinkSolidEntities(void)
+{
+    int         i, j;
+    centity_t   *ent;
+    mmodel_t    *cmodel;
+    csolid_t    *solid;
+    const vec_t *mins, *maxs;
+    float       radius;
+
+    cl.numSolidBounds = 0;
+    cl.solidMaxWidth = 0;
+
+    for (i = 0; i < cl.numSolidEntities; i++) {
+        ent = cl.solidEntities[i];
+
+        if (ent->current.solid == PACKED_BSP) {
+            cmodel = cl.model_clip[ent->current.modelindex];
+            if (!cmodel)
+                continue;
+            mins = cmodel->mins;
+            maxs = cmodel->maxs;
+        } else {
+            mins = ent->mins;
+            maxs = ent->maxs;
+        }
+
+        solid = &cl.solidBounds[cl.numSolidBounds++];
+        solid->index = i;
+
+        if (ent->current.solid == PACKED_BSP && !VectorEmpty(ent->current.angles)) {
+            // expand for rotation
+            radius = RadiusFromBounds(mins, maxs);
+            for (j = 0; j < 3; j++) {
+                solid->absmin[j] = ent->current.origin[j] - radius;
+                solid->absmax[j] = ent->current.origin[j] + radius;
+            }
+        } else {
+            VectorAdd(ent->current.origin, mins, solid->absmin);
+            VectorAdd(ent->current.origin, maxs, solid->absmax);
+        }
+
+        // because movement is clipped an epsilon away from an actual edge,
+        // we must fully check even when bounding boxes don't quite touch
+        for (j = 0; j < 3; j++) {
+            solid->absmin[j] -= 1;
+            solid->absmax[j] += 1;
+        }
+
+        cl.solidMaxWidth = max(cl.solidMaxWidth, solid->absmax[0] - solid->absmin[0]);
+    }
+
+    qsort(cl.solidBounds, cl.numSolidBounds, sizeof(cl.solidBounds[0]), solidcmp);
+}
+
+/*
+====================
+CL_AreaSolids
+
+Fills list with indices of solid entities touching the box, in the
+order of cl.solidEntities, so results match a full walk exactly.
+====================
+*/
+static int CL_AreaSolids(const vec3_t mins, const vec3_t maxs, int *list)
+{
+    int             i, j, count, index;
+    int             lo, hi, mid;
+    const csolid_t  *solid;
+    float           first;
+
+    // nothing before this can reach mins[0]
+    first = mins[0] - cl.solidMaxWidth;
+    lo = 0;
+    hi = cl.numSolidBounds;
+    while (lo < hi) {
+        mid = (lo + hi) / 2;
+        if (cl.solidBounds[mid].absmin[0] < first)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+
+    count = 0;
+    for (i = lo; i < cl.numSolidBounds; i++) {
+        solid = &cl.solidBounds[i];
+        if (solid->absmin[0] > maxs[0])
+            break;
+        if (solid->absmax[0] < mins[0]
+            || solid->absmin[1] > maxs[1]
+            || solid->absmax[1] < mins[1]
+            || solid->absmin[2] > maxs[2]
+            || solid->absmax[2] < mins[2])
+            continue;
+
+        // insertion sort, lists are short
+        index = solid->index;
+        for (j = count; j > 0 && list[j - 1] > index; j--)
+            list[j] = list[j - 1];
+        list[j] = index;
+        count++;
+    }
+
+    return count;
+}
+
 /*
 ====================
 CL_ClipMoveToEntities
@@ -77,14 +202,29 @@ CL_ClipMoveToEntities
 */
 static void CL_ClipMoveToEntities(trace_t *tr, const vec3_t start, const vec3_t mins, const vec3_t maxs, const vec3_t end, int contentmask)
 {
-    int         i;
+    int         i, num;
     trace_t     trace;
     mnode_t     *headnode;
     centity_t   *ent;
     mmodel_t    *cmodel;
+    vec3_t      boxmins, boxmaxs;
+    int         list[MAX_PACKET_ENTITIES];
+
+    // create the bounding box of the entire move
+    for (i = 0; i < 3; i++) {
+        if (end[i] > start[i]) {
+            boxmins[i] = start[i] + mins[i] - 1;
+            boxmaxs[i] = end[i] + maxs[i] + 1;
+        } else {
+            boxmins[i] = end[i] + mins[i] - 1;
+            boxmaxs[i] = start[i] + maxs[i] + 1;
+        }
+    }
 
-    for (i = 0; i < cl.numSolidEntities; i++) {
-        ent = cl.solidEntities[i];
+    num = CL_AreaSolids(boxmins, boxmaxs, list);
+
+    for (i = 0; i < num; i++) {
+        ent = cl.solidEntities[list[i]];
 
         if (ent->current.solid == PACKED_BSP) {
             // special value for bmodel
@@ -132,15 +272,18 @@ static trace_t q_gameabi CL_PMTrace(const vec3_t start, const vec3_t mins, const
 
 static int CL_PointContents(const vec3_t point)
 {
-    int         i;
+    int         i, num;
     centity_t   *ent;
     mmodel_t    *cmodel;
     int         contents;
+    int         list[MAX_PACKET_ENTITIES];
 
     contents = CM_PointContents(point, cl.bsp->nodes);
 
-    for (i = 0; i < cl.numSolidEntities; i++) {
-        ent = cl.solidEntities[i];
+    num = CL_AreaSolids(point, point, list);
+
+    for (i = 0; i < num; i++) {
+        ent = cl.solidEntities[list[i]];
 
         if (ent->current.solid != PACKED_BSP) // special value for bmodel
             continue;
@@ -214,16 +357,40 @@ void CL_PredictMovement(void)
     memset(&pm, 0, sizeof(pm));
     pm.trace = CL_PMTrace;
     pm.pointcontents = CL_PointContents;
-    pm.s = cl.frame.ps.pmove;
+
+    // committed cmds only need to be replayed when the server state they
+    // start from has changed, solid entities are updated at the same time
+    if (cl.predicted_valid && cl.predicted_frame == cl.frame.number &&
+        cl.predicted_ack == ack && cl.predicted_last - ack <= current - ack) {
+        frame = cl.predicted_last;
+        if (frame != ack) {
+            pm.s = cl.predicted_states[frame & CMD_MASK];
+            VectorCopy(cl.predicted_viewangles[frame & CMD_MASK], pm.viewangles);
+        } else {
+            pm.s = cl.frame.ps.pmove;
+        }
+    } else {
+        cl.predicted_valid = true;
+        cl.predicted_frame = cl.frame.number;
+        cl.predicted_ack = ack;
+        frame = ack;
+        pm.s = cl.frame.ps.pmove;
+    }
 
     // run frames
-    while (++ack <= current) {
-        pm.cmd = cl.cmds[ack & CMD_MASK];
+    while (++frame <= current) {
+        pm.cmd = cl.cmds[frame & CMD_MASK];
         Pmove(&pm, &cl.pmp);
+        PM_FRAMES++;
 
         // save for debug checking
-        VectorCopy(pm.s.origin, cl.predicted_origins[ack & CMD_MASK]);
+        VectorCopy(pm.s.origin, cl.predicted_origins[frame & CMD_MASK]);
+
+        // save for the next client frame
+        cl.predicted_states[frame & CMD_MASK] = pm.s;
+        VectorCopy(pm.viewangles, cl.predicted_viewangles[frame & CMD_MASK]);
     }
+    cl.predicted_last = current;
 
     // run pending cmd
     if (cl.cmd.msec) {
@@ -232,6 +399,7 @@ void CL_PredictMovement(void)
         pm.cmd.sidemove = cl.localmove[1];
         pm.cmd.upmove = cl.localmove[2];
         Pmove(&pm, &cl.pmp);
+        PM_FRAMES++;
         frame = current;
 
         // save for debug checking
@@ -19,6 +19,7 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 
 #include "sound.h"
 #include "common/intreadwrite.h"
+#include "system/pthread.h"
 
 #define PAINTBUFFER_SIZE    2048
 
@@ -161,6 +162,153 @@ static void DMA_DropRawSamples(void)
 }
 
 
+/*
+===============================================================================
+
+SIMD HELPERS
+
+Paint and transfer loops process several samples at once where SSE2 or
+NEON is available. Results are bit identical to the scalar loops, which
+are still used for the remaining samples.
+
+===============================================================================
+*/
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+
+#include <emmintrin.h>
+
+#define USE_MIX_SIMD    1
+
+typedef __m128 mixv_t;
+
+// left and right volume for two sample pairs
+static inline mixv_t mix_vol(float left, float right)
+{
+    return _mm_setr_ps(left, right, left, right);
+}
+
+// dst[0..3] += src * vol
+static inline void mix_madd(float *dst, mixv_t src, mixv_t vol)
+{
+    _mm_storeu_ps(dst, _mm_add_ps(_mm_loadu_ps(dst), _mm_mul_ps(src, vol)));
+}
+
+static inline mixv_t mix_dup_lo(mixv_t v)
+{
+    return _mm_unpacklo_ps(v, v);
+}
+
+static inline mixv_t mix_dup_hi(mixv_t v)
+{
+    return _mm_unpackhi_ps(v, v);
+}
+
+// 4 unsigned 8-bit samples
+static inline mixv_t mix_load_u8(const uint8_t *p)
+{
+    __m128i zero = _mm_setzero_si128();
+    __m128i x = _mm_cvtsi32_si128(RN32(p));
+    x = _mm_unpacklo_epi16(_mm_unpacklo_epi8(x, zero), zero);
+    return _mm_cvtepi32_ps(_mm_sub_epi32(x, _mm_set1_epi32(128)));
+}
+
+// 4 signed 16-bit samples
+static inline mixv_t mix_load_s16(const int16_t *p)
+{
+    __m128i x = _mm_loadl_epi64((const __m128i *)p);
+    return _mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpacklo_epi16(x, x), 16));
+}
+
+// 4 sums of unsigned 8-bit sample pairs
+static inline mixv_t mix_load_u8_pairs(const uint8_t *p)
+{
+    __m128i x = _mm_loadl_epi64((const __m128i *)p);
+    x = _mm_sub_epi16(_mm_unpacklo_epi8(x, _mm_setzero_si128()), _mm_set1_epi16(128));
+    return _mm_cvtepi32_ps(_mm_madd_epi16(x, _mm_set1_epi16(1)));
+}
+
+// 4 sums of signed 16-bit sample pairs
+static inline mixv_t mix_load_s16_pairs(const int16_t *p)
+{
+    __m128i x = _mm_loadu_si128((const __m128i *)p);
+    return _mm_cvtepi32_ps(_mm_madd_epi16(x, _mm_set1_epi16(1)));
+}
+
+// truncate 4 sample pairs to 16 bit with saturation
+static inline void mix_store_s16(int16_t *out, const float *in)
+{
+    __m128i lo = _mm_cvttps_epi32(_mm_loadu_ps(in));
+    __m128i hi = _mm_cvttps_epi32(_mm_loadu_ps(in + 4));
+    _mm_storeu_si128((__m128i *)out, _mm_packs_epi32(lo, hi));
+}
+
+#elif defined(__ARM_NEON)
+
+#include <arm_neon.h>
+
+#define USE_MIX_SIMD    1
+
+typedef float32x4_t mixv_t;
+
+static inline mixv_t mix_vol(float left, float right)
+{
+    const float v[4] = { left, right, left, right };
+    return vld1q_f32(v);
+}
+
+// separate multiply and add, to match scalar code
+static inline void mix_madd(float *dst, mixv_t src, mixv_t vol)
+{
+    vst1q_f32(dst, vaddq_f32(vld1q_f32(dst), vmulq_f32(src, vol)));
+}
+
+static inline mixv_t mix_dup_lo(mixv_t v)
+{
+    return vzipq_f32(v, v).val[0];
+}
+
+static inline mixv_t mix_dup_hi(mixv_t v)
+{
+    return vzipq_f32(v, v).val[1];
+}
+
+static inline mixv_t mix_load_u8(const uint8_t *p)
+{
+    uint8x8_t x = vreinterpret_u8_u32(vdup_n_u32(RN32(p)));
+    int16x8_t y = vsubq_s16(vreinterpretq_s16_u16(vmovl_u8(x)), vdupq_n_s16(128));
+    return vcvtq_f32_s32(vmovl_s16(vget_low_s16(y)));
+}
+
+static inline mixv_t mix_load_s16(const int16_t *p)
+{
+    return vcvtq_f32_s32(vmovl_s16(vld1_s16(p)));
+}
+
+static inline mixv_t mix_load_u8_pairs(const uint8_t *p)
+{
+    int16x8_t y = vsubq_s16(vreinterpretq_s16_u16(vmovl_u8(vld1_u8(p))), vdupq_n_s16(128));
+    return vcvtq_f32_s32(vpaddlq_s16(y));
+}
+
+static inline mixv_t mix_load_s16_pairs(const int16_t *p)
+{
+    return vcvtq_f32_s32(vpaddlq_s16(vld1q_s16(p)));
+}
+
+static inline void mix_store_s16(int16_t *out, const float *in)
+{
+    int32x4_t lo = vcvtq_s32_f32(vld1q_f32(in));
+    int32x4_t hi = vcvtq_s32_f32(vld1q_f32(in + 4));
+    vst1q_s16(out, vcombine_s16(vqmovn_s32(lo), vqmovn_s32(hi)));
+}
+
+#else
+
+#define USE_MIX_SIMD    0
+
+#endif
+
 /*
 ===============================================================================
 
@@ -181,7 +329,12 @@ static void TransferStereo16(samplepair_t *samp, int endtime)
 
         // write a linear blast of samples
         int16_t *out = (int16_t *)dma.buffer + (lpos << 1);
-        for (int i = 0; i < count; i++, samp++, out += 2) {
+        int i = 0;
+#if USE_MIX_SIMD
+        for (; i < count - 3; i += 4, samp += 4, out += 8)
+            mix_store_s16(out, &samp->left);
+#endif
+        for (; i < count; i++, samp++, out += 2) {
             out[0] = Q_clip_int16(samp->left);
             out[1] = Q_clip_int16(samp->right);
         }
@@ -328,8 +481,18 @@ PAINTFUNC(PaintMono8)
     float leftvol = ch->leftvol * snd_vol * 256;
     float rightvol = ch->rightvol * snd_vol * 256;
     uint8_t *sfx = sc->data + ch->pos;
+    int i = 0;
+
+#if USE_MIX_SIMD
+    mixv_t vol = mix_vol(leftvol, rightvol);
+    for (; i < count - 3; i += 4, samp += 4, sfx += 4) {
+        mixv_t v = mix_load_u8(sfx);
+        mix_madd(&samp[0].left, mix_dup_lo(v), vol);
+        mix_madd(&samp[2].left, mix_dup_hi(v), vol);
+    }
+#endif
 
-    for (int i = 0; i < count; i++, samp++, sfx++) {
+    for (; i < count; i++, samp++, sfx++) {
         samp->left += (*sfx - 128) * leftvol;
         samp->right += (*sfx - 128) * rightvol;
     }
@@ -340,8 +503,18 @@ PAINTFUNC(PaintStereoDmix8)
     float leftvol = ch->leftvol * snd_vol * (256 * M_SQRT1_2);
     float rightvol = ch->rightvol * snd_vol * (256 * M_SQRT1_2);
     uint8_t *sfx = sc->data + ch->pos * 2;
+    int i = 0;
+
+#if USE_MIX_SIMD
+    mixv_t vol = mix_vol(leftvol, rightvol);
+    for (; i < count - 3; i += 4, samp += 4, sfx += 8) {
+        mixv_t v = mix_load_u8_pairs(sfx);
+        mix_madd(&samp[0].left, mix_dup_lo(v), vol);
+        mix_madd(&samp[2].left, mix_dup_hi(v), vol);
+    }
+#endif
 
-    for (int i = 0; i < count; i++, samp++, sfx += 2) {
+    for (; i < count; i++, samp++, sfx += 2) {
         int sum = (sfx[0] - 128) + (sfx[1] - 128);
         samp->left += sum * leftvol;
         samp->right += sum * rightvol;
@@ -352,8 +525,15 @@ PAINTFUNC(PaintStereoFull8)
 {
     float vol = ch->leftvol * snd_vol * 256;
     uint8_t *sfx = sc->data + ch->pos * 2;
+    int i = 0;
 
-    for (int i = 0; i < count; i++, samp++, sfx += 2) {
+#if USE_MIX_SIMD
+    mixv_t v4 = mix_vol(vol, vol);
+    for (; i < count - 1; i += 2, samp += 2, sfx += 4)
+        mix_madd(&samp->left, mix_load_u8(sfx), v4);
+#endif
+
+    for (; i < count; i++, samp++, sfx += 2) {
         samp->left += (sfx[0] - 128) * vol;
         samp->right += (sfx[1] - 128) * vol;
     }
@@ -364,8 +544,18 @@ PAINTFUNC(PaintMono16)
     float leftvol = ch->leftvol * snd_vol;
     float rightvol = ch->rightvol * snd_vol;
     int16_t *sfx = (int16_t *)sc->data + ch->pos;
+    int i = 0;
+
+#if USE_MIX_SIMD
+    mixv_t vol = mix_vol(leftvol, rightvol);
+    for (; i < count - 3; i += 4, samp += 4, sfx += 4) {
+        mixv_t v = mix_load_s16(sfx);
+        mix_madd(&samp[0].left, mix_dup_lo(v), vol);
+        mix_madd(&samp[2].left, mix_dup_hi(v), vol);
+    }
+#endif
 
-    for (int i = 0; i < count; i++, samp++, sfx++) {
+    for (; i < count; i++, samp++, sfx++) {
         samp->left += *sfx * leftvol;
         samp->right += *sfx * rightvol;
     }
@@ -376,8 +566,18 @@ PAINTFUNC(PaintStereoDmix16)
     float leftvol = ch->leftvol * snd_vol * M_SQRT1_2;
     float rightvol = ch->rightvol * snd_vol * M_SQRT1_2;
     int16_t *sfx = (int16_t *)sc->data + ch->pos * 2;
+    int i = 0;
+
+#if USE_MIX_SIMD
+    mixv_t vol = mix_vol(leftvol, rightvol);
+    for (; i < count - 3; i += 4, samp += 4, sfx += 8) {
+        mixv_t v = mix_load_s16_pairs(sfx);
+        mix_madd(&samp[0].left, mix_dup_lo(v), vol);
+        mix_madd(&samp[2].left, mix_dup_hi(v), vol);
+    }
+#endif
 
-    for (int i = 0; i < count; i++, samp++, sfx += 2) {
+    for (; i < count; i++, samp++, sfx += 2) {
         int sum = sfx[0] + sfx[1];
         samp->left += sum * leftvol;
         samp->right += sum * rightvol;
@@ -388,8 +588,15 @@ PAINTFUNC(PaintStereoFull16)
 {
     float vol = ch->leftvol * snd_vol;
     int16_t *sfx = (int16_t *)sc->data + ch->pos * 2;
+    int i = 0;
+
+#if USE_MIX_SIMD
+    mixv_t v4 = mix_vol(vol, vol);
+    for (; i < count - 1; i += 2, samp += 2, sfx += 4)
+        mix_madd(&samp->left, mix_load_s16(sfx), v4);
+#endif
 
-    for (int i = 0; i < count; i++, samp++, sfx += 2) {
+    for (; i < count; i++, samp++, sfx += 2) {
         samp->left += sfx[0] * vol;
         samp->right += sfx[1] * vol;
     }
@@ -404,10 +611,320 @@ static const paintfunc_t paintfuncs[] = {
     PaintStereoFull16,
 };
 
+static void PaintChannel(channel_t *ch, sfxcache_t *sc, samplepair_t *paintbuffer, int paintedtime, int end)
+{
+    int ltime = paintedtime;
+
+    while (ltime < end && ch->sfx) {
+        // max painting is to the end of the buffer
+        int count = min(end, ch->end) - ltime;
+
+        if (count > 0) {
+            int func = (sc->width - 1) * 3 + (sc->channels - 1) * (S_IsFullVolume(ch) + 1);
+            paintfuncs[func](ch, sc, count, &paintbuffer[ltime - paintedtime]);
+            ch->pos += count;
+            ltime += count;
+        }
+
+        // if at end of loop, restart
+        if (ltime >= ch->end) {
+            if (ch->autosound) {
+                // autolooping sounds always go back to start
+                ch->pos = 0;
+                ch->end = ltime + sc->length;
+            } else if (sc->loopstart >= 0) {
+                ch->pos = sc->loopstart;
+                ch->end = ltime + sc->length - ch->pos;
+            } else {
+                // channel just stopped
+                ch->sfx = NULL;
+            }
+        }
+    }
+}
+
+#if USE_TESTS
+/*
+===============================================================================
+
+MIXER TESTS
+
+Single samples are always handled by the scalar loops, so painting and
+transferring random data one sample at a time must give exactly the same
+result as doing it all at once.
+
+===============================================================================
+*/
+
+#define MIXTEST_SAMPLES     64
+
+static bool TestPaintFunc(int func, sfxcache_t *sc)
+{
+    samplepair_t simd[MIXTEST_SAMPLES], scalar[MIXTEST_SAMPLES];
+    int i, count = 1 + Q_rand() % MIXTEST_SAMPLES;
+    channel_t ch = { .leftvol = frand(), .rightvol = frand() };
+
+    sc->width = func / 3 + 1;
+    sc->channels = func % 3 ? 2 : 1;
+    for (i = 0; i < sc->size; i++)
+        sc->data[i] = Q_rand();
+
+    for (i = 0; i < MIXTEST_SAMPLES; i++) {
+        simd[i].left = crand() * 32768;
+        simd[i].right = crand() * 32768;
+    }
+    memcpy(scalar, simd, sizeof(scalar));
+
+    paintfuncs[func](&ch, sc, count, simd);
+    for (i = 0; i < count; i++, ch.pos++)
+        paintfuncs[func](&ch, sc, 1, &scalar[i]);
+
+    return !memcmp(simd, scalar, sizeof(simd));
+}
+
+static bool TestTransfer(void)
+{
+    samplepair_t samp[MIXTEST_SAMPLES];
+    int16_t simd[MIXTEST_SAMPLES * 2], scalar[MIXTEST_SAMPLES * 2];
+    int i, endtime;
+
+    // go past 16-bit range to check saturation
+    for (i = 0; i < MIXTEST_SAMPLES; i++) {
+        samp[i].left = crand() * 40000;
+        samp[i].right = crand() * 40000;
+    }
+    memset(simd, 0, sizeof(simd));
+    memset(scalar, 0, sizeof(scalar));
+
+    dma.channels = 2;
+    dma.samplebits = 16;
+    dma.samples = MIXTEST_SAMPLES * 2;
+    s_paintedtime = Q_rand() % MIXTEST_SAMPLES;
+    endtime = s_paintedtime + 1 + Q_rand() % MIXTEST_SAMPLES;
+
+    dma.buffer = (byte *)simd;
+    TransferStereo16(samp, endtime);
+    dma.buffer = (byte *)scalar;
+    TransferStereo(samp, endtime);
+
+    return !memcmp(simd, scalar, sizeof(simd));
+}
+
+// returns number of failed tests, repeat * 7 are run
+int DMA_TestMixer(int repeat)
+{
+    dma_t dma_save = dma;
+    int paintedtime_save = s_paintedtime;
+    float vol_save = snd_vol;
+    int i, func, size, errors = 0;
+    sfxcache_t *sc;
+
+    size = MIXTEST_SAMPLES * 4;
+    sc = S_Malloc(sizeof(*sc) + size - 1);
+    sc->size = size;
+
+    for (i = 0; i < repeat; i++) {
+        snd_vol = frand();
+        for (func = 0; func < q_countof(paintfuncs); func++)
+            errors += !TestPaintFunc(func, sc);
+        errors += !TestTransfer();
+    }
+
+    Z_Free(sc);
+
+    dma = dma_save;
+    s_paintedtime = paintedtime_save;
+    snd_vol = vol_save;
+
+    return errors;
+}
+#endif
+
+/*
+===============================================================================
+
+MIXER THREADS
+
+With s_mixthreads set, channels are split between the main thread and
+worker threads, each painting into its own buffer. Worker buffers are
+added to the paint buffer in a fixed order once all are done, so output
+only differs from single threaded mixing by float rounding.
+
+===============================================================================
+*/
+
+#define MAX_MIX_THREADS     4
+#define MIN_THREADED_CHANS  8
+
+typedef struct {
+    channel_t   *ch;
+    sfxcache_t  *sc;
+} mixchan_t;
+
+static struct {
+    pthread_t       threads[MAX_MIX_THREADS];
+    int             numthreads;
+    pthread_mutex_t lock;
+    pthread_cond_t  work_cond;
+    pthread_cond_t  done_cond;
+    unsigned        generation;
+    int             pending;
+    bool            terminate;
+
+    // current job
+    mixchan_t       chans[MAX_CHANNELS];
+    int             numchans;
+    int             paintedtime;
+    int             end;
+    samplepair_t    buffers[MAX_MIX_THREADS][PAINTBUFFER_SIZE];
+} mixer;
+
+static cvar_t   *s_mixthreads;
+
+// paints part of the channel list, part 0 is done by main thread
+static void PaintPart(int part, samplepair_t *paintbuffer)
+{
+    int first = mixer.numchans * part / (mixer.numthreads + 1);
+    int last = mixer.numchans * (part + 1) / (mixer.numthreads + 1);
+
+    for (int i = first; i < last; i++)
+        PaintChannel(mixer.chans[i].ch, mixer.chans[i].sc, paintbuffer, mixer.paintedtime, mixer.end);
+}
+
+static void *mix_func(void *arg)
+{
+    int part = (intptr_t)arg;
+    samplepair_t *buffer = mixer.buffers[part - 1];
+    unsigned generation = 0;
+
+    pthread_mutex_lock(&mixer.lock);
+    while (1) {
+        while (mixer.generation == generation && !mixer.terminate)
+            pthread_cond_wait(&mixer.work_cond, &mixer.lock);
+        if (mixer.terminate)
+            break;
+        generation = mixer.generation;
+        pthread_mutex_unlock(&mixer.lock);
+
+        memset(buffer, 0, (mixer.end - mixer.paintedtime) * sizeof(buffer[0]));
+        PaintPart(part, buffer);
+
+        pthread_mutex_lock(&mixer.lock);
+        if (!--mixer.pending)
+            pthread_cond_signal(&mixer.done_cond);
+    }
+    pthread_mutex_unlock(&mixer.lock);
+
+    return NULL;
+}
+
+static void MIX_Init(void)
+{
+    int i, count;
+
+    s_mixthreads = Cvar_Get("s_mixthreads", "0", CVAR_ARCHIVE | CVAR_SOUND);
+    count = Cvar_ClampInteger(s_mixthreads, 0, MAX_MIX_THREADS);
+    if (!count)
+        return;
+
+    pthread_mutex_init(&mixer.lock, NULL);
+    pthread_cond_init(&mixer.work_cond, NULL);
+    pthread_cond_init(&mixer.done_cond, NULL);
+    mixer.generation = 0;
+    mixer.terminate = false;
+
+    for (i = 0; i < count; i++) {
+        if (pthread_create(&mixer.threads[i], NULL, mix_func, (void *)(intptr_t)(i + 1))) {
+            Com_EPrintf("Couldn't create mixer thread\n");
+            break;
+        }
+    }
+    mixer.numthreads = i;
+}
+
+static void MIX_Shutdown(void)
+{
+    int i;
+
+    if (!mixer.numthreads)
+        return;
+
+    pthread_mutex_lock(&mixer.lock);
+    mixer.terminate = true;
+    pthread_mutex_unlock(&mixer.lock);
+
+    for (i = 0; i < mixer.numthreads; i++)
+        pthread_cond_signal(&mixer.work_cond);
+    for (i = 0; i < mixer.numthreads; i++)
+        pthread_join(mixer.threads[i], NULL);
+
+    pthread_mutex_destroy(&mixer.lock);
+    pthread_cond_destroy(&mixer.work_cond);
+    pthread_cond_destroy(&mixer.done_cond);
+    mixer.numthreads = 0;
+}
+
+static void PaintAllChannels(samplepair_t *paintbuffer, int end)
+{
+    channel_t *ch;
+    int i, j, count, threads;
+
+    // sounds must be loaded on main thread
+    mixer.numchans = 0;
+    for (i = 0, ch = s_channels; i < s_numchannels; i++, ch++) {
+        if (!ch->sfx || (!ch->leftvol && !ch->rightvol))
+            continue;
+
+        sfxcache_t *sc = S_LoadSound(ch->sfx);
+        if (!sc)
+            continue;
+
+        Q_assert(sc->width == 1 || sc->width == 2);
+        Q_assert(sc->channels == 1 || sc->channels == 2);
+
+        mixer.chans[mixer.numchans].ch = ch;
+        mixer.chans[mixer.numchans].sc = sc;
+        mixer.numchans++;
+    }
+
+    mixer.paintedtime = s_paintedtime;
+    mixer.end = end;
+
+    threads = mixer.numthreads;
+    if (!threads || mixer.numchans < MIN_THREADED_CHANS) {
+        for (i = 0; i < mixer.numchans; i++)
+            PaintChannel(mixer.chans[i].ch, mixer.chans[i].sc, paintbuffer, s_paintedtime, end);
+        return;
+    }
+
+    pthread_mutex_lock(&mixer.lock);
+    mixer.generation++;
+    mixer.pending = threads;
+    pthread_mutex_unlock(&mixer.lock);
+
+    for (i = 0; i < threads; i++)
+        pthread_cond_signal(&mixer.work_cond);
+
+    PaintPart(0, paintbuffer);
+
+    pthread_mutex_lock(&mixer.lock);
+    while (mixer.pending)
+        pthread_cond_wait(&mixer.done_cond, &mixer.lock);
+    pthread_mutex_unlock(&mixer.lock);
+
+    count = end - s_paintedtime;
+    for (i = 0; i < threads; i++) {
+        const samplepair_t *buffer = mixer.buffers[i];
+        for (j = 0; j < count; j++) {
+            paintbuffer[j].left += buffer[j].left;
+            paintbuffer[j].right += buffer[j].right;
+        }
+    }
+}
+
 static void PaintChannels(int endtime)
 {
     samplepair_t paintbuffer[PAINTBUFFER_SIZE];
-    channel_t *ch;
     int i;
     bool underwater = S_IsUnderWater();
 
@@ -436,46 +953,7 @@ static void PaintChannels(int endtime)
             paintbuffer[i - s_paintedtime] = s_rawsamples[i & (MAX_RAW_SAMPLES - 1)];
 
         // paint in the channels.
-        for (i = 0, ch = s_channels; i < s_numchannels; i++, ch++) {
-            int ltime = s_paintedtime;
-
-            while (ltime < end) {
-                if (!ch->sfx || (!ch->leftvol && !ch->rightvol))
-                    break;
-
-                sfxcache_t *sc = S_LoadSound(ch->sfx);
-                if (!sc)
-                    break;
-
-                Q_assert(sc->width == 1 || sc->width == 2);
-                Q_assert(sc->channels == 1 || sc->channels == 2);
-
-                // max painting is to the end of the buffer
-                int count = min(end, ch->end) - ltime;
-
-                if (count > 0) {
-                    int func = (sc->width - 1) * 3 + (sc->channels - 1) * (S_IsFullVolume(ch) + 1);
-                    paintfuncs[func](ch, sc, count, &paintbuffer[ltime - s_paintedtime]);
-                    ch->pos += count;
-                    ltime += count;
-                }
-
-                // if at end of loop, restart
-                if (ltime >= ch->end) {
-                    if (ch->autosound) {
-                        // autolooping sounds always go back to start
-                        ch->pos = 0;
-                        ch->end = ltime + sc->length;
-                    } else if (sc->loopstart >= 0) {
-                        ch->pos = sc->loopstart;
-                        ch->end = ltime + sc->length - ch->pos;
-                    } else {
-                        // channel just stopped
-                        ch->sfx = NULL;
-                    }
-                }
-            }
-        }
+        PaintAllChannels(paintbuffer, end);
 
         if (s_rawend >= s_paintedtime)
         {
@@ -586,6 +1064,8 @@ static bool DMA_Init(void)
 
     s_numchannels = MAX_CHANNELS;
 
+    MIX_Init();
+
     Com_Printf("sound sampling rate: %i\n", dma.speed);
 
     return true;
@@ -593,6 +1073,7 @@ static bool DMA_Init(void)
 
 static void DMA_Shutdown(void)
 {
+    MIX_Shutdown();
     snddma.shutdown();
     s_numchannels = 0;
 
@@ -57,6 +57,7 @@ list_t      s_pendingplays;
 
 cvar_t      *s_volume;
 cvar_t      *s_ambient;
+cvar_t      *s_loadthreads;
 #if USE_DEBUG
 cvar_t      *s_show;
 #endif
@@ -152,6 +153,7 @@ void S_Init(void)
     s_auto_focus = Cvar_Get("s_auto_focus", "0", 0);
     s_underwater = Cvar_Get("s_underwater", "1", 0);
     s_underwater_gain_hf = Cvar_Get("s_underwater_gain_hf", "0.25", 0);
+    s_loadthreads = Cvar_Get("s_loadthreads", "4", 0);
 
     // start one of available sound engines
     s_started = SS_NOT;
@@ -218,6 +220,8 @@ void S_FreeAllSounds(void)
     int     i;
     sfx_t   *sfx;
 
+    S_FinishSoundList();
+
     // free all sounds
     for (i = 0, sfx = known_sfx; i < num_sfx; i++, sfx++) {
         if (!sfx->name[0])
@@ -350,6 +354,8 @@ S_BeginRegistration
 */
 void S_BeginRegistration(void)
 {
+    S_FinishSoundList();
+
     s_registration_sequence++;
     s_registering = true;
 }
@@ -486,7 +492,8 @@ S_EndRegistration
 */
 void S_EndRegistration(void)
 {
-    int     i;
+    sfx_t   *list[MAX_SFX];
+    int     i, count;
     sfx_t   *sfx;
 
     S_RegisterSexedSounds();
@@ -509,12 +516,26 @@ void S_EndRegistration(void)
     }
 
     // load everything in
-    for (i = 0, sfx = known_sfx; i < num_sfx; i++, sfx++) {
+    for (i = count = 0, sfx = known_sfx; i < num_sfx; i++, sfx++) {
         if (!sfx->name[0])
             continue;
-        S_LoadSound(sfx);
+        list[count++] = sfx;
     }
 
+    S_QueueSoundList(list, count);
+}
+
+/*
+=====================
+S_FinishRegistration
+
+Waits for sounds queued by S_EndRegistration to be loaded.
+=====================
+*/
+void S_FinishRegistration(void)
+{
+    S_FinishSoundList();
+
     s_registering = false;
 }
 
@@ -677,6 +698,8 @@ void S_StartSound(const vec3_t origin, int entnum, int entchannel, qhandle_t hSf
         return;
     if (!s_active)
         return;
+    if (cls.demo.benchmark)
+        return;     // demobench parses without playing anything
     if (!(sfx = S_SfxForHandle(hSfx)))
         return;
 
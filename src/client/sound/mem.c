@@ -19,11 +19,22 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 
 #include "sound.h"
 #include "common/intreadwrite.h"
+#include "system/pthread.h"
 
 #define FORMAT_PCM  1
 
 wavinfo_t s_info;
 
+typedef struct {
+    sfx_t       *sfx;
+    char        *name;
+    byte        *data;
+    int         len;
+    bool        ok;
+    bool        done;
+    wavinfo_t   info;
+} sndjob_t;
+
 /*
 ===============================================================================
 
@@ -56,26 +67,26 @@ static int FindChunk(sizebuf_t *sz, uint32_t search)
     return 0;
 }
 
-static bool GetWavinfo(sizebuf_t *sz)
+static bool GetWavinfo(sizebuf_t *sz, wavinfo_t *info)
 {
     int tag, samples, width, chunk_len, next_chunk;
 
     tag = SZ_ReadLong(sz);
 
-    if (tag == MakeLittleLong('O','g','g','S') || !COM_CompareExtension(s_info.name, ".ogg")) {
+    if (tag == MakeLittleLong('O','g','g','S') || !COM_CompareExtension(info->name, ".ogg")) {
         sz->readcount = 0;
-        return OGG_Load(sz);
+        return OGG_Load(sz, info);
     }
 
 // find "RIFF" chunk
     if (tag != TAG_RIFF) {
-        Com_DPrintf("%s has missing/invalid RIFF chunk\n", s_info.name);
+        info->error = "missing/invalid RIFF chunk";
         return false;
     }
 
     sz->readcount += 4;
     if (SZ_ReadLong(sz) != TAG_WAVE) {
-        Com_DPrintf("%s has missing/invalid WAVE chunk\n", s_info.name);
+        info->error = "missing/invalid WAVE chunk";
         return false;
     }
 
@@ -84,25 +95,25 @@ static bool GetWavinfo(sizebuf_t *sz)
 
 // find "fmt " chunk
     if (!FindChunk(sz, TAG_fmt)) {
-        Com_DPrintf("%s has missing/invalid fmt chunk\n", s_info.name);
+        info->error = "missing/invalid fmt chunk";
         return false;
     }
 
-    s_info.format = SZ_ReadShort(sz);
-    if (s_info.format != FORMAT_PCM) {
-        Com_DPrintf("%s has unsupported format\n", s_info.name);
+    info->format = SZ_ReadShort(sz);
+    if (info->format != FORMAT_PCM) {
+        info->error = "unsupported format";
         return false;
     }
 
-    s_info.channels = SZ_ReadShort(sz);
-    if (s_info.channels < 1 || s_info.channels > 2) {
-        Com_DPrintf("%s has bad number of channels\n", s_info.name);
+    info->channels = SZ_ReadShort(sz);
+    if (info->channels < 1 || info->channels > 2) {
+        info->error = "bad number of channels";
         return false;
     }
 
-    s_info.rate = SZ_ReadLong(sz);
-    if (s_info.rate < 8000 || s_info.rate > 48000) {
-        Com_DPrintf("%s has bad rate\n", s_info.name);
+    info->rate = SZ_ReadLong(sz);
+    if (info->rate < 8000 || info->rate > 48000) {
+        info->error = "bad rate";
         return false;
     }
 
@@ -110,16 +121,16 @@ static bool GetWavinfo(sizebuf_t *sz)
     width = SZ_ReadShort(sz);
     switch (width) {
     case 8:
-        s_info.width = 1;
+        info->width = 1;
         break;
     case 16:
-        s_info.width = 2;
+        info->width = 2;
         break;
     case 24:
-        s_info.width = 3;
+        info->width = 3;
         break;
     default:
-        Com_DPrintf("%s has bad width\n", s_info.name);
+        info->error = "bad width";
         return false;
     }
 
@@ -127,19 +138,19 @@ static bool GetWavinfo(sizebuf_t *sz)
     sz->readcount = next_chunk;
     chunk_len = FindChunk(sz, TAG_data);
     if (!chunk_len) {
-        Com_DPrintf("%s has missing/invalid data chunk\n", s_info.name);
+        info->error = "missing/invalid data chunk";
         return false;
     }
 
 // calculate length in samples
-    s_info.samples = chunk_len / (s_info.width * s_info.channels);
-    if (!s_info.samples) {
-        Com_DPrintf("%s has zero length\n", s_info.name);
+    info->samples = chunk_len / (info->width * info->channels);
+    if (!info->samples) {
+        info->error = "zero length";
         return false;
     }
 
-    s_info.data = sz->data + sz->readcount;
-    s_info.loopstart = -1;
+    info->data = sz->data + sz->readcount;
+    info->loopstart = -1;
 
 // find "cue " chunk
     sz->readcount = next_chunk;
@@ -153,11 +164,11 @@ static bool GetWavinfo(sizebuf_t *sz)
 
     sz->readcount += 24;
     samples = SZ_ReadLong(sz);
-    if (samples < 0 || samples >= s_info.samples) {
-        Com_DPrintf("%s has bad loop start\n", s_info.name);
+    if (samples < 0 || samples >= info->samples) {
+        info->error = "bad loop start";
         return true;
     }
-    s_info.loopstart = samples;
+    info->loopstart = samples;
 
 // if the next chunk is a "LIST" chunk, look for a cue length marker
     sz->readcount = next_chunk;
@@ -173,30 +184,30 @@ static bool GetWavinfo(sizebuf_t *sz)
 // this is not a proper parse, but it works with cooledit...
     sz->readcount -= 8;
     samples = SZ_ReadLong(sz);  // samples in loop
-    if (samples < 1 || samples > s_info.samples - s_info.loopstart) {
-        Com_DPrintf("%s has bad loop length\n", s_info.name);
+    if (samples < 1 || samples > info->samples - info->loopstart) {
+        info->error = "bad loop length";
         return true;
     }
-    s_info.samples = s_info.loopstart + samples;
+    info->samples = info->loopstart + samples;
 
     return true;
 }
 
-static void ConvertSamples(void)
+static void ConvertSamples(wavinfo_t *info)
 {
-    uint16_t *data = (uint16_t *)s_info.data;
-    int count = s_info.samples * s_info.channels;
+    uint16_t *data = (uint16_t *)info->data;
+    int count = info->samples * info->channels;
 
 // sigh. truncate 24 bit to 16
-    if (s_info.width == 3) {
+    if (info->width == 3) {
         for (int i = 0; i < count; i++)
-            data[i] = RL32(&s_info.data[i * 3]) >> 8;
-        s_info.width = 2;
+            data[i] = RL32(&info->data[i * 3]) >> 8;
+        info->width = 2;
         return;
     }
 
 #if USE_BIG_ENDIAN
-    if (s_info.width == 2) {
+    if (info->width == 2) {
         for (int i = 0; i < count; i++)
             data[i] = LittleShort(data[i]);
     }
@@ -205,62 +216,279 @@ static void ConvertSamples(void)
 
 /*
 ==============
-S_LoadSound
+S_DecodeSound
+
+Parses and converts a sound file already in memory. Touches nothing but
+the job itself, so it is safe to call from loader threads.
 ==============
 */
-sfxcache_t *S_LoadSound(sfx_t *s)
+static void S_DecodeSound(sndjob_t *job)
 {
     sizebuf_t   sz;
-    byte        *data;
-    sfxcache_t  *sc;
-    int         len;
-    char        *name;
 
+    memset(&job->info, 0, sizeof(job->info));
+    job->info.name = job->name;
+
+    SZ_Init(&sz, job->data, job->len);
+    sz.cursize = job->len;
+
+    job->ok = GetWavinfo(&sz, &job->info);
+    if (job->ok && job->info.format == FORMAT_PCM)
+        ConvertSamples(&job->info);
+}
+
+/*
+==============
+S_UploadSound
+
+Hands decoded samples over to the sound backend and frees the job data.
+==============
+*/
+static sfxcache_t *S_UploadSound(sndjob_t *job)
+{
+    sfxcache_t  *sc = NULL;
+
+    if (job->info.error)
+        Com_DPrintf("%s has %s\n", job->name, job->info.error);
+
+    if (job->ok) {
+        s_info = job->info;
+        sc = s_api.upload_sfx(job->sfx);
+        if (job->info.format != FORMAT_PCM)
+            free(job->info.data);
+    } else {
+        job->sfx->error = Q_ERR_INVALID_FORMAT;
+    }
+
+    FS_FreeFile(job->data);
+    return sc;
+}
+
+static bool S_ReadSound(sfx_t *s, sndjob_t *job)
+{
     if (s->name[0] == '*')
-        return NULL;
+        return false;
 
 // see if still in memory
-    sc = s->cache;
-    if (sc)
-        return sc;
+    if (s->cache)
+        return false;
 
 // don't retry after error
     if (s->error)
-        return NULL;
+        return false;
 
 // load it in
     if (s->truename)
-        name = s->truename;
+        job->name = s->truename;
     else
-        name = s->name;
+        job->name = s->name;
+
+    job->sfx = s;
+    job->len = FS_LoadFile(job->name, (void **)&job->data);
+    if (!job->data) {
+        s->error = job->len;
+        return false;
+    }
+
+    return true;
+}
+
+/*
+==============
+S_LoadSound
+==============
+*/
+sfxcache_t *S_LoadSound(sfx_t *s)
+{
+    sndjob_t    job;
+
+    // sound may still be queued for loader threads
+    S_FinishSoundList();
+
+    if (!S_ReadSound(s, &job))
+        return s->cache;
+
+    S_DecodeSound(&job);
+    return S_UploadSound(&job);
+}
+
+/*
+===============================================================================
+
+PARALLEL LOADING
+
+Files are read on the main thread, since the filesystem is not thread
+safe, and queued for loader threads that parse and convert them. Decoded
+sounds are uploaded in order by the main thread as they complete, while
+remaining files are still being read. Loading may be left running while
+the client registers other media, and is completed by S_FinishSoundList.
+
+===============================================================================
+*/
+
+#define MAX_LOAD_THREADS    8
+
+static struct {
+    sndjob_t        *jobs;
+    int             numjobs;    // queued for decoding
+    int             next;       // next job to be picked by loader thread
+    int             uploaded;   // handed over to sound backend
+    bool            finished;   // no more jobs will be queued
+    pthread_t       threads[MAX_LOAD_THREADS];
+    int             numthreads;
+    pthread_mutex_t lock;
+    pthread_cond_t  work_cond;
+    pthread_cond_t  done_cond;
+} loader;
+
+static void *load_func(void *arg)
+{
+    sndjob_t *job;
+
+    pthread_mutex_lock(&loader.lock);
+    while (1) {
+        while (loader.next == loader.numjobs && !loader.finished)
+            pthread_cond_wait(&loader.work_cond, &loader.lock);
+
+        if (loader.next == loader.numjobs)
+            break;
+
+        job = &loader.jobs[loader.next++];
+        pthread_mutex_unlock(&loader.lock);
+
+        S_DecodeSound(job);
 
-    len = FS_LoadFile(name, (void **)&data);
-    if (!data) {
-        s->error = len;
-        return NULL;
+        pthread_mutex_lock(&loader.lock);
+        job->done = true;
+        pthread_cond_signal(&loader.done_cond);
     }
+    pthread_mutex_unlock(&loader.lock);
 
-    memset(&s_info, 0, sizeof(s_info));
-    s_info.name = name;
+    return NULL;
+}
+
+// uploads completed jobs in order, optionally waiting for all of them
+static void S_UploadJobs(bool wait)
+{
+    while (loader.uploaded < loader.numjobs) {
+        sndjob_t *job = &loader.jobs[loader.uploaded];
+
+        pthread_mutex_lock(&loader.lock);
+        while (wait && !job->done)
+            pthread_cond_wait(&loader.done_cond, &loader.lock);
+        bool done = job->done;
+        pthread_mutex_unlock(&loader.lock);
 
-    SZ_Init(&sz, data, len);
-    sz.cursize = len;
+        if (!done)
+            break;
 
-    if (!GetWavinfo(&sz)) {
-        s->error = Q_ERR_INVALID_FORMAT;
-        goto fail;
+        S_UploadSound(job);
+        loader.uploaded++;
     }
+}
 
-    if (s_info.format == FORMAT_PCM)
-        ConvertSamples();
+static void S_StopLoaders(void)
+{
+    int i;
 
-    sc = s_api.upload_sfx(s);
+    pthread_mutex_lock(&loader.lock);
+    loader.finished = true;
+    pthread_mutex_unlock(&loader.lock);
 
-    if (s_info.format != FORMAT_PCM)
-        FS_FreeTempMem(s_info.data);
+    for (i = 0; i < loader.numthreads; i++)
+        pthread_cond_signal(&loader.work_cond);
 
-fail:
-    FS_FreeFile(data);
-    return sc;
+    S_UploadJobs(true);
+
+    for (i = 0; i < loader.numthreads; i++)
+        pthread_join(loader.threads[i], NULL);
+
+    pthread_mutex_destroy(&loader.lock);
+    pthread_cond_destroy(&loader.work_cond);
+    pthread_cond_destroy(&loader.done_cond);
+
+    Z_Freep((void **)&loader.jobs);
+    loader.numthreads = 0;
+}
+
+static bool S_StartLoaders(int count)
+{
+    int numthreads = Cvar_ClampInteger(s_loadthreads, 0, MAX_LOAD_THREADS);
+
+    numthreads = min(numthreads, count);
+    if (!numthreads)
+        return false;
+
+    loader.jobs = Z_Malloc(sizeof(loader.jobs[0]) * count);
+    loader.numjobs = loader.next = loader.uploaded = 0;
+    loader.finished = false;
+    pthread_mutex_init(&loader.lock, NULL);
+    pthread_cond_init(&loader.work_cond, NULL);
+    pthread_cond_init(&loader.done_cond, NULL);
+
+    for (loader.numthreads = 0; loader.numthreads < numthreads; loader.numthreads++) {
+        if (pthread_create(&loader.threads[loader.numthreads], NULL, load_func, NULL)) {
+            Com_EPrintf("Couldn't create sound loader thread\n");
+            break;
+        }
+    }
+
+    if (!loader.numthreads) {
+        S_StopLoaders();
+        return false;
+    }
+
+    return true;
 }
 
+/*
+==============
+S_QueueSoundList
+
+Starts loading all sounds in the list, decoding them on s_loadthreads
+threads. Returns once all files are read, decoding may still be running.
+==============
+*/
+void S_QueueSoundList(sfx_t **list, int count)
+{
+    int i;
+
+    S_FinishSoundList();
+
+    // s_loadthreads is not registered when sound is disabled
+    if (!s_started)
+        return;
+
+    if (!S_StartLoaders(count)) {
+        for (i = 0; i < count; i++)
+            S_LoadSound(list[i]);
+        return;
+    }
+
+    for (i = 0; i < count; i++) {
+        sndjob_t *job = &loader.jobs[loader.numjobs];
+
+        if (S_ReadSound(list[i], job)) {
+            job->done = false;
+            pthread_mutex_lock(&loader.lock);
+            loader.numjobs++;
+            pthread_cond_signal(&loader.work_cond);
+            pthread_mutex_unlock(&loader.lock);
+        }
+
+        S_UploadJobs(false);
+    }
+}
+
+/*
+==============
+S_FinishSoundList
+
+Waits for loader threads and uploads remaining sounds.
+==============
+*/
+void S_FinishSoundList(void)
+{
+    if (loader.jobs)
+        S_StopLoaders();
+}
@@ -37,6 +37,8 @@
 #include <errno.h>
 
 #include "shared/shared.h"
+#include "shared/atomic.h"
+#include "system/pthread.h"
 #include "sound.h"
 
 #if defined(__GNUC__)
@@ -67,6 +69,8 @@ typedef struct {
 	track_name_style_t track_name_style;
 	// track number mapping function
 	int (*map_track)(int);
+	// decoder thread should be started on next update
+	bool pending;
 } ogg_state_t;
 
 static ogg_state_t  ogg;
@@ -82,6 +86,7 @@ static cvar_t* ogg_enable;        /* Music enable flag to toggle from the menu.
 static cvar_t *ogg_volume;        /* Music volume. */
 static cvar_t *ogg_shuffle;       /* Shuffle playback */
 static cvar_t *ogg_ignoretrack0;  /* Toggle track 0 playing */
+static cvar_t *ogg_prefetch;      /* Seconds of music decoded ahead, 0 disables decoder thread */
 static int ogg_numsamples;        /* Number of sambles read from the current file */
 static ogg_status_t ogg_status;   /* Status indicator. */
 
@@ -97,6 +102,33 @@ struct {
 	int numsamples;
 } ogg_saved_state;
 
+/*
+ * Decoder thread state. The thread fills a single producer, single
+ * consumer ring of interleaved PCM which OGG_Update() drains into the
+ * sound backend. Each side only advances its own position, so the ring
+ * itself needs no locking; the mutex and condition are only used to put
+ * the decoder to sleep while the ring is full.
+ */
+#define OGG_MIN_PREFETCH    0x4000  // in shorts
+#define OGG_MAX_PREFETCH    0x400000
+#define OGG_MIN_DECODE      0x400
+#define OGG_MAX_DECODE      0x1000
+
+static struct {
+	short *data;
+	int mask;
+	atomic_int read;
+	atomic_int write;
+	atomic_int eof;
+	atomic_int quit;
+	bool started;
+	bool delivered;     // ring has fed samples for this track
+	unsigned underruns;
+	pthread_t thread;
+	pthread_mutex_t lock;
+	pthread_cond_t cond;
+} ogg_ring;
+
 // --------
 
 static int map_track_identity(int track)
@@ -159,8 +191,90 @@ static void tracklist_free(void)
 
 // --------
 
+static int ogg_ring_space(int write)
+{
+	return (atomic_load(&ogg_ring.read) - write - 1) & ogg_ring.mask;
+}
+
+static void *ogg_decode_func(void *arg)
+{
+	stb_vorbis *vf = ogg.vf;
+	int channels = vf->channels;
+	int size = ogg_ring.mask + 1;
+
+	while (!atomic_load(&ogg_ring.quit)) {
+		int write = atomic_load(&ogg_ring.write);
+		int count = ogg_ring_space(write);
+
+		if (count < OGG_MIN_DECODE) {
+			pthread_mutex_lock(&ogg_ring.lock);
+			while (!atomic_load(&ogg_ring.quit) && ogg_ring_space(write) < OGG_MIN_DECODE)
+				pthread_cond_wait(&ogg_ring.cond, &ogg_ring.lock);
+			pthread_mutex_unlock(&ogg_ring.lock);
+			continue;
+		}
+
+		// decode straight into the ring, up to the wrap point
+		count = min(count, size - write);
+		count = min(count, OGG_MAX_DECODE);
+		count -= count % channels;
+
+		int samples = stb_vorbis_get_samples_short_interleaved(vf, channels, ogg_ring.data + write, count);
+		if (samples <= 0) {
+			atomic_store(&ogg_ring.eof, true);
+			break;
+		}
+
+		atomic_store(&ogg_ring.write, (write + samples * channels) & ogg_ring.mask);
+	}
+
+	return NULL;
+}
+
+static void ogg_ring_stop(void)
+{
+	if (!ogg_ring.started)
+		return;
+
+	pthread_mutex_lock(&ogg_ring.lock);
+	atomic_store(&ogg_ring.quit, true);
+	pthread_cond_signal(&ogg_ring.cond);
+	pthread_mutex_unlock(&ogg_ring.lock);
+
+	pthread_join(ogg_ring.thread, NULL);
+
+	Z_Freep((void **)&ogg_ring.data);
+	ogg_ring.started = false;
+}
+
+static void ogg_ring_start(void)
+{
+	uint32_t size = ogg_prefetch->value * ogg.vf->sample_rate * ogg.vf->channels;
+
+	size = Q_npot32(Q_clip(size, OGG_MIN_PREFETCH, OGG_MAX_PREFETCH));
+
+	ogg_ring.data = Z_Malloc(size * sizeof(ogg_ring.data[0]));
+	ogg_ring.mask = size - 1;
+	atomic_store(&ogg_ring.read, 0);
+	atomic_store(&ogg_ring.write, 0);
+	atomic_store(&ogg_ring.eof, false);
+	atomic_store(&ogg_ring.quit, false);
+	ogg_ring.delivered = false;
+
+	if (pthread_create(&ogg_ring.thread, NULL, ogg_decode_func, NULL)) {
+		Com_EPrintf("Couldn't create OGG decoder thread\n");
+		Z_Freep((void **)&ogg_ring.data);
+		return;
+	}
+
+	ogg_ring.started = true;
+}
+
 static void ogg_stop(void)
 {
+	ogg_ring_stop();
+	ogg.pending = false;
+
 	stb_vorbis_close(ogg.vf);
 
 	ogg.vf = NULL;
@@ -171,6 +285,9 @@ static void ogg_stop(void)
 
 static void ogg_play(void)
 {
+	/* Close previous file, it may still be open when paused. */
+	ogg_stop();
+
 	/* Open ogg vorbis file. */
 	FILE* f = fopen(ogg.path, "rb");
 
@@ -198,6 +315,9 @@ static void ogg_play(void)
 
 	/* Play file. */
 	ogg_numsamples = 0;
+	// decoder thread is started on first update, so that saved state
+	// can still seek the file
+	ogg.pending = ogg_prefetch->value > 0;
 	if (ogg_enable->integer)
 		ogg_status = PLAY;
 	else
@@ -330,6 +450,54 @@ OGG_Stop(void)
 		s_api.drop_raw_samples();
 }
 
+/*
+ * Stream music from the decoder thread.
+ */
+static void
+OGG_DrainRing(void)
+{
+	int channels = ogg.vf->channels;
+	int size = ogg_ring.mask + 1;
+
+	while (s_api.need_raw_samples()) {
+		// check eof before write position, so that no samples are lost
+		int eof = atomic_load(&ogg_ring.eof);
+		int read = atomic_load(&ogg_ring.read);
+		int count = (atomic_load(&ogg_ring.write) - read) & ogg_ring.mask;
+
+		if (!count) {
+			if (eof) {
+				ogg_stop();
+				OGG_Play();
+			} else if (ogg_ring.delivered) {
+				// an empty ring before the first samples is just startup
+				ogg_ring.underruns++;
+			}
+			break;
+		}
+
+		count = min(count, size - read);
+		count = min(count, OGG_MAX_DECODE);
+
+		int samples = count / channels;
+		ogg_numsamples += samples;
+
+		if (!s_api.raw_samples(samples, ogg.vf->sample_rate, channels, channels,
+			(byte *)(ogg_ring.data + read), S_GetLinearVolume(ogg_volume->value)))
+		{
+			s_api.drop_raw_samples();
+			break;
+		}
+
+		atomic_store(&ogg_ring.read, (read + count) & ogg_ring.mask);
+		ogg_ring.delivered = true;
+
+		pthread_mutex_lock(&ogg_ring.lock);
+		pthread_cond_signal(&ogg_ring.cond);
+		pthread_mutex_unlock(&ogg_ring.lock);
+	}
+}
+
 /*
  * Stream music.
  */
@@ -348,6 +516,16 @@ OGG_Update(void)
 	if (ogg_status != PLAY)
 		return;
 
+	if (ogg.pending) {
+		ogg.pending = false;
+		ogg_ring_start();
+	}
+
+	if (ogg_ring.started) {
+		OGG_DrainRing();
+		return;
+	}
+
 	while (s_api.need_raw_samples()) {
 		short   buffer[4096];
 		int     samples;
@@ -355,7 +533,7 @@ OGG_Update(void)
 		samples = stb_vorbis_get_samples_short_interleaved(ogg.vf, ogg.vf->channels, buffer,
 														   sizeof(buffer) / sizeof(short));
 		if (samples == 0) {
-			ogg_status = STOP;
+			ogg_stop();
 			if(OGG_Play(), ogg.initialized)
 				samples = stb_vorbis_get_samples_short_interleaved(ogg.vf, ogg.vf->channels, buffer,
 																sizeof(buffer) / sizeof(short));
@@ -484,49 +662,54 @@ OGG_LoadTrackList(void)
 
 // ----
 
-bool OGG_Load(sizebuf_t *sz)
+bool OGG_Load(sizebuf_t *sz, wavinfo_t *info)
 {
 	int ret;
 	stb_vorbis *vf = stb_vorbis_open_memory(sz->data, sz->cursize, &ret, NULL);
 	if (!vf) {
-		Com_DPrintf("%s does not appear to be an Ogg bitstream (error %d)\n", s_info.name, ret);
+		info->error = "invalid Ogg bitstream";
 		return false;
 	}
 
 	if (vf->channels < 1 || vf->channels > 2) {
-		Com_DPrintf("%s has bad number of channels\n", s_info.name);
+		info->error = "bad number of channels";
 		goto fail;
 	}
 
 	if (vf->sample_rate < 8000 || vf->sample_rate > 48000) {
-		Com_DPrintf("%s has bad rate\n", s_info.name);
+		info->error = "bad rate";
 		goto fail;
 	}
 
 	unsigned int samples = stb_vorbis_stream_length_in_samples(vf);
 	if (samples < 1 || samples > MAX_LOADFILE >> vf->channels) {
-		Com_DPrintf("%s has bad number of samples\n", s_info.name);
+		info->error = "bad number of samples";
 		goto fail;
 	}
 
 	unsigned int size = samples << vf->channels;
 	int offset = 0;
 
-	s_info.channels = vf->channels;
-	s_info.rate = vf->sample_rate;
-	s_info.width = 2;
-	s_info.loopstart = -1;
-	s_info.data = FS_AllocTempMem(size);
+	info->channels = vf->channels;
+	info->rate = vf->sample_rate;
+	info->width = 2;
+	info->loopstart = -1;
+	// may be called from sound loader threads, so don't use zone
+	info->data = malloc(size);
+	if (!info->data) {
+		info->error = "too many samples";
+		goto fail;
+	}
 
 	while (offset < size) {
-		ret = stb_vorbis_get_samples_short_interleaved(vf, vf->channels, (short*)(s_info.data + offset), (size - offset) / sizeof(short));
+		ret = stb_vorbis_get_samples_short_interleaved(vf, vf->channels, (short*)(info->data + offset), (size - offset) / sizeof(short));
 		if (ret == 0)
 			break;
 
 		offset += ret;
 	}
 
-	s_info.samples = offset >> s_info.channels;
+	info->samples = offset >> info->channels;
 
 	stb_vorbis_close(vf);
 	return true;
@@ -564,12 +747,12 @@ OGG_Info_f(void)
 	{
 		case PLAY:
 			Com_Printf("State: Playing file %s at %i samples.\n",
-			           ogg.path, stb_vorbis_get_sample_offset(ogg.vf));
+			           ogg.path, ogg_numsamples);
 			break;
 
 		case PAUSE:
 			Com_Printf("State: Paused file %s at %i samples.\n",
-			           ogg.path, stb_vorbis_get_sample_offset(ogg.vf));
+			           ogg.path, ogg_numsamples);
 			break;
 
 		case STOP:
@@ -584,6 +767,15 @@ OGG_Info_f(void)
 
 			break;
 	}
+
+	if (ogg_ring.started)
+	{
+		Com_Printf("Prefetch: %d of %d samples buffered.\n",
+		           ((atomic_load(&ogg_ring.write) - atomic_load(&ogg_ring.read)) & ogg_ring.mask) / ogg.vf->channels,
+		           ogg_ring.mask / ogg.vf->channels);
+	}
+
+	Com_Printf("Underruns: %u\n", ogg_ring.underruns);
 }
 
 /*
@@ -756,6 +948,11 @@ static void ogg_volume_changed(cvar_t *self)
     Cvar_ClampValue(self, 0, 1);
 }
 
+static void ogg_prefetch_changed(cvar_t *self)
+{
+    Cvar_ClampValue(self, 0, 10);
+}
+
 static const cmdreg_t c_ogg[] = {
     { "ogg", OGG_Cmd_f, OGG_Cmd_c },
     { NULL }
@@ -774,6 +971,13 @@ OGG_Init(void)
 	ogg_volume->changed = ogg_volume_changed;
 	ogg_shuffle = Cvar_Get("ogg_shuffle", "0", CVAR_ARCHIVE);
 	ogg_ignoretrack0 = Cvar_Get("ogg_ignoretrack0", "0", CVAR_ARCHIVE);
+	ogg_prefetch = Cvar_Get("ogg_prefetch", "1", 0);
+	ogg_prefetch->changed = ogg_prefetch_changed;
+
+	// Decoder thread
+	pthread_mutex_init(&ogg_ring.lock, NULL);
+	pthread_cond_init(&ogg_ring.cond, NULL);
+	ogg_ring.underruns = 0;
 
 	// Commands
 	Cmd_Register(c_ogg);
@@ -800,6 +1004,9 @@ OGG_Shutdown(void)
 
 	Z_Freep((void**)&ogg.music_dir);
 
+	pthread_mutex_destroy(&ogg_ring.lock);
+	pthread_cond_destroy(&ogg_ring.cond);
+
 	// Remove console commands
 	Cmd_RemoveCommand("ogg");
 }
@@ -100,6 +100,7 @@ typedef struct {
     int         loopstart;
     int         samples;
     byte        *data;
+    const char  *error;     // printed by the main thread
 } wavinfo_t;
 
 /*
@@ -160,6 +161,7 @@ extern cvar_t       *s_show;
 #endif
 extern cvar_t       *s_underwater;
 extern cvar_t       *s_underwater_gain_hf;
+extern cvar_t       *s_loadthreads;
 
 #define S_IsFullVolume(ch) \
     ((ch)->entnum == -1 || (ch)->entnum == listener_entnum || (ch)->dist_mult == 0)
@@ -172,10 +174,12 @@ extern cvar_t       *s_underwater_gain_hf;
 
 sfx_t *S_SfxForHandle(qhandle_t hSfx);
 sfxcache_t *S_LoadSound(sfx_t *s);
+void S_QueueSoundList(sfx_t **list, int count);
+void S_FinishSoundList(void);
 channel_t *S_PickChannel(int entnum, int entchannel);
 void S_IssuePlaysound(playsound_t *ps);
 void S_BuildSoundList(int *sounds);
 float S_GetEntityLoopVolume(const centity_state_t *ent);
 float S_GetEntityLoopDistMult(const centity_state_t *ent);
 
-bool OGG_Load(sizebuf_t *sz);
+bool OGG_Load(sizebuf_t *sz, wavinfo_t *info);
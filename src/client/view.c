@@ -71,7 +71,7 @@ V_ClearScene
 Specifies the model that will be used as the world
 ====================
 */
-static void V_ClearScene(void)
+void V_ClearScene(void)
 {
     r_numdlights = 0;
     r_numentities = 0;
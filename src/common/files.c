@@ -26,6 +26,7 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #include "common/prompt.h"
 #include "common/intreadwrite.h"
 #include "system/system.h"
+#include "system/pthread.h"
 #include "client/client.h"
 #include "server/server.h"
 #include "format/pak.h"
@@ -60,6 +61,8 @@ QUAKE FILESYSTEM
 
 #define MAX_FILE_HANDLES    1024
 
+#define ASYNC_BUFSIZE       (1 << 20)   // must be power of two
+
 #if USE_ZLIB
 #define ZIP_BUFSIZE     (1 << 16)   // inflate in blocks of 64k
 #define ZIP_MAXFILES    (1 << 20)   // 1 million files
@@ -154,6 +157,8 @@ typedef struct searchpath_s {
     char        filename[1];
 } searchpath_t;
 
+typedef struct asyncwrite_s asyncwrite_t;
+
 typedef struct {
     filetype_t  type;
     unsigned    mode;
@@ -166,8 +171,25 @@ typedef struct {
     int         error;      // stream error indicator from read/write operation
     int64_t     position;   // reading position for FS_PAK/FS_ZIP
     int64_t     length;     // total cached file length
+    asyncwrite_t    *async; // writer thread for FS_FLAG_ASYNC
 } file_t;
 
+// ring buffer drained by writer thread. head and tail are running byte counts
+// advanced by main thread and writer thread respectively.
+struct asyncwrite_s {
+    pthread_t       thread;
+    pthread_mutex_t lock;
+    pthread_cond_t  cond;
+    file_t          *file;
+    size_t          head;
+    size_t          tail;
+    int64_t         position;   // logical position for FS_Tell
+    int             error;      // set by writer thread
+    unsigned        stalls;     // number of times FS_Write had to wait
+    bool            shutdown;
+    byte            data[ASYNC_BUFSIZE];
+};
+
 typedef struct {
     list_t      entry;
     unsigned    targlen;
@@ -489,6 +511,9 @@ int64_t FS_Tell(qhandle_t f)
     if (!file)
         return Q_ERR(EBADF);
 
+    if (file->async)
+        return file->async->position;
+
     switch (file->type) {
     case FS_REAL:
         ret = os_ftell(file->fp);
@@ -640,6 +665,191 @@ int FS_CreatePath(char *path)
     return Q_ERR_SUCCESS;
 }
 
+/*
+=============================================================================
+
+ASYNC WRITES
+
+Files opened with FS_FLAG_ASYNC are written by a separate thread, so that
+disk I/O and gzip compression don't stall the main loop. FS_Write only copies
+data into the ring buffer and blocks when it is full. FS_Flush and
+FS_CloseFile wait for all queued data to be written.
+
+=============================================================================
+*/
+
+static int write_file(file_t *file, const void *buf, size_t len)
+{
+    switch (file->type) {
+    case FS_REAL:
+        if (fwrite(buf, 1, len, file->fp) != len)
+            return Q_ERR_FAILURE;
+        break;
+#if USE_ZLIB
+    case FS_GZ:
+        if (gzwrite(file->zfp, buf, len) != len)
+            return Q_ERR_LIBRARY_ERROR;
+        break;
+#endif
+    default:
+        Q_assert(!"bad file type");
+    }
+
+    return len;
+}
+
+static void *async_write_func(void *arg)
+{
+    asyncwrite_t *aw = arg;
+    size_t tail, len;
+    int ret;
+
+    pthread_mutex_lock(&aw->lock);
+    while (1) {
+        while (aw->head == aw->tail && !aw->shutdown)
+            pthread_cond_wait(&aw->cond, &aw->lock);
+
+        if (aw->head == aw->tail)
+            break;
+
+        tail = aw->tail & (ASYNC_BUFSIZE - 1);
+        len = min(aw->head - aw->tail, ASYNC_BUFSIZE - tail);
+
+        // data after error is discarded
+        pthread_mutex_unlock(&aw->lock);
+        ret = aw->error ? aw->error : write_file(aw->file, aw->data + tail, len);
+        pthread_mutex_lock(&aw->lock);
+
+        if (ret < 0)
+            aw->error = ret;
+        aw->tail += len;
+        pthread_cond_broadcast(&aw->cond);
+    }
+    pthread_mutex_unlock(&aw->lock);
+
+    return NULL;
+}
+
+static void open_async_write(file_t *file, int64_t pos)
+{
+    asyncwrite_t *aw = FS_Mallocz(sizeof(*aw));
+
+    pthread_mutex_init(&aw->lock, NULL);
+    pthread_cond_init(&aw->cond, NULL);
+    aw->file = file;
+    aw->position = pos;
+
+    // fall back to synchronous writes
+    if (pthread_create(&aw->thread, NULL, async_write_func, aw)) {
+        Com_WPrintf("Couldn't create async write thread\n");
+        pthread_mutex_destroy(&aw->lock);
+        pthread_cond_destroy(&aw->cond);
+        Z_Free(aw);
+        return;
+    }
+
+    file->async = aw;
+}
+
+static int async_write(asyncwrite_t *aw, const byte *buf, size_t len)
+{
+    size_t head, space, total = len;
+    bool stalled = false;
+    int ret;
+
+    pthread_mutex_lock(&aw->lock);
+    while (len && !aw->error) {
+        space = ASYNC_BUFSIZE - (aw->head - aw->tail);
+        if (!space) {
+            if (!stalled) {
+                aw->stalls++;
+                stalled = true;
+            }
+            pthread_cond_wait(&aw->cond, &aw->lock);
+            continue;
+        }
+
+        // writer thread doesn't touch free space, copy without lock
+        head = aw->head & (ASYNC_BUFSIZE - 1);
+        space = min(space, min(len, ASYNC_BUFSIZE - head));
+        pthread_mutex_unlock(&aw->lock);
+        memcpy(aw->data + head, buf, space);
+        pthread_mutex_lock(&aw->lock);
+
+        aw->head += space;
+        buf += space;
+        len -= space;
+        pthread_cond_broadcast(&aw->cond);
+    }
+    ret = aw->error;
+    pthread_mutex_unlock(&aw->lock);
+
+    if (ret)
+        return ret;
+
+    aw->position += total;
+    return total;
+}
+
+static int flush_async_write(asyncwrite_t *aw)
+{
+    int ret;
+
+    pthread_mutex_lock(&aw->lock);
+    while (aw->head != aw->tail)
+        pthread_cond_wait(&aw->cond, &aw->lock);
+    ret = aw->error;
+    pthread_mutex_unlock(&aw->lock);
+
+    return ret;
+}
+
+static int close_async_write(file_t *file)
+{
+    asyncwrite_t *aw = file->async;
+    int ret;
+
+    pthread_mutex_lock(&aw->lock);
+    aw->shutdown = true;
+    pthread_cond_broadcast(&aw->cond);
+    pthread_mutex_unlock(&aw->lock);
+
+    Q_assert(!pthread_join(aw->thread, NULL));
+
+    if (aw->stalls)
+        FS_DPrintf("%s: %u stalls\n", __func__, aw->stalls);
+
+    ret = aw->error;
+    pthread_mutex_destroy(&aw->lock);
+    pthread_cond_destroy(&aw->cond);
+    Z_Free(aw);
+
+    file->async = NULL;
+    return ret;
+}
+
+/*
+================
+FS_WriteStalls
+
+Returns number of times FS_Write had to wait for writer thread
+================
+*/
+unsigned FS_WriteStalls(qhandle_t f)
+{
+    file_t *file = file_for_handle(f);
+    unsigned ret;
+
+    if (!file || !file->async)
+        return 0;
+
+    pthread_mutex_lock(&file->async->lock);
+    ret = file->async->stalls;
+    pthread_mutex_unlock(&file->async->lock);
+
+    return ret;
+}
+
 /*
 ==============
 FS_CloseFile
@@ -654,6 +864,9 @@ int FS_CloseFile(qhandle_t f)
         return Q_ERR(EBADF);
 
     ret = file->error;
+    if (file->async)
+        ret = close_async_write(file);
+
     switch (file->type) {
     case FS_REAL:
         if (fclose(file->fp))
@@ -917,6 +1130,9 @@ static int64_t open_file_write(file_t *file, const char *name)
         goto fail;
     }
 
+    if (file->mode & FS_FLAG_ASYNC)
+        open_async_write(file, pos);
+
     FS_DPrintf("%s: %s: %"PRId64" bytes\n", __func__, fullpath, pos);
     return pos;
 
@@ -1622,6 +1838,12 @@ int FS_Flush(qhandle_t f)
     if ((file->mode & FS_MODE_MASK) == FS_MODE_READ)
         return Q_ERR(EBADF);
 
+    if (file->async) {
+        ret = flush_async_write(file->async);
+        if (ret)
+            return ret;
+    }
+
     switch (file->type) {
     case FS_REAL:
         if (fflush(file->fp))
@@ -1648,6 +1870,7 @@ FS_Write
 int FS_Write(const void *buf, size_t len, qhandle_t f)
 {
     file_t  *file = file_for_handle(f);
+    int     ret;
 
     if (!file)
         return Q_ERR(EBADF);
@@ -1665,26 +1888,15 @@ int FS_Write(const void *buf, size_t len, qhandle_t f)
     if (len == 0)
         return 0;
 
-    switch (file->type) {
-    case FS_REAL:
-        if (fwrite(buf, 1, len, file->fp) != len) {
-            file->error = Q_ERR_FAILURE;
-            return file->error;
-        }
-        break;
-#if USE_ZLIB
-    case FS_GZ:
-        if (gzwrite(file->zfp, buf, len) != len) {
-            file->error = Q_ERR_LIBRARY_ERROR;
-            return file->error;
-        }
-        break;
-#endif
-    default:
-        Q_assert(!"bad file type");
-    }
+    if (file->async)
+        ret = async_write(file->async, buf, len);
+    else
+        ret = write_file(file, buf, len);
 
-    return len;
+    if (ret < 0)
+        file->error = ret;
+
+    return ret;
 }
 
 /*
@@ -1941,10 +1941,6 @@ void MSG_ParseDeltaEntity(entity_state_t            *to,
     }
 }
 
-#endif // USE_CLIENT || USE_MVD_CLIENT
-
-#if USE_CLIENT
-
 /*
 ===================
 MSG_ParseDeltaPlayerstate_Default
@@ -2060,6 +2056,9 @@ void MSG_ParseDeltaPlayerstate_Default(const player_state_t *from,
     }
 }
 
+#endif // USE_CLIENT || USE_MVD_CLIENT
+
+#if USE_CLIENT
 
 /*
 ===================
@@ -202,6 +202,7 @@ static size_t NetchanOld_Transmit(netchan_t *chan, size_t length, const void *da
     if (chan->incoming_acknowledged > chan->last_reliable_sequence &&
         chan->incoming_reliable_acknowledged != chan->reliable_sequence) {
         send_reliable = true;
+        chan->total_retransmits++;
     }
 
 // if the reliable transmit buffer is empty, copy the current message out
@@ -454,6 +455,7 @@ static size_t NetchanNew_TransmitNextFragment(netchan_t *chan)
 
     chan->fragment_out.readcount += fragment_length;
     chan->fragment_pending = more_fragments;
+    chan->total_fragments++;
 
     // if the message has been sent completely, clear the fragment buffer
     if (!chan->fragment_pending) {
@@ -497,6 +499,7 @@ static size_t NetchanNew_Transmit(netchan_t *chan, size_t length, const void *da
     if (chan->incoming_acknowledged > chan->last_reliable_sequence &&
         chan->incoming_reliable_acknowledged != chan->reliable_sequence) {
         send_reliable = true;
+        chan->total_retransmits++;
     }
 
 // if the reliable transmit buffer is empty, copy the current message out
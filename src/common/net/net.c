@@ -21,6 +21,7 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 //
 
 #include "shared/shared.h"
+#include "shared/list.h"
 #include "common/common.h"
 #include "common/cvar.h"
 #include "common/fifo.h"
@@ -70,7 +71,7 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 
 #if USE_CLIENT
 
-#define MAX_LOOPBACK    4
+#define MAX_LOOPBACK    16
 
 typedef struct {
     byte    data[MAX_PACKETLEN];
@@ -106,6 +107,9 @@ static cvar_t   *net_log_flush;
 
 static cvar_t   *net_enable_ipv6;
 
+static cvar_t   *net_sim_adr;
+static cvar_t   *net_sim_seed;
+
 #if USE_ICMP
 static cvar_t   *net_ignore_icmp;
 #endif
@@ -146,6 +150,53 @@ static uint64_t     net_bytes_sent;
 static uint64_t     net_packets_rcvd;
 static uint64_t     net_packets_sent;
 
+// network condition emulator
+#define NETSIM_MAX_BACKLOG  1000    // max msec of data queued by rate limit
+#define NETSIM_REORDER_MIN  10      // min msec reordered packets are held back
+
+typedef enum {
+    NETSIM_IN,
+    NETSIM_OUT,
+    NETSIM_COUNT
+} netsimdir_t;
+
+typedef struct {
+    list_t      entry;
+    netsrc_t    sock;
+    netadr_t    address;
+    unsigned    time;       // delivery time
+    size_t      len;
+    byte        data[1];
+} netsimpkt_t;
+
+typedef struct {
+    cvar_t      *latency;   // msec
+    cvar_t      *jitter;    // msec
+    cvar_t      *loss;      // percent
+    cvar_t      *reorder;   // percent
+    cvar_t      *dup;       // percent
+    cvar_t      *rate;      // bytes/sec
+
+    bool        enabled;
+    list_t      queue;      // sorted by delivery time
+    unsigned    busy_until; // time link becomes free for rate limit
+    unsigned    busy_frac;  // sub-millisecond remainder of busy_until, in 1/rate ms
+    unsigned    last_time;  // time of last in-order packet
+
+    // statistics
+    uint64_t    packets;
+    uint64_t    bytes;
+    uint64_t    dropped;
+    uint64_t    overflowed;
+    uint64_t    reordered;
+    uint64_t    duplicated;
+} netsim_t;
+
+static netsim_t     net_sim[NETSIM_COUNT];
+static netadr_t     net_sim_filter;
+static uint32_t     net_sim_state;
+static bool         net_sim_active;
+
 //=============================================================================
 
 static size_t NET_NetadrToSockadr(const netadr_t *a, struct sockaddr_storage *s)
@@ -520,6 +571,21 @@ static void NET_Stats_f(void)
 #endif
     Com_Printf("Current upload rate: %zu bytes/sec\n", net_rate_up);
     Com_Printf("Current download rate: %zu bytes/sec\n", net_rate_dn);
+
+    if (net_sim_active) {
+        static const char dirnames[NETSIM_COUNT][4] = { "in", "out" };
+        netsim_t *sim;
+        int i;
+
+        Com_Printf("Network emulator (seed %u):\n", net_sim_seed->integer);
+        for (i = 0, sim = net_sim; i < NETSIM_COUNT; i++, sim++) {
+            Com_Printf("%-3s %"PRIu64" packets, %"PRIu64" bytes, %"PRIu64" dropped, "
+                       "%"PRIu64" overflowed, %"PRIu64" reordered, %"PRIu64" duplicated, "
+                       "%d queued\n", dirnames[i], sim->packets, sim->bytes,
+                       sim->dropped, sim->overflowed, sim->reordered,
+                       sim->duplicated, List_Count(&sim->queue));
+        }
+    }
 }
 
 static size_t NET_UpRate_m(char *buffer, size_t size)
@@ -534,6 +600,308 @@ static size_t NET_DnRate_m(char *buffer, size_t size)
 
 //=============================================================================
 
+/*
+Network condition emulator.
+
+Packets exchanged with addresses matching `net_sim_adr' are passed through
+per-direction queues that simulate latency, jitter, loss, reordering,
+duplication and bandwidth caps. Random decisions are drawn from a private
+PRNG seeded with `net_sim_seed' each time the emulator is enabled, so runs
+are repeatable and don't disturb the global random sequence.
+*/
+
+static bool NET_SendPacketDirect(netsrc_t sock, const void *data,
+                                 size_t len, const netadr_t *to);
+
+static uint32_t NET_SimRand(void)
+{
+    uint32_t x = net_sim_state;
+
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+
+    return net_sim_state = x;
+}
+
+static bool NET_SimChance(float percent)
+{
+    if (percent <= 0)
+        return false;
+
+    return (NET_SimRand() >> 8) * 0x1p-24f * 100.0f < percent;
+}
+
+static void NET_SimClear(netsim_t *sim)
+{
+    netsimpkt_t *pkt, *next;
+
+    LIST_FOR_EACH_SAFE(netsimpkt_t, pkt, next, &sim->queue, entry)
+        Z_Free(pkt);
+
+    List_Init(&sim->queue);
+}
+
+static void NET_SimReset(void)
+{
+    netsim_t *sim;
+    int i;
+
+    net_sim_state = net_sim_seed->integer ^ 0x9e3779b9;
+    if (!net_sim_state)
+        net_sim_state = 1;
+
+    for (i = 0, sim = net_sim; i < NETSIM_COUNT; i++, sim++) {
+        sim->busy_until = sim->last_time = Sys_Milliseconds();
+        sim->busy_frac = 0;
+        sim->packets = sim->bytes = 0;
+        sim->dropped = sim->overflowed = 0;
+        sim->reordered = sim->duplicated = 0;
+    }
+}
+
+static bool NET_SimMatch(const netadr_t *adr)
+{
+    if (net_sim_filter.type == NA_UNSPECIFIED)
+        return true;
+
+    if (net_sim_filter.port)
+        return NET_IsEqualAdr(adr, &net_sim_filter);
+
+    return NET_IsEqualBaseAdr(adr, &net_sim_filter);
+}
+
+static void NET_SimQueue(netsim_t *sim, netsrc_t sock, const void *data,
+                         size_t len, const netadr_t *adr, unsigned time)
+{
+    netsimpkt_t *pkt, *cur;
+
+    pkt = Z_Malloc(sizeof(*pkt) + len - 1);
+    pkt->sock = sock;
+    pkt->address = *adr;
+    pkt->time = time;
+    pkt->len = len;
+    memcpy(pkt->data, data, len);
+
+    // keep the queue sorted by delivery time, most packets go to the tail
+    for (cur = LIST_LAST(netsimpkt_t, &sim->queue, entry);
+         !LIST_TERM(cur, &sim->queue, entry);
+         cur = LIST_PREV(netsimpkt_t, cur, entry)) {
+        if ((int)(time - cur->time) >= 0)
+            break;
+    }
+
+    List_Link(&cur->entry, cur->entry.next, &pkt->entry);
+}
+
+/*
+=============
+NET_SimPacket
+
+Passes packet through the network emulator. Returns true if packet was
+consumed (dropped or queued for delayed delivery).
+=============
+*/
+static bool NET_SimPacket(netsimdir_t dir, netsrc_t sock, const void *data,
+                          size_t len, const netadr_t *adr)
+{
+    netsim_t *sim = &net_sim[dir];
+    unsigned now, time;
+
+    if (!sim->enabled)
+        return false;
+
+    if (!NET_SimMatch(adr))
+        return false;
+
+    sim->packets++;
+    sim->bytes += len;
+
+    if (NET_SimChance(sim->loss->value)) {
+        sim->dropped++;
+        return true;
+    }
+
+    now = time = Sys_Milliseconds();
+
+    // serialize packets on the link if bandwidth is capped
+    if (sim->rate->integer > 0) {
+        uint64_t busy;
+
+        if ((int)(sim->busy_until - now) < 0) {
+            sim->busy_until = now;
+            sim->busy_frac = 0;
+        }
+        if (sim->busy_until - now > NETSIM_MAX_BACKLOG) {
+            sim->overflowed++;
+            return true;
+        }
+
+        // carry the remainder over, small packets take less than 1 ms
+        busy = (uint64_t)len * 1000 + sim->busy_frac;
+        sim->busy_until += busy / sim->rate->integer;
+        sim->busy_frac = busy % sim->rate->integer;
+        time = sim->busy_until;
+    }
+
+    if (sim->latency->integer > 0)
+        time += sim->latency->integer;
+
+    if (sim->jitter->integer > 0)
+        time += NET_SimRand() % (sim->jitter->integer + 1);
+
+    if (NET_SimChance(sim->reorder->value)) {
+        // hold this packet back so that following ones overtake it
+        time += max(sim->jitter->integer, NETSIM_REORDER_MIN);
+        sim->reordered++;
+    } else {
+        // jitter alone doesn't reorder packets
+        if ((int)(time - sim->last_time) < 0)
+            time = sim->last_time;
+        sim->last_time = time;
+    }
+
+    NET_SimQueue(sim, sock, data, len, adr, time);
+
+    if (NET_SimChance(sim->dup->value)) {
+        NET_SimQueue(sim, sock, data, len, adr, time);
+        sim->duplicated++;
+    }
+
+    return true;
+}
+
+// sends delayed outgoing packets that are due
+static void NET_SimSend(void)
+{
+    netsim_t *sim = &net_sim[NETSIM_OUT];
+    unsigned now = Sys_Milliseconds();
+    netsimpkt_t *pkt;
+
+    while (!LIST_EMPTY(&sim->queue)) {
+        pkt = LIST_FIRST(netsimpkt_t, &sim->queue, entry);
+        if ((int)(now - pkt->time) < 0)
+            break;
+
+        List_Remove(&pkt->entry);
+        NET_SendPacketDirect(pkt->sock, pkt->data, pkt->len, &pkt->address);
+        Z_Free(pkt);
+    }
+}
+
+// delivers delayed incoming packets that are due
+static void NET_SimReceive(netsrc_t sock, void (*packet_cb)(void))
+{
+    netsim_t *sim = &net_sim[NETSIM_IN];
+    unsigned now = Sys_Milliseconds();
+    netsimpkt_t *pkt;
+
+    while (1) {
+        LIST_FOR_EACH(netsimpkt_t, pkt, &sim->queue, entry) {
+            if ((int)(now - pkt->time) < 0)
+                return;
+            if (pkt->sock == sock)
+                break;
+        }
+
+        if (LIST_TERM(pkt, &sim->queue, entry))
+            return;
+
+        List_Remove(&pkt->entry);
+
+        memcpy(msg_read_buffer, pkt->data, pkt->len);
+        net_from = pkt->address;
+
+        SZ_Init(&msg_read, msg_read_buffer, sizeof(msg_read_buffer));
+        msg_read.cursize = pkt->len;
+
+        Z_Free(pkt);
+
+        (*packet_cb)();
+    }
+}
+
+static void net_sim_param_changed(cvar_t *self)
+{
+    bool active = false;
+    netsim_t *sim;
+    int i;
+
+    for (i = 0, sim = net_sim; i < NETSIM_COUNT; i++, sim++) {
+        sim->enabled =
+            sim->latency->integer > 0 || sim->jitter->integer > 0 ||
+            sim->loss->value > 0 || sim->reorder->value > 0 ||
+            sim->dup->value > 0 || sim->rate->integer > 0;
+        active |= sim->enabled;
+    }
+
+    // restart random sequence each time emulator is enabled
+    if (active && (!net_sim_active || self == net_sim_seed))
+        NET_SimReset();
+
+    net_sim_active = active;
+}
+
+static void net_sim_adr_changed(cvar_t *self)
+{
+    memset(&net_sim_filter, 0, sizeof(net_sim_filter));
+
+    if (!*self->string)
+        return;
+
+    if (!Q_stricmp(self->string, "loopback")) {
+        net_sim_filter.type = NA_LOOPBACK;
+        return;
+    }
+
+    if (!NET_StringToAdr(self->string, &net_sim_filter, 0)) {
+        Com_WPrintf("Bad network emulator address: %s\n", self->string);
+        memset(&net_sim_filter, 0, sizeof(net_sim_filter));
+    }
+}
+
+static void NET_SimInit(void)
+{
+    static const char dirnames[NETSIM_COUNT][4] = { "in", "out" };
+    netsim_t *sim;
+    int i;
+
+    for (i = 0, sim = net_sim; i < NETSIM_COUNT; i++, sim++) {
+        sim->latency = Cvar_Get(va("net_sim_latency_%s", dirnames[i]), "0", 0);
+        sim->latency->changed = net_sim_param_changed;
+        sim->jitter = Cvar_Get(va("net_sim_jitter_%s", dirnames[i]), "0", 0);
+        sim->jitter->changed = net_sim_param_changed;
+        sim->loss = Cvar_Get(va("net_sim_loss_%s", dirnames[i]), "0", 0);
+        sim->loss->changed = net_sim_param_changed;
+        sim->reorder = Cvar_Get(va("net_sim_reorder_%s", dirnames[i]), "0", 0);
+        sim->reorder->changed = net_sim_param_changed;
+        sim->dup = Cvar_Get(va("net_sim_dup_%s", dirnames[i]), "0", 0);
+        sim->dup->changed = net_sim_param_changed;
+        sim->rate = Cvar_Get(va("net_sim_rate_%s", dirnames[i]), "0", 0);
+        sim->rate->changed = net_sim_param_changed;
+        List_Init(&sim->queue);
+    }
+
+    net_sim_adr = Cvar_Get("net_sim_adr", "", 0);
+    net_sim_adr->changed = net_sim_adr_changed;
+    net_sim_seed = Cvar_Get("net_sim_seed", "1", 0);
+    net_sim_seed->changed = net_sim_param_changed;
+
+    net_sim_adr_changed(net_sim_adr);
+    net_sim_param_changed(NULL);
+}
+
+static void NET_SimShutdown(void)
+{
+    if (!net_sim_seed)
+        return;
+
+    NET_SimClear(&net_sim[NETSIM_IN]);
+    NET_SimClear(&net_sim[NETSIM_OUT]);
+}
+
+//=============================================================================
+
 #if USE_CLIENT
 
 static void NET_GetLoopPackets(netsrc_t sock, void (*packet_cb)(void))
@@ -551,19 +919,26 @@ static void NET_GetLoopPackets(netsrc_t sock, void (*packet_cb)(void))
         loopmsg = &loop->msgs[loop->get & (MAX_LOOPBACK - 1)];
         loop->get++;
 
-        memcpy(msg_read_buffer, loopmsg->data, loopmsg->datalen);
-
         NET_LogPacket(&net_from, "LP recv", loopmsg->data, loopmsg->datalen);
 
         if (sock == NS_CLIENT) {
             net_rate_rcvd += loopmsg->datalen;
         }
 
-        SZ_Init(&msg_read, msg_read_buffer, sizeof(msg_read_buffer));
+        if (net_sim_active && NET_SimPacket(NETSIM_IN, sock, loopmsg->data,
+                                            loopmsg->datalen, &net_from)) {
+            continue;
+        }
+
+        // read directly from the queue, slot can't be reused until the
+        // sender wraps around the whole ring
+        SZ_Init(&msg_read, loopmsg->data, sizeof(loopmsg->data));
         msg_read.cursize = loopmsg->datalen;
 
         (*packet_cb)();
     }
+
+    SZ_Init(&msg_read, msg_read_buffer, sizeof(msg_read_buffer));
 }
 
 static bool NET_SendLoopPacket(netsrc_t sock, const void *data,
@@ -746,22 +1121,22 @@ int NET_Sleep1(int msec, struct pollfd *e)
 
 //=============================================================================
 
-static void NET_GetUdpPackets(struct pollfd *sock, void (*packet_cb)(void))
+static void NET_GetUdpPackets(netsrc_t sock, struct pollfd *s, void (*packet_cb)(void))
 {
     int ret;
 
-    if (!sock)
+    if (!s)
         return;
 
-    Q_assert(!(sock->revents & POLLNVAL));
+    Q_assert(!(s->revents & POLLNVAL));
 
-    if (!(sock->revents & (POLLIN | POLLERR)))
+    if (!(s->revents & (POLLIN | POLLERR)))
         return;
 
     while (1) {
-        ret = os_udp_recv(sock->fd, msg_read_buffer, MAX_PACKETLEN, &net_from);
+        ret = os_udp_recv(s->fd, msg_read_buffer, MAX_PACKETLEN, &net_from);
         if (ret == NET_AGAIN) {
-            sock->revents = 0;
+            s->revents = 0;
             break;
         }
 
@@ -778,6 +1153,11 @@ static void NET_GetUdpPackets(struct pollfd *sock, void (*packet_cb)(void))
         net_bytes_rcvd += ret;
         net_packets_rcvd++;
 
+        if (net_sim_active && NET_SimPacket(NETSIM_IN, sock, msg_read_buffer,
+                                            ret, &net_from)) {
+            continue;
+        }
+
         SZ_Init(&msg_read, msg_read_buffer, sizeof(msg_read_buffer));
         msg_read.cursize = ret;
 
@@ -795,6 +1175,10 @@ net_from variable receives source address.
 */
 void NET_GetPackets(netsrc_t sock, void (*packet_cb)(void))
 {
+    // flush emulated outgoing packets that are due
+    if (!LIST_EMPTY(&net_sim[NETSIM_OUT].queue))
+        NET_SimSend();
+
 #if USE_CLIENT
     memset(&net_from, 0, sizeof(net_from));
     net_from.type = NA_LOOPBACK;
@@ -804,33 +1188,22 @@ void NET_GetPackets(netsrc_t sock, void (*packet_cb)(void))
 #endif
 
     // process UDP packets
-    NET_GetUdpPackets(udp_sockets[sock], packet_cb);
+    NET_GetUdpPackets(sock, udp_sockets[sock], packet_cb);
 
     // process UDP6 packets
-    NET_GetUdpPackets(udp6_sockets[sock], packet_cb);
-}
+    NET_GetUdpPackets(sock, udp6_sockets[sock], packet_cb);
 
-/*
-=============
-NET_SendPacket
+    // process emulated incoming packets that are due
+    if (!LIST_EMPTY(&net_sim[NETSIM_IN].queue))
+        NET_SimReceive(sock, packet_cb);
+}
 
-=============
-*/
-bool NET_SendPacket(netsrc_t sock, const void *data,
-                    size_t len, const netadr_t *to)
+static bool NET_SendPacketDirect(netsrc_t sock, const void *data,
+                                 size_t len, const netadr_t *to)
 {
     int ret;
     struct pollfd *s;
 
-    if (len == 0)
-        return false;
-
-    if (len > MAX_PACKETLEN) {
-        Com_EPrintf("%s: oversize packet to %s\n", __func__,
-                    NET_AdrToString(to));
-        return false;
-    }
-
     switch (to->type) {
     case NA_UNSPECIFIED:
         return false;
@@ -876,6 +1249,33 @@ bool NET_SendPacket(netsrc_t sock, const void *data,
     return true;
 }
 
+/*
+=============
+NET_SendPacket
+
+=============
+*/
+bool NET_SendPacket(netsrc_t sock, const void *data,
+                    size_t len, const netadr_t *to)
+{
+    if (len == 0)
+        return false;
+
+    if (len > MAX_PACKETLEN) {
+        Com_EPrintf("%s: oversize packet to %s\n", __func__,
+                    NET_AdrToString(to));
+        return false;
+    }
+
+    if (to->type == NA_UNSPECIFIED)
+        return false;
+
+    if (net_sim_active && NET_SimPacket(NETSIM_OUT, sock, data, len, to))
+        return true;
+
+    return NET_SendPacketDirect(sock, data, len, to);
+}
+
 //=============================================================================
 
 static void NET_CloseSocket(struct pollfd *s)
@@ -1850,6 +2250,8 @@ void NET_Init(void)
     net_enable_ipv6 = Cvar_Get("net_enable_ipv6", NET_EnableIP6(), 0);
     net_enable_ipv6->changed = net_udp_param_changed;
 
+    NET_SimInit();
+
 #if USE_ICMP
     net_ignore_icmp = Cvar_Get("net_ignore_icmp", "0", 0);
 #endif
@@ -1882,6 +2284,7 @@ void NET_Shutdown(void)
 
     NET_Listen(false);
     NET_Config(NET_NONE);
+    NET_SimShutdown();
     os_net_shutdown();
 
     Cmd_RemoveCommand("net_restart");
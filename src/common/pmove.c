@@ -1019,12 +1019,13 @@ static void PM_ClampAngles(void)
 
 /*
 ================
-Pmove
+PM_BeginMove
 
-Can be called by either the server or the client
+Runs everything up to ground and water friction. Returns false if the
+move has already been completed.
 ================
 */
-void Pmove(pmove_t *pmove, pmoveParams_t *params)
+static bool PM_BeginMove(pmove_t *pmove, pmoveParams_t *params)
 {
     pm = pmove;
     pmp = params;
@@ -1053,7 +1054,7 @@ void Pmove(pmove_t *pmove, pmoveParams_t *params)
         pml.frametime = pmp->speedmult * pm->cmd.msec * 0.001f;
         PM_FlyMove();
         PM_SnapPosition();
-        return;
+        return false;
     }
 
     pml.frametime = pm->cmd.msec * 0.001f;
@@ -1065,7 +1066,7 @@ void Pmove(pmove_t *pmove, pmoveParams_t *params)
     }
 
     if (pm->s.pm_type == PM_FREEZE)
-        return;     // no movement at all
+        return false;   // no movement at all
 
     // set mins, maxs, and viewheight
     PM_CheckDuck();
@@ -1109,23 +1110,38 @@ void Pmove(pmove_t *pmove, pmoveParams_t *params)
         PM_StepSlideMove();
     } else {
         PM_CheckJump();
+        return true;
+    }
 
-        PM_Friction();
+    // set groundentity, watertype, and waterlevel for final spot
+    PM_CategorizePosition();
 
-        if (pm->waterlevel >= 2)
-            PM_WaterMove();
-        else {
-            vec3_t  angles;
+    PM_SnapPosition();
+    return false;
+}
 
-            VectorCopy(pm->viewangles, angles);
-            if (angles[PITCH] > 180)
-                angles[PITCH] = angles[PITCH] - 360;
-            angles[PITCH] /= 3;
+/*
+================
+PM_EndMove
+
+Runs everything after ground and water friction.
+================
+*/
+static void PM_EndMove(void)
+{
+    if (pm->waterlevel >= 2)
+        PM_WaterMove();
+    else {
+        vec3_t  angles;
 
-            AngleVectors(angles, pml.forward, pml.right, pml.up);
+        VectorCopy(pm->viewangles, angles);
+        if (angles[PITCH] > 180)
+            angles[PITCH] = angles[PITCH] - 360;
+        angles[PITCH] /= 3;
 
-            PM_AirMove();
-        }
+        AngleVectors(angles, pml.forward, pml.right, pml.up);
+
+        PM_AirMove();
     }
 
     // set groundentity, watertype, and waterlevel for final spot
@@ -1134,6 +1150,217 @@ void Pmove(pmove_t *pmove, pmoveParams_t *params)
     PM_SnapPosition();
 }
 
+/*
+================
+Pmove
+
+Can be called by either the server or the client
+================
+*/
+void Pmove(pmove_t *pmove, pmoveParams_t *params)
+{
+    if (PM_BeginMove(pmove, params)) {
+        PM_Friction();
+        PM_EndMove();
+    }
+}
+
+/*
+================
+PmoveBatch
+
+Runs a number of independent moves, giving the same results as calling
+Pmove for each of them in turn. Moves are advanced in lockstep: the
+scalar parts run one move at a time, while friction is applied to the
+whole batch from packed arrays, 4 lanes at once where SSE2 or AArch64
+NEON is available.
+
+Traces are still issued one at a time through pm->trace, as the game
+API has no batched trace call. Moves may not affect each other's traces
+(e.g. by relinking entities in between), since the order of trace calls
+is different from Pmove.
+================
+*/
+#define PM_BATCH    16
+
+typedef struct {
+    pmove_t     *pm;
+    pml_t       pml;
+} pmlane_t;
+
+typedef struct {
+    float   vx[PM_BATCH], vy[PM_BATCH], vz[PM_BATCH];
+    float   ground[PM_BATCH], water[PM_BATCH], frametime[PM_BATCH];
+} pmfriction_t;
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+
+#include <emmintrin.h>
+
+#define PM_SIMD_LANES   4
+
+// same operations as PM_Friction, in the same order
+static void PM_FrictionSIMD(pmfriction_t *f, int i)
+{
+    __m128  x = _mm_loadu_ps(&f->vx[i]);
+    __m128  y = _mm_loadu_ps(&f->vy[i]);
+    __m128  z = _mm_loadu_ps(&f->vz[i]);
+    __m128  frametime = _mm_loadu_ps(&f->frametime[i]);
+    __m128  water = _mm_loadu_ps(&f->water[i]);
+    __m128  zero = _mm_setzero_ps();
+    __m128  speed, control, drop, newspeed, stop;
+
+    speed = _mm_sqrt_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(x, x), _mm_mul_ps(y, y)), _mm_mul_ps(z, z)));
+    control = _mm_max_ps(speed, _mm_set1_ps(pm_stopspeed));
+
+    drop = _mm_mul_ps(_mm_mul_ps(control, _mm_set1_ps(pmp->friction)), frametime);
+    drop = _mm_and_ps(drop, _mm_cmpneq_ps(_mm_loadu_ps(&f->ground[i]), zero));
+    newspeed = _mm_mul_ps(_mm_mul_ps(_mm_mul_ps(speed, _mm_set1_ps(pmp->waterfriction)), water), frametime);
+    drop = _mm_add_ps(drop, _mm_and_ps(newspeed, _mm_cmpneq_ps(water, zero)));
+
+    newspeed = _mm_max_ps(zero, _mm_sub_ps(speed, drop));
+    newspeed = _mm_div_ps(newspeed, speed);
+
+    stop = _mm_cmplt_ps(speed, _mm_set1_ps(1));
+    x = _mm_andnot_ps(stop, _mm_mul_ps(x, newspeed));
+    y = _mm_andnot_ps(stop, _mm_mul_ps(y, newspeed));
+    z = _mm_or_ps(_mm_and_ps(stop, z), _mm_andnot_ps(stop, _mm_mul_ps(z, newspeed)));
+
+    _mm_storeu_ps(&f->vx[i], x);
+    _mm_storeu_ps(&f->vy[i], y);
+    _mm_storeu_ps(&f->vz[i], z);
+}
+
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+
+#include <arm_neon.h>
+
+#define PM_SIMD_LANES   4
+
+static void PM_FrictionSIMD(pmfriction_t *f, int i)
+{
+    float32x4_t x = vld1q_f32(&f->vx[i]);
+    float32x4_t y = vld1q_f32(&f->vy[i]);
+    float32x4_t z = vld1q_f32(&f->vz[i]);
+    float32x4_t frametime = vld1q_f32(&f->frametime[i]);
+    float32x4_t water = vld1q_f32(&f->water[i]);
+    float32x4_t zero = vdupq_n_f32(0);
+    float32x4_t speed, control, drop, newspeed;
+    uint32x4_t  stop;
+
+    speed = vsqrtq_f32(vaddq_f32(vaddq_f32(vmulq_f32(x, x), vmulq_f32(y, y)), vmulq_f32(z, z)));
+    control = vmaxq_f32(speed, vdupq_n_f32(pm_stopspeed));
+
+    drop = vmulq_f32(vmulq_f32(control, vdupq_n_f32(pmp->friction)), frametime);
+    drop = vbslq_f32(vceqq_f32(vld1q_f32(&f->ground[i]), zero), zero, drop);
+    newspeed = vmulq_f32(vmulq_f32(vmulq_f32(speed, vdupq_n_f32(pmp->waterfriction)), water), frametime);
+    drop = vaddq_f32(drop, vbslq_f32(vceqq_f32(water, zero), zero, newspeed));
+
+    newspeed = vmaxq_f32(zero, vsubq_f32(speed, drop));
+    newspeed = vdivq_f32(newspeed, speed);
+
+    stop = vcltq_f32(speed, vdupq_n_f32(1));
+    x = vbslq_f32(stop, zero, vmulq_f32(x, newspeed));
+    y = vbslq_f32(stop, zero, vmulq_f32(y, newspeed));
+    z = vbslq_f32(stop, z, vmulq_f32(z, newspeed));
+
+    vst1q_f32(&f->vx[i], x);
+    vst1q_f32(&f->vy[i], y);
+    vst1q_f32(&f->vz[i], z);
+}
+
+#else
+
+#define PM_SIMD_LANES   0
+
+#endif
+
+static void PM_BatchFriction(pmlane_t *lanes, int count)
+{
+    pmfriction_t    f;
+    float           speed, control, drop, newspeed;
+    pml_t           *l;
+    int             i;
+
+    for (i = 0; i < count; i++) {
+        l = &lanes[i].pml;
+        pm = lanes[i].pm;
+        f.vx[i] = l->velocity[0];
+        f.vy[i] = l->velocity[1];
+        f.vz[i] = l->velocity[2];
+        f.frametime[i] = l->frametime;
+        f.ground[i] = (pm->groundentity && l->groundsurface && !(l->groundsurface->flags & SURF_SLICK)) || l->ladder;
+        f.water[i] = l->ladder ? 0 : pm->waterlevel;
+    }
+
+    i = 0;
+#if PM_SIMD_LANES
+    for (; i + PM_SIMD_LANES <= count; i += PM_SIMD_LANES)
+        PM_FrictionSIMD(&f, i);
+#endif
+
+    // remaining lanes
+    for (; i < count; i++) {
+        speed = sqrtf(f.vx[i] * f.vx[i] + f.vy[i] * f.vy[i] + f.vz[i] * f.vz[i]);
+        if (speed < 1) {
+            f.vx[i] = 0;
+            f.vy[i] = 0;
+            continue;
+        }
+
+        drop = 0;
+        if (f.ground[i]) {
+            control = speed < pm_stopspeed ? pm_stopspeed : speed;
+            drop += control * pmp->friction * f.frametime[i];
+        }
+        if (f.water[i])
+            drop += speed * pmp->waterfriction * f.water[i] * f.frametime[i];
+
+        newspeed = speed - drop;
+        if (newspeed < 0)
+            newspeed = 0;
+        newspeed /= speed;
+
+        f.vx[i] = f.vx[i] * newspeed;
+        f.vy[i] = f.vy[i] * newspeed;
+        f.vz[i] = f.vz[i] * newspeed;
+    }
+
+    for (i = 0; i < count; i++) {
+        l = &lanes[i].pml;
+        l->velocity[0] = f.vx[i];
+        l->velocity[1] = f.vy[i];
+        l->velocity[2] = f.vz[i];
+    }
+}
+
+void PmoveBatch(pmove_t **moves, int count, pmoveParams_t *params)
+{
+    pmlane_t    lanes[PM_BATCH];
+    int         i, n;
+
+    while (count > 0) {
+        n = 0;
+        for (i = 0; i < count && i < PM_BATCH; i++) {
+            if (PM_BeginMove(moves[i], params)) {
+                lanes[n].pm = moves[i];
+                lanes[n].pml = pml;
+                n++;
+            }
+        }
+        moves += i;
+        count -= i;
+
+        PM_BatchFriction(lanes, n);
+
+        for (i = 0; i < n; i++) {
+            pm = lanes[i].pm;
+            pml = lanes[i].pml;
+            PM_EndMove();
+        }
+    }
+}
+
 void PmoveInit(pmoveParams_t *pmp)
 {
     // set up default pmove parameters
@@ -26,6 +26,7 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #include "refresh/refresh.h"
 #include "system/system.h"
 #include "client/sound/sound.h"
+#include "client/sound/dma.h"
 
 // test error shutdown procedures
 static void Com_Error_f(void)
@@ -540,6 +541,7 @@ static void Com_TestSounds_f(void)
     for (i = 0; i < count; i++) {
         if (i > 0 && !(i & (MAX_SOUNDS_OLD - 1))) {
             S_EndRegistration();
+            S_FinishRegistration();
             S_BeginRegistration();
         }
         if (!S_RegisterSound(va("#%s", (char *)list[i]))) {
@@ -549,6 +551,7 @@ static void Com_TestSounds_f(void)
     }
 
     S_EndRegistration();
+    S_FinishRegistration();
 
     end = Sys_Milliseconds();
 
@@ -557,6 +560,22 @@ static void Com_TestSounds_f(void)
 
     FS_FreeList(list);
 }
+
+#if USE_SNDDMA
+// compares SIMD and scalar DMA mixer loops on random data
+static void Com_TestMixer_f(void)
+{
+    int repeat = 1000;
+    int errors;
+
+    if (Cmd_Argc() > 1)
+        repeat = Q_atoi(Cmd_Argv(1));
+
+    errors = DMA_TestMixer(repeat);
+
+    Com_Printf("%d failures, %d mixer tests\n", errors, repeat * 7);
+}
+#endif
 #endif
 
 static const char *const mdfour_str[] = {
@@ -696,6 +715,9 @@ void TST_Init(void)
 #endif
 #if USE_CLIENT
     Cmd_AddCommand("soundtest", Com_TestSounds_f);
+#if USE_SNDDMA
+    Cmd_AddCommand("mixertest", Com_TestMixer_f);
+#endif
 #endif
     Cmd_AddCommand("mdfourtest", Com_MdfourTest_f);
     Cmd_AddCommand("extcmptest", Com_ExtCmpTest_f);
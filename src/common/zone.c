@@ -42,6 +42,7 @@ typedef struct {
 
 static list_t       z_chain;
 static zstats_t     z_stats[TAG_MAX];
+static size_t       z_allocs;
 
 #define S(d) \
     { .z = { .magic = Z_MAGIC, .tag = TAG_STATIC, .size = sizeof(zstatic_t) }, .data = d }
@@ -191,6 +192,7 @@ void *Z_Realloc(void *ptr, size_t size)
     List_Relink(&z->entry);
 
     Z_CountAlloc(z);
+    z_allocs++;
 
     return z + 1;
 }
@@ -223,6 +225,19 @@ void Z_Stats_f(void)
                bytes, count);
 }
 
+/*
+========================
+Z_AllocCount
+
+Returns total number of heap allocations and reallocations made so far.
+Static strings returned by Z_CvarCopyString are not counted.
+========================
+*/
+size_t Z_AllocCount(void)
+{
+    return z_allocs;
+}
+
 /*
 ========================
 Z_FreeTags
@@ -274,6 +289,7 @@ static void *Z_TagMallocInternal(size_t size, memtag_t tag, bool init)
 #endif
 
     Z_CountAlloc(z);
+    z_allocs++;
 
     return z + 1;
 }
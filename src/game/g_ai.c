@@ -252,6 +252,92 @@ int range(edict_t *self, edict_t *other)
     return RANGE_FAR;
 }
 
+/*
+=============================================================================
+
+LINE OF SIGHT CACHE
+
+Monsters check visibility of the same client from FindTarget and
+ai_checkattack in the same think. Results are cached per (self, other)
+pair for the current frame and reused only if both eye positions are
+exactly the same.
+
+MASK_OPAQUE traces only collide with the world and brush models, so the
+cache is flushed whenever a brush model is linked or unlinked. The
+gi.linkentity and gi.unlinkentity imports are wrapped to notice that, as
+well as gi.setmodel, which links inline models directly in the server.
+
+=============================================================================
+*/
+
+#define LOS_CACHE_SIZE  1024
+
+typedef struct {
+    edict_t     *self;
+    edict_t     *other;
+    int         framenum;
+    unsigned    relinks;
+    vec3_t      spot1;
+    vec3_t      spot2;
+    bool        visible;
+} loscache_t;
+
+static loscache_t   los_cache[LOS_CACHE_SIZE];
+static unsigned     los_relinks;
+
+static void (*los_linkentity)(edict_t *ent);
+static void (*los_unlinkentity)(edict_t *ent);
+static void (*los_setmodel)(edict_t *ent, const char *name);
+
+static void los_check_bmodel(edict_t *ent)
+{
+    // a brush model that stopped being solid still has its model
+    if (ent->solid == SOLID_BSP || (ent->model && ent->model[0] == '*'))
+        los_relinks++;
+}
+
+static void los_link(edict_t *ent)
+{
+    los_check_bmodel(ent);
+    los_linkentity(ent);
+}
+
+static void los_unlink(edict_t *ent)
+{
+    los_check_bmodel(ent);
+    los_unlinkentity(ent);
+}
+
+static void los_model(edict_t *ent, const char *name)
+{
+    if (name && name[0] == '*')
+        los_relinks++;
+    los_setmodel(ent, name);
+}
+
+/*
+=============
+AI_InitLOSCache
+
+Called once from InitGame.
+=============
+*/
+void AI_InitLOSCache(void)
+{
+    memset(los_cache, 0, sizeof(los_cache));
+    los_relinks++;
+
+    if (gi.linkentity == los_link)
+        return;
+
+    los_linkentity = gi.linkentity;
+    los_unlinkentity = gi.unlinkentity;
+    los_setmodel = gi.setmodel;
+    gi.linkentity = los_link;
+    gi.unlinkentity = los_unlink;
+    gi.setmodel = los_model;
+}
+
 /*
 =============
 visible
@@ -264,16 +350,29 @@ bool visible(edict_t *self, edict_t *other)
     vec3_t  spot1;
     vec3_t  spot2;
     trace_t trace;
+    loscache_t *c;
 
     VectorCopy(self->s.origin, spot1);
     spot1[2] += self->viewheight;
     VectorCopy(other->s.origin, spot2);
     spot2[2] += other->viewheight;
+
+    c = &los_cache[((self - g_edicts) * 31 + (other - g_edicts)) & (LOS_CACHE_SIZE - 1)];
+    if (c->self == self && c->other == other && c->framenum == level.framenum &&
+        c->relinks == los_relinks && VectorCompare(c->spot1, spot1) && VectorCompare(c->spot2, spot2))
+        return c->visible;
+
     trace = gi.trace(spot1, vec3_origin, vec3_origin, spot2, self, MASK_OPAQUE);
 
-    if (trace.fraction == 1.0f)
-        return true;
-    return false;
+    c->self = self;
+    c->other = other;
+    c->framenum = level.framenum;
+    c->relinks = los_relinks;
+    VectorCopy(spot1, c->spot1);
+    VectorCopy(spot2, c->spot2);
+    c->visible = trace.fraction == 1.0f;
+
+    return c->visible;
 }
 
 /*
@@ -105,7 +105,9 @@ void Killed(edict_t *targ, edict_t *inflictor, edict_t *attacker, int damage, ve
 
     if (targ->movetype == MOVETYPE_PUSH || targ->movetype == MOVETYPE_STOP || targ->movetype == MOVETYPE_NONE) {
         // doors, triggers, etc
+        G_ProfBegin(targ, PROF_DIE);
         targ->die(targ, inflictor, attacker, damage, point);
+        G_ProfEnd();
         return;
     }
 
@@ -114,7 +116,9 @@ void Killed(edict_t *targ, edict_t *inflictor, edict_t *attacker, int damage, ve
         monster_death_use(targ);
     }
 
+    G_ProfBegin(targ, PROF_DIE);
     targ->die(targ, inflictor, attacker, damage, point);
+    G_ProfEnd();
 }
 
 /*
@@ -368,6 +372,9 @@ void T_Damage(edict_t *targ, edict_t *inflictor, edict_t *attacker, const vec3_t
     if (!targ->takedamage)
         return;
 
+    // pain and die callbacks may reschedule it
+    G_WakeEdict(targ);
+
     // easy mode takes half damage
     if (skill->value == 0 && deathmatch->value == 0 && targ->client) {
         damage *= 0.5f;
@@ -480,17 +487,25 @@ void T_Damage(edict_t *targ, edict_t *inflictor, edict_t *attacker, const vec3_t
     if (targ->svflags & SVF_MONSTER) {
         M_ReactToDamage(targ, attacker);
         if (!(targ->monsterinfo.aiflags & AI_DUCKED) && (take)) {
+            G_ProfBegin(targ, PROF_PAIN);
             targ->pain(targ, attacker, knockback, take);
+            G_ProfEnd();
             // nightmare mode monsters don't go into pain frames often
             if (skill->value == 3)
                 targ->pain_debounce_framenum = level.framenum + 5 * BASE_FRAMERATE;
         }
     } else if (client) {
-        if (!(targ->flags & FL_GODMODE) && (take))
+        if (!(targ->flags & FL_GODMODE) && (take)) {
+            G_ProfBegin(targ, PROF_PAIN);
             targ->pain(targ, attacker, knockback, take);
+            G_ProfEnd();
+        }
     } else if (take) {
-        if (targ->pain)
+        if (targ->pain) {
+            G_ProfBegin(targ, PROF_PAIN);
             targ->pain(targ, attacker, knockback, take);
+            G_ProfEnd();
+        }
     }
 
     // add to the damage inflicted on a player this frame
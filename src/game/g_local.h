@@ -533,6 +533,9 @@ extern  cvar_t  *sv_features;
 
 extern  cvar_t  *sv_flaregun;
 
+extern  cvar_t  *g_think_scheduler;
+extern  cvar_t  *g_profile;
+
 #define world   (&g_edicts[0])
 
 // item spawnflags
@@ -604,6 +607,11 @@ void Touch_Item(edict_t *ent, edict_t *other, cplane_t *plane, csurface_t *surf)
 bool    KillBox(edict_t *ent);
 void    G_ProjectSource(const vec3_t point, const vec3_t distance, const vec3_t forward, const vec3_t right, vec3_t result);
 edict_t *G_Find(edict_t *from, int fieldofs, char *match);
+void    G_IndexEdict(edict_t *ent);
+void    G_UnindexEdict(edict_t *ent);
+void    G_FlushIndex(void);
+void    G_ClearIndex(void);
+void    G_RebuildIndex(void);
 edict_t *findradius(edict_t *from, vec3_t org, float rad);
 edict_t *G_PickTarget(char *targetname);
 void    G_UseTargets(edict_t *ent, edict_t *activator);
@@ -683,6 +691,7 @@ void func_clock_use(edict_t *self, edict_t *other, edict_t *activator);
 // g_ai.c
 //
 void AI_SetSightClient(void);
+void AI_InitLOSCache(void);
 
 void ai_stand(edict_t *self, float dist);
 void ai_move(edict_t *self, float dist);
@@ -782,6 +791,47 @@ void G_RunEntity(edict_t *ent);
 //
 void SaveClientData(void);
 void FetchClientEntData(edict_t *ent);
+void G_WakeEdict(edict_t *ent);
+void G_ResetSchedule(void);
+
+//
+// g_save.c
+//
+void Svcmd_SaveBench_f(void);
+
+//
+// g_prof.c
+//
+typedef enum {
+    PROF_THINK,
+    PROF_TOUCH,
+    PROF_USE,
+    PROF_PAIN,
+    PROF_DIE,
+    PROF_BLOCKED,
+    PROF_PUSHER,
+    PROF_NONE,
+    PROF_NOCLIP,
+    PROF_STEP,
+    PROF_TOSS,
+    PROF_CLIENT,
+
+    PROF_NUM_TYPES
+} proftype_t;
+
+extern bool g_profiling;
+
+void G_ProfBegin_(edict_t *ent, proftype_t type);
+void G_ProfEnd_(void);
+void G_ProfFrame(void);
+void G_ProfReset(void);
+uint64_t G_Microseconds(void);
+void Svcmd_GameProf_f(void);
+
+#define G_ProfBegin(ent, type) \
+    do { if (g_profiling) G_ProfBegin_(ent, type); } while (0)
+#define G_ProfEnd() \
+    do { if (g_profiling) G_ProfEnd_(); } while (0)
 
 //
 // g_chase.c
@@ -1085,5 +1135,9 @@ struct edict_s {
     // common data blocks
     moveinfo_t      moveinfo;
     monsterinfo_t   monsterinfo;
+
+    // G_Find hash chains, 0 = classname, 1 = targetname
+    edict_t     *hash_next[2];
+    const char  *hash_name[2];      // string the edict is currently hashed by
 };
 
@@ -77,8 +77,12 @@ cvar_t  *sv_features;
 
 cvar_t  *sv_flaregun;
 
+cvar_t  *g_think_scheduler;
+cvar_t  *g_profile;
+
 void SpawnEntities(const char *mapname, const char *entities, const char *spawnpoint);
 void ClientThink(edict_t *ent, usercmd_t *cmd);
+static void G_ClientThink(edict_t *ent, usercmd_t *cmd);
 qboolean ClientConnect(edict_t *ent, char *userinfo);
 void ClientUserinfoChanged(edict_t *ent, char *userinfo);
 void ClientDisconnect(edict_t *ent);
@@ -119,6 +123,8 @@ void InitGame(void)
 
     Q_srand(time(NULL));
 
+    AI_InitLOSCache();
+
     gun_x = gi.cvar("gun_x", "0", 0);
     gun_y = gi.cvar("gun_y", "0", 0);
     gun_z = gi.cvar("gun_z", "0", 0);
@@ -183,6 +189,9 @@ void InitGame(void)
 	//   2 = spawn with the flare gun and some grenades
 	sv_flaregun = gi.cvar("sv_flaregun", "2", 0);
 
+    g_think_scheduler = gi.cvar("g_think_scheduler", "0", 0);
+    g_profile = gi.cvar("g_profile", "0", 0);
+
     // enable protocol extensions if supported
     if (sv_features && (int)sv_features->value & GMF_PROTOCOL_EXTENSIONS && (int)g_protocol_extensions->value) {
         features |= GMF_PROTOCOL_EXTENSIONS;
@@ -234,7 +243,7 @@ q_exported game_export_t *GetGameAPI(game_import_t *import)
     globals.WriteLevel = WriteLevel;
     globals.ReadLevel = ReadLevel;
 
-    globals.ClientThink = ClientThink;
+    globals.ClientThink = G_ClientThink;
     globals.ClientConnect = ClientConnect;
     globals.ClientUserinfoChanged = ClientUserinfoChanged;
     globals.ClientDisconnect = ClientDisconnect;
@@ -473,6 +482,211 @@ void ExitLevel(void)
 
 }
 
+/*
+=================
+G_ClientThink
+
+Accounts player movement to the game profiler.
+=================
+*/
+static void G_ClientThink(edict_t *ent, usercmd_t *cmd)
+{
+    G_ProfBegin(ent, PROF_CLIENT);
+    ClientThink(ent, cmd);
+    G_ProfEnd();
+}
+
+/*
+=============================================================================
+
+THINK SCHEDULER
+
+With g_think_scheduler enabled, G_RunFrame only visits edicts that are
+awake. An edict is put to sleep when visiting it would provably do nothing
+until its next think: MOVETYPE_NONE, no prethink and no ground entity.
+Sleeping edicts with a pending think are queued on a min-heap keyed by
+nextthink and woken at the start of that frame. Awake edicts are still
+visited in edict number order, so the order of thinks and physics is the
+same as with the full walk.
+
+Code that calls touch, use, pain or die on another edict must wake it
+with G_WakeEdict, as those may change its state.
+
+=============================================================================
+*/
+
+typedef struct {
+    int     framenum;
+    int     number;
+} thinkslot_t;
+
+#define MAX_THINKSLOTS  (MAX_EDICTS * 2)
+
+static struct {
+    bool        enabled;
+    uint32_t    awake[MAX_EDICTS / 32];
+    int         queued[MAX_EDICTS];     // framenum the edict is queued for
+    thinkslot_t heap[MAX_THINKSLOTS];
+    int         numslots;
+} sched;
+
+/*
+================
+G_ResetSchedule
+
+Wakes up everything. Called whenever g_edicts are replaced wholesale.
+================
+*/
+void G_ResetSchedule(void)
+{
+    memset(sched.awake, 0xff, sizeof(sched.awake));
+    memset(sched.queued, 0, sizeof(sched.queued));
+    sched.numslots = 0;
+}
+
+void G_WakeEdict(edict_t *ent)
+{
+    int num = ent - g_edicts;
+
+    sched.awake[num >> 5] |= BIT(num & 31);
+}
+
+static void push_think(edict_t *ent)
+{
+    thinkslot_t slot, *heap = sched.heap;
+    int i, parent;
+
+    // already queued from an earlier sleep
+    if (sched.queued[ent - g_edicts] == ent->nextthink)
+        return;
+
+    if (sched.numslots == MAX_THINKSLOTS) {
+        // shouldn't happen, but waking too much is always safe
+        G_ResetSchedule();
+        return;
+    }
+
+    slot.framenum = ent->nextthink;
+    slot.number = ent - g_edicts;
+    sched.queued[slot.number] = slot.framenum;
+
+    for (i = sched.numslots++; i > 0; i = parent) {
+        parent = (i - 1) / 2;
+        if (heap[parent].framenum <= slot.framenum)
+            break;
+        heap[i] = heap[parent];
+    }
+    heap[i] = slot;
+}
+
+static void pop_think(void)
+{
+    thinkslot_t slot, *heap = sched.heap;
+    int i, child, n = --sched.numslots;
+
+    slot = heap[n];
+    for (i = 0; (child = i * 2 + 1) < n; i = child) {
+        if (child + 1 < n && heap[child + 1].framenum < heap[child].framenum)
+            child++;
+        if (slot.framenum <= heap[child].framenum)
+            break;
+        heap[i] = heap[child];
+    }
+    heap[i] = slot;
+}
+
+static void wake_due_thinks(void)
+{
+    thinkslot_t *slot = &sched.heap[0];
+
+    while (sched.numslots && slot->framenum <= level.framenum) {
+        if (sched.queued[slot->number] == slot->framenum)
+            sched.queued[slot->number] = 0;
+        G_WakeEdict(&g_edicts[slot->number]);
+        pop_think();
+    }
+}
+
+static bool is_awake(int num)
+{
+    return sched.awake[num >> 5] & BIT(num & 31);
+}
+
+static void try_sleep(edict_t *ent)
+{
+    int num = ent - g_edicts;
+
+    if (ent->inuse) {
+        if (ent->movetype != MOVETYPE_NONE)
+            return;
+        if (ent->prethink || ent->groundentity)
+            return;
+        if (ent->nextthink > 0) {
+            if (ent->nextthink <= level.framenum)
+                return;
+            push_think(ent);
+        }
+    }
+
+    sched.awake[num >> 5] &= ~BIT(num & 31);
+}
+
+static void run_edict(edict_t *ent, int i)
+{
+    // pick up classname and targetname changes made by direct assignment
+    G_IndexEdict(ent);
+
+    level.current_entity = ent;
+
+    if (!(ent->s.renderfx & RF_BEAM))
+        VectorCopy(ent->s.origin, ent->s.old_origin);
+
+    // if the ground entity moved, make sure we are still on it
+    if ((ent->groundentity) && (ent->groundentity->linkcount != ent->groundentity_linkcount)) {
+        ent->groundentity = NULL;
+        if (!(ent->flags & (FL_SWIM | FL_FLY)) && (ent->svflags & SVF_MONSTER)) {
+            M_CheckGround(ent);
+        }
+    }
+
+    if (i > 0 && i <= maxclients->value) {
+        G_ProfBegin(ent, PROF_CLIENT);
+        ClientBeginServerFrame(ent);
+        G_ProfEnd();
+        return;
+    }
+
+    G_RunEntity(ent);
+}
+
+static void run_scheduled(void)
+{
+    edict_t *ent;
+    int     i;
+
+    wake_due_thinks();
+
+    // edicts woken up during the loop are picked up if they are
+    // still ahead of it, just like with the full walk
+    for (i = 0; i < globals.num_edicts; i++) {
+        if (!sched.awake[i >> 5]) {
+            i |= 31;
+            continue;
+        }
+        if (!is_awake(i))
+            continue;
+
+        ent = &g_edicts[i];
+        if (ent->inuse) {
+            run_edict(ent, i);
+            if (i <= maxclients->value)
+                continue;
+        }
+
+        try_sleep(ent);
+    }
+}
+
 /*
 ================
 G_RunFrame
@@ -488,6 +702,11 @@ void G_RunFrame(void)
     level.framenum++;
     level.time = level.framenum * FRAMETIME;
 
+    G_ProfFrame();
+
+    // edicts spawned last frame are picked up by run_edict from now on
+    G_FlushIndex();
+
     // choose a client for monsters to target this frame
     AI_SetSightClient();
 
@@ -501,30 +720,20 @@ void G_RunFrame(void)
     // treat each object in turn
     // even the world gets a chance to think
     //
-    ent = &g_edicts[0];
-    for (i = 0; i < globals.num_edicts; i++, ent++) {
-        if (!ent->inuse)
-            continue;
-
-        level.current_entity = ent;
-
-        if (!(ent->s.renderfx & RF_BEAM))
-            VectorCopy(ent->s.origin, ent->s.old_origin);
-
-        // if the ground entity moved, make sure we are still on it
-        if ((ent->groundentity) && (ent->groundentity->linkcount != ent->groundentity_linkcount)) {
-            ent->groundentity = NULL;
-            if (!(ent->flags & (FL_SWIM | FL_FLY)) && (ent->svflags & SVF_MONSTER)) {
-                M_CheckGround(ent);
-            }
+    if (g_think_scheduler->value) {
+        if (!sched.enabled) {
+            G_ResetSchedule();
+            sched.enabled = true;
         }
-
-        if (i > 0 && i <= maxclients->value) {
-            ClientBeginServerFrame(ent);
-            continue;
+        run_scheduled();
+    } else {
+        sched.enabled = false;
+        ent = &g_edicts[0];
+        for (i = 0; i < globals.num_edicts; i++, ent++) {
+            if (!ent->inuse)
+                continue;
+            run_edict(ent, i);
         }
-
-        G_RunEntity(ent);
     }
 
     // exit intermission right now to avoid annoying fov change
@@ -1553,7 +1553,10 @@ void func_clock_think(edict_t *self)
     }
 
     self->enemy->message = self->message;
+    G_WakeEdict(self->enemy);
+    G_ProfBegin(self->enemy, PROF_USE);
     self->enemy->use(self->enemy, self, self);
+    G_ProfEnd();
 
     if (((self->spawnflags & 1) && (self->health > self->wait)) ||
         ((self->spawnflags & 2) && (self->health < self->wait))) {
@@ -96,7 +96,9 @@ bool SV_RunThink(edict_t *ent)
     ent->nextthink = 0;
     if (!ent->think)
         gi.error("NULL ent->think");
+    G_ProfBegin(ent, PROF_THINK);
     ent->think(ent);
+    G_ProfEnd();
 
     return false;
 }
@@ -115,11 +117,18 @@ void SV_Impact(edict_t *e1, trace_t *trace)
 
     e2 = trace->ent;
 
-    if (e1->touch && e1->solid != SOLID_NOT)
+    if (e1->touch && e1->solid != SOLID_NOT) {
+        G_ProfBegin(e1, PROF_TOUCH);
         e1->touch(e1, e2, &trace->plane, trace->surface);
+        G_ProfEnd();
+    }
 
-    if (e2->touch && e2->solid != SOLID_NOT)
+    if (e2->touch && e2->solid != SOLID_NOT) {
+        G_WakeEdict(e2);
+        G_ProfBegin(e2, PROF_TOUCH);
         e2->touch(e2, e1, NULL, NULL);
+        G_ProfEnd();
+    }
 }
 
 /*
@@ -546,8 +555,11 @@ void SV_Physics_Pusher(edict_t *ent)
 
         // if the pusher has a "blocked" function, call it
         // otherwise, just stay in place until the obstacle is gone
-        if (part->blocked)
+        if (part->blocked) {
+            G_ProfBegin(part, PROF_BLOCKED);
             part->blocked(part, obstacle);
+            G_ProfEnd();
+        }
 #if 0
         // if the pushed entity went away and the pusher is still there
         if (!obstacle->inuse && part->inuse)
@@ -869,24 +881,30 @@ void G_RunEntity(edict_t *ent)
     switch (ent->movetype) {
     case MOVETYPE_PUSH:
     case MOVETYPE_STOP:
+        G_ProfBegin(ent, PROF_PUSHER);
         SV_Physics_Pusher(ent);
         break;
     case MOVETYPE_NONE:
+        G_ProfBegin(ent, PROF_NONE);
         SV_Physics_None(ent);
         break;
     case MOVETYPE_NOCLIP:
+        G_ProfBegin(ent, PROF_NOCLIP);
         SV_Physics_Noclip(ent);
         break;
     case MOVETYPE_STEP:
+        G_ProfBegin(ent, PROF_STEP);
         SV_Physics_Step(ent);
         break;
     case MOVETYPE_TOSS:
     case MOVETYPE_BOUNCE:
     case MOVETYPE_FLY:
     case MOVETYPE_FLYMISSILE:
+        G_ProfBegin(ent, PROF_TOSS);
         SV_Physics_Toss(ent);
         break;
     default:
         gi.error("SV_Physics: bad movetype %i", ent->movetype);
     }
+    G_ProfEnd();
 }
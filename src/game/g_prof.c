@@ -0,0 +1,279 @@
+/*
+Copyright (C) 1997-2001 Id Software, Inc.
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with this program; if not, write to the Free Software Foundation, Inc.,
+51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+// g_prof.c -- per-classname profiling of entity callbacks
+
+#include "g_local.h"
+
+/*
+==============================================================================
+
+GAME PROFILER
+
+Enabled with g_profile 1. Time spent in entity callbacks and physics is
+attributed to the classname of the entity and the callback type. Nested
+callbacks (a think running inside SV_Physics_*, a touch from a trace) are
+subtracted from their parent, so every column is exclusive time. Traces
+are counted by wrapping gi.trace while profiling is on.
+
+Statistics are reset on every map change and dumped with "sv gameprof".
+
+==============================================================================
+*/
+
+#define MAX_PROF_CLASSES    512
+#define MAX_PROF_DEPTH      32
+
+typedef struct {
+    unsigned    calls;
+    unsigned    traces;
+    uint64_t    usec;
+} profstat_t;
+
+typedef struct {
+    char        name[64];
+    profstat_t  stats[PROF_NUM_TYPES];
+} profclass_t;
+
+typedef struct {
+    profclass_t *cls;
+    proftype_t  type;
+    unsigned    traces;
+    uint64_t    start;
+    uint64_t    child;
+} profframe_t;
+
+static const char *const prof_names[PROF_NUM_TYPES] = {
+    "think", "touch", "use", "pain", "die", "blocked",
+    "pusher", "none", "noclip", "step", "toss", "client"
+};
+
+static struct {
+    profclass_t classes[MAX_PROF_CLASSES];
+    int         numclasses;
+    profclass_t *overflow;  // always present, used once table is full
+    profframe_t stack[MAX_PROF_DEPTH];
+    int         depth;
+    unsigned    frames;
+    unsigned    traces;     // outside of any callback
+    trace_t     (* q_gameabi trace)(const vec3_t start, const vec3_t mins, const vec3_t maxs, const vec3_t end, edict_t *passent, int contentmask);
+} prof;
+
+bool    g_profiling;
+
+uint64_t G_Microseconds(void)
+{
+    struct timespec ts;
+
+    timespec_get(&ts, TIME_UTC);
+    return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+static profclass_t *prof_class(const char *name)
+{
+    unsigned    hash = 0;
+    const char  *s;
+    profclass_t *cls;
+    int         i;
+
+    if (!name || !*name)
+        name = "noclass";
+
+    for (s = name; *s; s++)
+        hash = hash * 31 + *s;
+
+    // open addressing, table is never shrunk during a map
+    for (i = 0; i < MAX_PROF_CLASSES; i++) {
+        cls = &prof.classes[(hash + i) & (MAX_PROF_CLASSES - 1)];
+        if (!cls->name[0]) {
+            if (prof.numclasses == MAX_PROF_CLASSES - 1)
+                break;
+            Q_strlcpy(cls->name, name, sizeof(cls->name));
+            prof.numclasses++;
+            return cls;
+        }
+        if (!strcmp(cls->name, name))
+            return cls;
+    }
+
+    return prof.overflow;
+}
+
+static trace_t q_gameabi prof_trace(const vec3_t start, const vec3_t mins, const vec3_t maxs, const vec3_t end, edict_t *passent, int contentmask)
+{
+    if (prof.depth)
+        prof.stack[prof.depth - 1].traces++;
+    else
+        prof.traces++;
+
+    return prof.trace(start, mins, maxs, end, passent, contentmask);
+}
+
+void G_ProfBegin_(edict_t *ent, proftype_t type)
+{
+    profframe_t *f;
+
+    if (prof.depth == MAX_PROF_DEPTH) {
+        prof.depth++;   // keep G_ProfEnd balanced
+        return;
+    }
+
+    f = &prof.stack[prof.depth++];
+    f->cls = prof_class(ent->classname);
+    f->type = type;
+    f->traces = 0;
+    f->child = 0;
+    f->start = G_Microseconds();
+}
+
+void G_ProfEnd_(void)
+{
+    profframe_t *f;
+    profstat_t  *st;
+    uint64_t    elapsed;
+
+    if (!prof.depth)
+        return;
+    if (prof.depth-- > MAX_PROF_DEPTH)
+        return;
+
+    f = &prof.stack[prof.depth];
+    elapsed = G_Microseconds() - f->start;
+
+    st = &f->cls->stats[f->type];
+    st->calls++;
+    st->traces += f->traces;
+    st->usec += elapsed > f->child ? elapsed - f->child : 0;
+
+    if (prof.depth)
+        prof.stack[prof.depth - 1].child += elapsed;
+}
+
+/*
+=================
+G_ProfFrame
+
+Called at the start of each server frame. Profiling is only switched
+on or off here, so that begin and end calls always pair up.
+=================
+*/
+void G_ProfFrame(void)
+{
+    g_profiling = g_profile->value;
+
+    // a callback may have been interrupted by gi.error
+    prof.depth = 0;
+
+    if (g_profiling) {
+        if (gi.trace != prof_trace) {
+            prof.trace = gi.trace;
+            gi.trace = prof_trace;
+        }
+        prof.frames++;
+    } else if (gi.trace == prof_trace) {
+        gi.trace = prof.trace;
+    }
+}
+
+void G_ProfReset(void)
+{
+    memset(prof.classes, 0, sizeof(prof.classes));
+    prof.numclasses = 0;
+    prof.overflow = prof_class("overflow");
+    prof.depth = 0;
+    prof.frames = 0;
+    prof.traces = 0;
+}
+
+typedef struct {
+    const profclass_t   *cls;
+    proftype_t          type;
+} profline_t;
+
+static int proflinecmp(const void *p1, const void *p2)
+{
+    const profline_t *l1 = p1;
+    const profline_t *l2 = p2;
+    uint64_t t1 = l1->cls->stats[l1->type].usec;
+    uint64_t t2 = l2->cls->stats[l2->type].usec;
+
+    return (t1 < t2) - (t1 > t2);
+}
+
+/*
+=================
+Svcmd_GameProf_f
+
+sv gameprof [reset|<count>]
+=================
+*/
+void Svcmd_GameProf_f(void)
+{
+    static profline_t   lines[MAX_PROF_CLASSES * PROF_NUM_TYPES];
+    const profclass_t   *cls;
+    const profstat_t    *st;
+    uint64_t            total = 0;
+    unsigned            traces = prof.traces;
+    int                 i, j, n, count = 40;
+    char                *arg = gi.argv(2);
+
+    if (!Q_stricmp(arg, "reset")) {
+        G_ProfReset();
+        gi.cprintf(NULL, PRINT_HIGH, "Game profile reset.\n");
+        return;
+    }
+    if (*arg)
+        count = atoi(arg);
+
+    if (!g_profile->value && !prof.frames) {
+        gi.cprintf(NULL, PRINT_HIGH, "Set g_profile to 1 to enable profiling.\n");
+        return;
+    }
+
+    n = 0;
+    for (i = 0; i < MAX_PROF_CLASSES; i++) {
+        cls = &prof.classes[i];
+        if (!cls->name[0])
+            continue;
+        for (j = 0; j < PROF_NUM_TYPES; j++) {
+            st = &cls->stats[j];
+            if (!st->calls)
+                continue;
+            total += st->usec;
+            traces += st->traces;
+            lines[n].cls = cls;
+            lines[n].type = j;
+            n++;
+        }
+    }
+
+    qsort(lines, n, sizeof(lines[0]), proflinecmp);
+
+    gi.cprintf(NULL, PRINT_HIGH,
+               "type    classname                    calls     msec  usec/call  traces\n"
+               "------- ------------------------ --------- -------- ---------- -------\n");
+    for (i = 0; i < n && i < count; i++) {
+        st = &lines[i].cls->stats[lines[i].type];
+        gi.cprintf(NULL, PRINT_HIGH, "%-7s %-24.24s %9u %8.1f %10.1f %7u\n",
+                   prof_names[lines[i].type], lines[i].cls->name, st->calls,
+                   st->usec * 0.001, (double)st->usec / st->calls, st->traces);
+    }
+
+    gi.cprintf(NULL, PRINT_HIGH, "%u frames, %.1f msec total, %.3f msec/frame, %u traces\n",
+               prof.frames, total * 0.001,
+               prof.frames ? total * 0.001 / prof.frames : 0.0, traces);
+}
@@ -443,14 +443,72 @@ static const save_field_t gamefields[] = {
 
 //=========================================================
 
-static void write_data(void *buf, size_t len, gzFile f)
+/*
+Writes are collected in a buffer and handed to zlib in large blocks rather
+than one call per field. A NULL file is used for benchmarking
+serialization alone: data is discarded, or kept in membuf if it is set up,
+to be read back from there.
+*/
+static struct {
+    byte    data[0x10000];
+    size_t  len;
+    size_t  total;
+} writebuf;
+
+static struct {
+    byte    *data;
+    size_t  size;
+    size_t  len;
+    size_t  pos;    // read position
+} membuf;
+
+static void close_write(gzFile f)
 {
-    if (gzwrite(f, buf, len) != len) {
+    writebuf.len = 0;
+    if (f)
         gzclose(f);
-        gi.error("%s: couldn't write %zu bytes", __func__, len);
+}
+
+static void write_block(gzFile f, const void *buf, size_t len)
+{
+    if (f) {
+        if (gzwrite(f, buf, len) != len) {
+            close_write(f);
+            gi.error("%s: couldn't write %zu bytes", __func__, len);
+        }
+    } else if (membuf.data) {
+        if (len > membuf.size - membuf.len)
+            gi.error("%s: memory buffer overflowed", __func__);
+        memcpy(membuf.data + membuf.len, buf, len);
+        membuf.len += len;
     }
 }
 
+static void flush_data(gzFile f)
+{
+    size_t len = writebuf.len;
+
+    writebuf.len = 0;
+    if (len)
+        write_block(f, writebuf.data, len);
+}
+
+static void write_data(void *buf, size_t len, gzFile f)
+{
+    writebuf.total += len;
+
+    if (writebuf.len + len > sizeof(writebuf.data)) {
+        flush_data(f);
+        if (len > sizeof(writebuf.data)) {
+            write_block(f, buf, len);
+            return;
+        }
+    }
+
+    memcpy(writebuf.data + writebuf.len, buf, len);
+    writebuf.len += len;
+}
+
 static void write_short(gzFile f, int16_t v)
 {
     v = LittleShort(v);
@@ -480,7 +538,7 @@ static void write_string(gzFile f, char *s)
 
     len = strlen(s);
     if (len >= 65536) {
-        gzclose(f);
+        close_write(f);
         gi.error("%s: bad length", __func__);
     }
     write_int(f, len);
@@ -505,19 +563,93 @@ static void write_index(gzFile f, void *p, size_t size, const void *start, int m
 
     diff = (uintptr_t)p - (uintptr_t)start;
     if (diff > max_index * size) {
-        gzclose(f);
+        close_write(f);
         gi.error("%s: pointer out of range: %p", __func__, p);
     }
     if (diff % size) {
-        gzclose(f);
+        close_write(f);
         gi.error("%s: misaligned pointer: %p", __func__, p);
     }
     write_int(f, (int)(diff / size));
 }
 
-static void write_pointer(gzFile f, void *p, ptr_type_t type)
+/*
+Reverse index of save_ptrs, hashed by pointer and type. Built on first use,
+save_ptrs never changes while the game library is loaded. If save_ptrs
+outgrows the table, linear search is used instead.
+*/
+#define PTR_HASH_SIZE   2048
+
+static int  ptr_hash[PTR_HASH_SIZE];    // save_ptrs index + 1, 0 if empty
+static bool ptr_hash_built;
+static bool ptr_hash_full;              // too many pointers to index
+static bool ptr_hash_disabled;          // for benchmarking
+
+static unsigned hash_pointer(const void *p, ptr_type_t type)
+{
+    uintptr_t v = (uintptr_t)p;
+
+    v ^= v >> 16;
+    v *= 0x45d9f3b;
+    v ^= v >> 16;
+    return (unsigned)(v + type * 31) & (PTR_HASH_SIZE - 1);
+}
+
+static void build_ptr_hash(void)
+{
+    const save_ptr_t *ptr;
+    unsigned h;
+    int i, j;
+
+    ptr_hash_built = true;
+
+    // keep load factor under 1/2
+    if (num_save_ptrs >= PTR_HASH_SIZE / 2) {
+        gi.dprintf("%s: too many pointers, not indexing\n", __func__);
+        ptr_hash_full = true;
+        return;
+    }
+
+    for (i = 0, ptr = save_ptrs; i < num_save_ptrs; i++, ptr++) {
+        h = hash_pointer(ptr->ptr, ptr->type);
+        for (j = ptr_hash[h]; j; j = ptr_hash[h]) {
+            // keep the first duplicate, like the linear search did
+            if (save_ptrs[j - 1].type == ptr->type && save_ptrs[j - 1].ptr == ptr->ptr)
+                break;
+            h = (h + 1) & (PTR_HASH_SIZE - 1);
+        }
+        if (!j)
+            ptr_hash[h] = i + 1;
+    }
+}
+
+static int find_pointer(const void *p, ptr_type_t type)
 {
     const save_ptr_t *ptr;
+    unsigned h;
+    int i;
+
+    if (!ptr_hash_built)
+        build_ptr_hash();
+
+    if (ptr_hash_full || ptr_hash_disabled) {
+        for (i = 0, ptr = save_ptrs; i < num_save_ptrs; i++, ptr++)
+            if (ptr->type == type && ptr->ptr == p)
+                return i;
+        return -1;
+    }
+
+    for (h = hash_pointer(p, type); (i = ptr_hash[h]); h = (h + 1) & (PTR_HASH_SIZE - 1)) {
+        ptr = &save_ptrs[i - 1];
+        if (ptr->type == type && ptr->ptr == p)
+            return i - 1;
+    }
+
+    return -1;
+}
+
+static void write_pointer(gzFile f, void *p, ptr_type_t type)
+{
     int i;
 
     if (!p) {
@@ -525,15 +657,13 @@ static void write_pointer(gzFile f, void *p, ptr_type_t type)
         return;
     }
 
-    for (i = 0, ptr = save_ptrs; i < num_save_ptrs; i++, ptr++) {
-        if (ptr->type == type && ptr->ptr == p) {
-            write_int(f, i);
-            return;
-        }
+    i = find_pointer(p, type);
+    if (i == -1) {
+        close_write(f);
+        gi.error("%s: unknown pointer: %p", __func__, p);
     }
 
-    gzclose(f);
-    gi.error("%s: unknown pointer: %p", __func__, p);
+    write_int(f, i);
 }
 
 static void write_field(gzFile f, const save_field_t *field, void *base)
@@ -618,10 +748,24 @@ typedef struct game_read_context_s {
     int num_save_ptrs;
 } game_read_context_t;
 
+static void close_read(gzFile f)
+{
+    if (f)
+        gzclose(f);
+}
+
 static void read_data(void *buf, size_t len, gzFile f)
 {
+    if (!f) {
+        if (len > membuf.len - membuf.pos)
+            gi.error("%s: couldn't read %zu bytes", __func__, len);
+        memcpy(buf, membuf.data + membuf.pos, len);
+        membuf.pos += len;
+        return;
+    }
+
     if (gzread(f, buf, len) != len) {
-        gzclose(f);
+        close_read(f);
         gi.error("%s: couldn't read %zu bytes", __func__, len);
     }
 }
@@ -667,7 +811,7 @@ static char *read_string(gzFile f)
     }
 
     if (len < 0 || len >= 65536) {
-        gzclose(f);
+        close_read(f);
         gi.error("%s: bad length", __func__);
     }
 
@@ -684,7 +828,7 @@ static void read_zstring(gzFile f, char *s, size_t size)
 
     len = read_int(f);
     if (len < 0 || len >= size) {
-        gzclose(f);
+        close_read(f);
         gi.error("%s: bad length", __func__);
     }
 
@@ -710,7 +854,7 @@ static void *read_index(gzFile f, size_t size, const void *start, int max_index)
     }
 
     if (index < 0 || index > max_index) {
-        gzclose(f);
+        close_read(f);
         gi.error("%s: bad index", __func__);
     }
 
@@ -729,13 +873,13 @@ static void *read_pointer(game_read_context_t* ctx, ptr_type_t type)
     }
 
     if (index < 0 || index >= ctx->num_save_ptrs) {
-        gzclose(ctx->f);
+        close_read(ctx->f);
         gi.error("%s: bad index", __func__);
     }
 
     ptr = &ctx->save_ptrs[index];
     if (ptr->type != type) {
-        gzclose(ctx->f);
+        close_read(ctx->f);
         gi.error("%s: type mismatch", __func__);
     }
 
@@ -851,18 +995,10 @@ A single player death will automatically restore from the
 last save position.
 ============
 */
-void WriteGame(const char *filename, qboolean autosave)
+static void write_game(gzFile f, bool autosave)
 {
-    gzFile  f;
     int     i;
 
-    if (!autosave)
-        SaveClientData();
-
-    f = gzopen(filename, "wb");
-    if (!f)
-        gi.error("Couldn't open %s", filename);
-
     write_int(f, SAVE_MAGIC1);
     write_int(f, SAVE_VERSION);
 
@@ -874,6 +1010,23 @@ void WriteGame(const char *filename, qboolean autosave)
         write_fields(f, clientfields, &game.clients[i]);
     }
 
+    flush_data(f);
+}
+
+void WriteGame(const char *filename, qboolean autosave)
+{
+    gzFile  f;
+
+    if (!autosave)
+        SaveClientData();
+
+    f = gzopen(filename, "wb");
+    if (!f)
+        gi.error("Couldn't open %s", filename);
+
+    writebuf.len = 0;
+    write_game(f, autosave);
+
     if (gzclose(f))
         gi.error("Couldn't write %s", filename);
 }
@@ -957,15 +1110,10 @@ WriteLevel
 
 =================
 */
-void WriteLevel(const char *filename)
+static void write_level(gzFile f)
 {
     int     i;
     edict_t *ent;
-    gzFile  f;
-
-    f = gzopen(filename, "wb");
-    if (!f)
-        gi.error("Couldn't open %s", filename);
 
     write_int(f, SAVE_MAGIC2);
     write_int(f, SAVE_VERSION);
@@ -983,10 +1131,134 @@ void WriteLevel(const char *filename)
     }
     write_int(f, -1);
 
+    flush_data(f);
+}
+
+void WriteLevel(const char *filename)
+{
+    gzFile  f;
+
+    f = gzopen(filename, "wb");
+    if (!f)
+        gi.error("Couldn't open %s", filename);
+
+    writebuf.len = 0;
+    write_level(f);
+
     if (gzclose(f))
         gi.error("Couldn't write %s", filename);
 }
 
+static void free_strings(const save_field_t *fields, void *base)
+{
+    const save_field_t *field;
+
+    for (field = fields; field->type; field++) {
+        if (field->type == F_LSTRING) {
+            gi.TagFree(*(char **)((byte *)base + field->ofs));
+        }
+    }
+}
+
+// parses what write_game and write_level stored in membuf into scratch
+// copies, leaving the running game alone
+static void read_bench(void)
+{
+    game_read_context_t ctx = make_read_context(NULL, SAVE_VERSION);
+    union {
+        game_locals_t   game;
+        gclient_t       client;
+        level_locals_t  level;
+        edict_t         ent;
+    } *tmp;
+    int i;
+
+    tmp = gi.TagMalloc(sizeof(*tmp), TAG_LEVEL);
+    membuf.pos = 0;
+
+    read_int(NULL);
+    read_int(NULL);
+    read_fields(&ctx, gamefields, &tmp->game);
+    free_strings(gamefields, &tmp->game);
+    for (i = 0; i < game.maxclients; i++) {
+        read_fields(&ctx, clientfields, &tmp->client);
+        free_strings(clientfields, &tmp->client);
+    }
+
+    read_int(NULL);
+    read_int(NULL);
+    read_fields(&ctx, levelfields, &tmp->level);
+    free_strings(levelfields, &tmp->level);
+    while (read_int(NULL) != -1) {
+        read_fields(&ctx, entityfields, &tmp->ent);
+        free_strings(entityfields, &tmp->ent);
+    }
+
+    if (membuf.pos != membuf.len)
+        gi.error("%s: read %zu of %zu bytes", __func__, membuf.pos, membuf.len);
+
+    gi.TagFree(tmp);
+}
+
+/*
+=================
+Svcmd_SaveBench_f
+
+sv savebench [count]
+
+Times serialization of the current game and level without any I/O,
+with and without the pointer index, and parsing it back. Loading isn't
+applied to the running game, so it excludes relinking entities.
+=================
+*/
+void Svcmd_SaveBench_f(void)
+{
+    int         i, j, count = 100;
+    uint64_t    start, usec[3];
+    size_t      bytes = 0;
+
+    if (gi.argc() > 2)
+        count = Q_clip(atoi(gi.argv(2)), 1, 10000);
+
+    if (!g_edicts || !game.clients) {
+        gi.cprintf(NULL, PRINT_HIGH, "No game running.\n");
+        return;
+    }
+
+    for (j = 0; j < 2; j++) {
+        ptr_hash_disabled = j;
+        start = G_Microseconds();
+        for (i = 0; i < count; i++) {
+            writebuf.total = 0;
+            write_game(NULL, false);
+            write_level(NULL);
+            bytes = writebuf.total;
+        }
+        usec[j] = G_Microseconds() - start;
+    }
+    ptr_hash_disabled = false;
+
+    // keep one copy in memory to load from
+    membuf.data = gi.TagMalloc(bytes, TAG_LEVEL);
+    membuf.size = bytes;
+    membuf.len = 0;
+    write_game(NULL, false);
+    write_level(NULL);
+
+    start = G_Microseconds();
+    for (i = 0; i < count; i++)
+        read_bench();
+    usec[2] = G_Microseconds() - start;
+
+    gi.TagFree(membuf.data);
+    memset(&membuf, 0, sizeof(membuf));
+
+    gi.cprintf(NULL, PRINT_HIGH, "%d saves of %zu bytes: %.3f msec/save indexed, "
+               "%.3f msec/save linear, %.3f msec/load\n", count, bytes,
+               usec[0] * 0.001 / count, usec[1] * 0.001 / count,
+               usec[2] * 0.001 / count);
+}
+
 /*
 =================
 ReadLevel
@@ -1022,6 +1294,8 @@ void ReadLevel(const char *filename)
 
     // wipe all the entities
     memset(g_edicts, 0, game.maxentities * sizeof(g_edicts[0]));
+    G_ClearIndex();
+    G_ResetSchedule();
     globals.num_edicts = maxclients->value + 1;
 
     i = read_int(f);
@@ -1095,5 +1369,7 @@ void ReadLevel(const char *filename)
             }
         }
     }
+
+    G_RebuildIndex();
 }
 
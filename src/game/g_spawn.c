@@ -358,6 +358,7 @@ void ED_CallSpawn(edict_t *ent)
         if (!strcmp(item->classname, ent->classname)) {
             // found it
             SpawnItem(ent, item);
+            G_IndexEdict(ent);
             return;
         }
     }
@@ -367,6 +368,7 @@ void ED_CallSpawn(edict_t *ent)
         if (!strcmp(s->name, ent->classname)) {
             // found it
             s->spawn(ent);
+            G_IndexEdict(ent);
             return;
         }
     }
@@ -504,8 +506,10 @@ void ED_ParseEdict(const char **data, edict_t *ent)
         }
     }
 
-    if (!init)
+    if (!init) {
+        G_UnindexEdict(ent);
         memset(ent, 0, sizeof(*ent));
+    }
 }
 
 /*
@@ -583,6 +587,9 @@ void SpawnEntities(const char *mapname, const char *entities, const char *spawnp
 
     memset(&level, 0, sizeof(level));
     memset(g_edicts, 0, game.maxentities * sizeof(g_edicts[0]));
+    G_ClearIndex();
+    G_ResetSchedule();
+    G_ProfReset();
 
     Q_strlcpy(level.mapname, mapname, sizeof(level.mapname));
     Q_strlcpy(game.spawnpoint, spawnpoint, sizeof(game.spawnpoint));
@@ -656,6 +663,9 @@ void SpawnEntities(const char *mapname, const char *entities, const char *spawnp
     }
 #endif
 
+    // spawn functions are free to rename other entities
+    G_RebuildIndex();
+
     G_FindTeams();
 
     PlayerTrail_Init();
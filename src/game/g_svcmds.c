@@ -293,6 +293,10 @@ void    ServerCommand(void)
         SVCmd_ListIP_f();
     else if (Q_stricmp(cmd, "writeip") == 0)
         SVCmd_WriteIP_f();
+    else if (Q_stricmp(cmd, "gameprof") == 0)
+        Svcmd_GameProf_f();
+    else if (Q_stricmp(cmd, "savebench") == 0)
+        Svcmd_SaveBench_f();
     else
         gi.cprintf(NULL, PRINT_HIGH, "Unknown server command \"%s\"\n", cmd);
 }
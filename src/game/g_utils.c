@@ -26,6 +26,171 @@ void G_ProjectSource(const vec3_t point, const vec3_t distance, const vec3_t for
     result[2] = point[2] + forward[2] * distance[0] + right[2] * distance[1] + distance[2];
 }
 
+/*
+=============================================================================
+
+ENTITY NAME INDEX
+
+Edicts are hashed by classname and targetname so that G_Find doesn't have
+to scan every edict. Each chain is kept sorted by edict number, which
+preserves the "next one after from" semantics of the linear search.
+
+Game code assigns names directly, so freshly spawned edicts are remembered
+until the next frame and reindexed before every lookup. If too many have
+been spawned, G_Find falls back to scanning until the list is flushed.
+Renaming an edict that was spawned in an earlier frame requires a call to
+G_IndexEdict.
+
+=============================================================================
+*/
+
+#define HASH_CLASSNAME  0
+#define HASH_TARGETNAME 1
+#define HASH_FIELDS     2
+
+#define EDICT_HASH_SIZE 1024
+
+#define MAX_PENDING_EDICTS  256
+
+static edict_t  *edict_hash[HASH_FIELDS][EDICT_HASH_SIZE];
+
+static edict_t  *pending_edicts[MAX_PENDING_EDICTS];
+static int      num_pending_edicts;     // > MAX_PENDING_EDICTS if overflowed
+
+static const char *hash_field(edict_t *ent, int field)
+{
+    return field == HASH_CLASSNAME ? ent->classname : ent->targetname;
+}
+
+static unsigned hash_name(const char *s)
+{
+    unsigned hash = 0;
+
+    while (*s)
+        hash = hash * 31 + Q_tolower(*s++);
+
+    return hash & (EDICT_HASH_SIZE - 1);
+}
+
+static void unhash_edict(edict_t *ent, int field)
+{
+    edict_t **back;
+
+    if (!ent->hash_name[field])
+        return;
+
+    back = &edict_hash[field][hash_name(ent->hash_name[field])];
+    for (; *back; back = &(*back)->hash_next[field]) {
+        if (*back == ent) {
+            *back = ent->hash_next[field];
+            break;
+        }
+    }
+
+    ent->hash_next[field] = NULL;
+    ent->hash_name[field] = NULL;
+}
+
+static void hash_edict(edict_t *ent, int field)
+{
+    const char *name = ent->inuse ? hash_field(ent, field) : NULL;
+    edict_t **back;
+
+    if (name == ent->hash_name[field])
+        return;
+
+    unhash_edict(ent, field);
+    if (!name)
+        return;
+
+    back = &edict_hash[field][hash_name(name)];
+    while (*back && *back < ent)
+        back = &(*back)->hash_next[field];
+
+    ent->hash_next[field] = *back;
+    ent->hash_name[field] = name;
+    *back = ent;
+}
+
+/*
+=============
+G_IndexEdict
+
+Brings the name index up to date after classname or targetname of the
+edict has been changed. Cheap when nothing has changed.
+=============
+*/
+void G_IndexEdict(edict_t *ent)
+{
+    hash_edict(ent, HASH_CLASSNAME);
+    hash_edict(ent, HASH_TARGETNAME);
+}
+
+void G_UnindexEdict(edict_t *ent)
+{
+    unhash_edict(ent, HASH_CLASSNAME);
+    unhash_edict(ent, HASH_TARGETNAME);
+}
+
+// names of new edicts are assigned after G_Spawn returns
+static void pend_edict(edict_t *ent)
+{
+    if (num_pending_edicts < MAX_PENDING_EDICTS)
+        pending_edicts[num_pending_edicts] = ent;
+    if (num_pending_edicts <= MAX_PENDING_EDICTS)
+        num_pending_edicts++;
+}
+
+static void index_pending(void)
+{
+    int i;
+
+    for (i = 0; i < num_pending_edicts && i < MAX_PENDING_EDICTS; i++)
+        G_IndexEdict(pending_edicts[i]);
+}
+
+/*
+=============
+G_FlushIndex
+
+Called at the start of each frame, from then on renames are picked up
+by G_RunFrame.
+=============
+*/
+void G_FlushIndex(void)
+{
+    index_pending();
+    num_pending_edicts = 0;
+}
+
+/*
+=============
+G_ClearIndex
+
+Must be called whenever g_edicts are wiped without G_FreeEdict.
+=============
+*/
+void G_ClearIndex(void)
+{
+    memset(edict_hash, 0, sizeof(edict_hash));
+    num_pending_edicts = 0;
+}
+
+void G_RebuildIndex(void)
+{
+    int i;
+
+    G_ClearIndex();
+
+    for (i = 0; i < globals.num_edicts; i++) {
+        g_edicts[i].hash_next[HASH_CLASSNAME] = NULL;
+        g_edicts[i].hash_next[HASH_TARGETNAME] = NULL;
+        g_edicts[i].hash_name[HASH_CLASSNAME] = NULL;
+        g_edicts[i].hash_name[HASH_TARGETNAME] = NULL;
+        G_IndexEdict(&g_edicts[i]);
+    }
+}
+
 /*
 =============
 G_Find
@@ -41,6 +206,43 @@ NULL will be returned if the end of the list is reached.
 edict_t *G_Find(edict_t *from, int fieldofs, char *match)
 {
     char    *s;
+    int     field;
+
+    if (fieldofs == FOFS(classname))
+        field = HASH_CLASSNAME;
+    else if (fieldofs == FOFS(targetname))
+        field = HASH_TARGETNAME;
+    else
+        field = -1;
+
+    // too many unindexed edicts, scan
+    if (num_pending_edicts > MAX_PENDING_EDICTS)
+        field = -1;
+
+    if (field != -1) {
+        edict_t *ent;
+
+        index_pending();
+
+        ent = edict_hash[field][hash_name(match)];
+
+        // skip ahead of from, chains are sorted by edict number
+        if (from)
+            while (ent && ent <= from)
+                ent = ent->hash_next[field];
+
+        // entries can be stale until the next G_IndexEdict,
+        // so always check the actual value
+        for (; ent; ent = ent->hash_next[field]) {
+            if (!ent->inuse)
+                continue;
+            s = *(char **)((byte *)ent + fieldofs);
+            if (s && !Q_stricmp(s, match))
+                return ent;
+        }
+
+        return NULL;
+    }
 
     if (!from)
         from = g_edicts;
@@ -218,8 +420,12 @@ void G_UseTargets(edict_t *ent, edict_t *activator)
             if (t == ent) {
                 gi.dprintf("WARNING: Entity used itself.\n");
             } else {
-                if (t->use)
+                if (t->use) {
+                    G_WakeEdict(t);
+                    G_ProfBegin(t, PROF_USE);
                     t->use(t, ent, activator);
+                    G_ProfEnd();
+                }
             }
             if (!ent->inuse) {
                 gi.dprintf("entity was removed while using targets\n");
@@ -313,6 +519,11 @@ void G_InitEdict(edict_t *e)
     e->classname = "noclass";
     e->gravity = 1.0f;
     e->s.number = e - g_edicts;
+
+    G_IndexEdict(e);
+    pend_edict(e);
+
+    G_WakeEdict(e);
 }
 
 /*
@@ -365,6 +576,8 @@ void G_FreeEdict(edict_t *ed)
         return;
     }
 
+    G_UnindexEdict(ed);
+
     memset(ed, 0, sizeof(*ed));
     ed->classname = "freed";
     ed->freetime = level.time;
@@ -396,7 +609,10 @@ void G_TouchTriggers(edict_t *ent)
             continue;
         if (!hit->touch)
             continue;
+        G_WakeEdict(hit);
+        G_ProfBegin(hit, PROF_TOUCH);
         hit->touch(hit, ent, NULL, NULL);
+        G_ProfEnd();
     }
 }
 
@@ -421,8 +637,12 @@ void G_TouchSolids(edict_t *ent)
         hit = touch[i];
         if (!hit->inuse)
             continue;
-        if (ent->touch)
+        if (ent->touch) {
+            G_WakeEdict(hit);
+            G_ProfBegin(ent, PROF_TOUCH);
             ent->touch(hit, ent, NULL, NULL);
+            G_ProfEnd();
+        }
         if (!ent->inuse)
             break;
     }
@@ -53,6 +53,7 @@ void SP_FixCoopSpots(edict_t *self)
             if ((!self->targetname) || Q_stricmp(self->targetname, spot->targetname) != 0) {
 //              gi.dprintf("FixCoopSpots changed %s at %s targetname from %s to %s\n", self->classname, vtos(self->s.origin), self->targetname, spot->targetname);
                 self->targetname = spot->targetname;
+                G_IndexEdict(self);
             }
             return;
         }
@@ -1123,6 +1124,7 @@ void PutClientInServer(edict_t *ent)
     ent->viewheight = 22;
     ent->inuse = true;
     ent->classname = "player";
+    G_IndexEdict(ent);
     ent->mass = 200;
     ent->solid = SOLID_BBOX;
     ent->deadflag = DEAD_NO;
@@ -1628,7 +1630,10 @@ void ClientThink(edict_t *ent, usercmd_t *ucmd)
                 continue;   // duplicated
             if (!other->touch)
                 continue;
+            G_WakeEdict(other);
+            G_ProfBegin(other, PROF_TOUCH);
             other->touch(other, ent, NULL, NULL);
+            G_ProfEnd();
         }
 
     }
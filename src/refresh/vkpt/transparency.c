@@ -818,7 +818,7 @@ static void create_buffers(void)
 
 	buffer_create(
 		&transparency.index_buffer,
-		TR_INDEX_MAX_NUM * sizeof(uint16_t),
+		TR_INDEX_MAX_NUM * sizeof(uint32_t),
 		VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_ACCELERATION_STRUCTURE_BUILD_INPUT_READ_ONLY_BIT_KHR | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT,
 		VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
 	buffer_attach_name(&transparency.vertex_buffer, "transparency index buffer");
@@ -933,13 +933,13 @@ static void create_buffer_views(void)
 
 static void fill_index_buffer(void)
 {
-	uint16_t* indices = (uint16_t*)transparency.host_buffer_shadow;
+	uint32_t* indices = (uint32_t*)transparency.host_buffer_shadow;
 
 	for (size_t i = 0; i < TR_INDEX_MAX_NUM / 6; i++)
 	{
-		uint16_t* quad = indices + i * 6;
+		uint32_t* quad = indices + i * 6;
 
-		const uint16_t base_vertex = i * 4;
+		const uint32_t base_vertex = i * 4;
 		quad[0] = base_vertex + 0;
 		quad[1] = base_vertex + 1;
 		quad[2] = base_vertex + 2;
@@ -948,7 +948,7 @@ static void fill_index_buffer(void)
 		quad[5] = base_vertex + 0;
 	}
 
-	memcpy(transparency.mapped_host_buffer, transparency.host_buffer_shadow, sizeof(uint16_t) * TR_INDEX_MAX_NUM);
+	memcpy(transparency.mapped_host_buffer, transparency.host_buffer_shadow, sizeof(uint32_t) * TR_INDEX_MAX_NUM);
 
 	VkCommandBuffer cmd_buf = vkpt_begin_command_buffer(&qvk.cmd_buffers_transfer);
 
@@ -966,7 +966,7 @@ static void fill_index_buffer(void)
 		0, 0, NULL, 1, &pre_barrier, 0, NULL);
 
 	const VkBufferCopy region = {
-		.size = TR_INDEX_MAX_NUM * sizeof(uint16_t)
+		.size = TR_INDEX_MAX_NUM * sizeof(uint32_t)
 	};
 
 	vkCmdCopyBuffer(cmd_buf, transparency.host_buffer, transparency.index_buffer.buffer, 1, &region);
@@ -634,6 +634,22 @@ static void dump_lag(void)
     }
 }
 
+static void dump_netchan(void)
+{
+    client_t    *cl;
+
+    Com_Printf(
+        "num name            sent     frag     retr     choke    drop\n"
+        "--- --------------- -------- -------- -------- -------- --------\n");
+
+    FOR_EACH_CLIENT(cl) {
+        Com_Printf("%3i %-15.15s %8u %8u %8u %8u %8u\n",
+                   cl->number, cl->name, cl->netchan.outgoing_sequence,
+                   cl->netchan.total_fragments, cl->netchan.total_retransmits,
+                   cl->suppress_total, cl->netchan.total_dropped);
+    }
+}
+
 static void dump_protocols(void)
 {
     client_t    *cl;
@@ -699,12 +715,13 @@ static void SV_Status_f(void)
             switch (*w) {
             case 'd': dump_downloads(); break;
             case 'l': dump_lag();       break;
+            case 'n': dump_netchan();   break;
             case 'p': dump_protocols(); break;
             case 's': dump_settings();  break;
             case 't': dump_time();      break;
             case 'v': dump_versions();  break;
             default:
-                Com_Printf("Usage: %s [d|l|p|s|t|v]\n", Cmd_Argv(0));
+                Com_Printf("Usage: %s [d|l|n|p|s|t|v]\n", Cmd_Argv(0));
                 dump_clients();
                 break;
             }
@@ -797,6 +814,9 @@ void SV_PrintMiscInfo(void)
                sv_client->min_ping, AVG_PING(sv_client), sv_client->max_ping);
     Com_Printf("PL server to client  %.2f%% (approx)\n", PL_S2C(sv_client));
     Com_Printf("PL client to server  %.2f%%\n", PL_C2S(sv_client));
+    Com_Printf("fragments sent       %u\n", sv_client->netchan.total_fragments);
+    Com_Printf("reliable resends     %u\n", sv_client->netchan.total_retransmits);
+    Com_Printf("rate suppressed      %u\n", sv_client->suppress_total);
 #if USE_PACKETDUP
     Com_Printf("packetdup            %d\n", sv_client->numpackets - 1);
 #endif
@@ -840,6 +860,171 @@ static void SV_DumpUser_f(void)
     sv_player = NULL;
 }
 
+/*
+===============================================================================
+
+BANDWIDTH ACCOUNTING
+
+===============================================================================
+*/
+
+static const char *const netstat_names[NETSTAT_COUNT] = {
+    [svc_bad]                   = "other",
+    [svc_muzzleflash]           = "muzzleflash",
+    [svc_muzzleflash2]          = "muzzleflash2",
+    [svc_temp_entity]           = "temp_entity",
+    [svc_layout]                = "layout",
+    [svc_inventory]             = "inventory",
+    [svc_nop]                   = "nop",
+    [svc_disconnect]            = "disconnect",
+    [svc_reconnect]             = "reconnect",
+    [svc_sound]                 = "sound",
+    [svc_print]                 = "print",
+    [svc_stufftext]             = "stufftext",
+    [svc_serverdata]            = "serverdata",
+    [svc_configstring]          = "configstring",
+    [svc_spawnbaseline]         = "spawnbaseline",
+    [svc_centerprint]           = "centerprint",
+    [svc_download]              = "download",
+    [svc_playerinfo]            = "playerinfo",
+    [svc_packetentities]        = "packetentities",
+    [svc_deltapacketentities]   = "deltapacketentities",
+    [svc_frame]                 = "frame_msg",
+    [svc_zpacket]               = "zpacket",
+    [svc_zdownload]             = "zdownload",
+    [svc_gamestate]             = "gamestate",
+    [svc_setting]               = "setting",
+    [svc_configstringstream]    = "configstringstream",
+    [svc_baselinestream]        = "baselinestream",
+    [NETSTAT_FRAME]             = "frame",
+    [NETSTAT_ENTITIES]          = "entities",
+};
+
+static void dump_netstats(const netstats_t *ns)
+{
+    uint64_t total = 0;
+    int i;
+
+    for (i = 0; i < NETSTAT_COUNT; i++) {
+        total += ns->bytes[i];
+    }
+
+    Com_Printf(
+        "type                count      bytes        %%\n"
+        "------------------- ---------- ------------ -----\n");
+
+    for (i = 0; i < NETSTAT_COUNT; i++) {
+        if (!ns->count[i]) {
+            continue;
+        }
+        Com_Printf("%-19s %10u %12"PRIu64" %5.1f\n", netstat_names[i],
+                   ns->count[i], ns->bytes[i], ns->bytes[i] * 100.0 / total);
+    }
+
+    Com_Printf("\nPayload: %"PRIu64" bytes\n", total);
+    Com_Printf("Sent: %"PRIu64" bytes in %u packets\n", ns->sent, ns->packets);
+}
+
+/*
+==================
+SV_NetStats_f
+
+Show bandwidth used by each message type
+==================
+*/
+static void SV_NetStats_f(void)
+{
+    client_t *client;
+
+    if (!svs.initialized) {
+        Com_Printf("No server running.\n");
+        return;
+    }
+
+    if (Cmd_Argc() < 2) {
+        dump_netstats(&svs.netstats);
+        return;
+    }
+
+    if (!strcmp(Cmd_Argv(1), "reset")) {
+        memset(&svs.netstats, 0, sizeof(svs.netstats));
+        FOR_EACH_CLIENT(client) {
+            memset(&client->netstats, 0, sizeof(client->netstats));
+        }
+        return;
+    }
+
+    if (!SV_SetPlayer())
+        return;
+
+    dump_netstats(&sv_client->netstats);
+
+    sv_client = NULL;
+    sv_player = NULL;
+}
+
+static void log_netstats(qhandle_t f, time_t now, int number,
+                         const char *name, const netstats_t *ns)
+{
+    int i;
+
+    FS_FPrintf(f, "%"PRId64" %d sent:%"PRIu64":%u", (int64_t)now,
+               number, ns->sent, ns->packets);
+
+    for (i = 0; i < NETSTAT_COUNT; i++) {
+        if (ns->count[i]) {
+            FS_FPrintf(f, " %s:%"PRIu64":%u", netstat_names[i],
+                       ns->bytes[i], ns->count[i]);
+        }
+    }
+
+    FS_FPrintf(f, " \"%s\"\n", name);
+}
+
+/*
+==================
+SV_NetStatsFrame
+
+Periodically appends bandwidth totals to the log file, one line for the
+server followed by one line per client. Each line lists space separated
+type:bytes:count triples.
+==================
+*/
+void SV_NetStatsFrame(void)
+{
+    char buffer[MAX_OSPATH];
+    client_t *client;
+    qhandle_t f;
+    time_t now;
+
+    if (sv_netstats_log->integer <= 0) {
+        return;
+    }
+
+    if (svs.realtime - svs.last_netstats_dump < sv_netstats_log->integer * 1000) {
+        return;
+    }
+
+    svs.last_netstats_dump = svs.realtime;
+
+    f = FS_EasyOpenFile(buffer, sizeof(buffer), FS_MODE_APPEND | FS_FLAG_TEXT,
+                        "logs/", sv_netstats_log_name->string, ".log");
+    if (!f) {
+        Cvar_Set("sv_netstats_log", "0");
+        return;
+    }
+
+    now = time(NULL);
+    log_netstats(f, now, -1, "", &svs.netstats);
+    FOR_EACH_CLIENT(client) {
+        log_netstats(f, now, client->number, client->name, &client->netstats);
+    }
+
+    FS_CloseFile(f);
+}
+
+//===========================================================
+
 /*
 ==================
 SV_Stuff_f
@@ -1750,6 +1935,7 @@ static const cmdreg_t c_server[] = {
     { "status", SV_Status_f },
     { "serverinfo", SV_Serverinfo_f },
     { "dumpuser", SV_DumpUser_f, SV_SetPlayer_c },
+    { "sv_netstats", SV_NetStats_f, SV_SetPlayer_c },
     { "stuff", SV_Stuff_f, SV_SetPlayer_c },
     { "stuffall", SV_StuffAll_f },
     { "stuffcvar", SV_StuffCvar_f, SV_SetPlayer_c },
@@ -1760,6 +1946,7 @@ static const cmdreg_t c_server[] = {
 #endif
     { "gamemap", SV_GameMap_f, SV_Map_c },
     { "dumpents", SV_DumpEnts_f },
+    { "pmovetest", SV_PmoveTest_f },
     { "setmaster", SV_SetMaster_f },
     { "listmasters", SV_ListMasters_f },
     { "killserver", SV_KillServer_f },
@@ -47,6 +47,7 @@ static void SV_EmitPacketEntities(client_t         *client,
     const entity_packed_t *oldent;
     int i, oldnum, newnum, oldindex, newindex, from_num_entities;
     msgEsFlags_t flags;
+    size_t start = msg_write.cursize;
 
     if (!from)
         from_num_entities = 0;
@@ -133,6 +134,8 @@ static void SV_EmitPacketEntities(client_t         *client,
     }
 
     MSG_WriteShort(0);      // end of packetentities
+
+    SV_AccountBytes(client, NETSTAT_ENTITIES, msg_write.cursize - start);
 }
 
 static client_frame_t *get_last_frame(client_t *client)
@@ -180,6 +183,7 @@ void SV_WriteFrameToClient_Default(client_t *client)
     client_frame_t  *frame, *oldframe;
     player_packed_t *oldstate;
     int             lastframe;
+    size_t          start = msg_write.cursize;
 
     // this is the frame we are creating
     frame = &client->frames[client->framenum & UPDATE_MASK];
@@ -209,8 +213,10 @@ void SV_WriteFrameToClient_Default(client_t *client)
     MSG_WriteByte(svc_playerinfo);
     MSG_WriteDeltaPlayerstate_Default(oldstate, &frame->ps, 0);
 
-    // delta encode the entities
     MSG_WriteByte(svc_packetentities);
+    SV_AccountBytes(client, NETSTAT_FRAME, msg_write.cursize - start);
+
+    // delta encode the entities
     SV_EmitPacketEntities(client, oldframe, frame, 0);
 }
 
@@ -228,6 +234,7 @@ void SV_WriteFrameToClient_Enhanced(client_t *client)
     byte            *b1, *b2;
     msgPsFlags_t    psFlags;
     int             clientEntityNum;
+    size_t          start = msg_write.cursize;
 
     // this is the frame we are creating
     frame = &client->frames[client->framenum & UPDATE_MASK];
@@ -317,6 +324,8 @@ void SV_WriteFrameToClient_Enhanced(client_t *client)
     client->suppress_count = 0;
     client->frameflags = 0;
 
+    SV_AccountBytes(client, NETSTAT_FRAME, msg_write.cursize - start);
+
     // delta encode the entities
     SV_EmitPacketEntities(client, oldframe, frame, clientEntityNum);
 }
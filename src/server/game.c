@@ -680,13 +680,189 @@ static void PF_StartSound(edict_t *entity, int channel,
     SV_StartSound(NULL, entity, channel, soundindex, volume, attenuation, timeofs);
 }
 
+/*
+==============================================================================
+
+PMOVE REPLAY
+
+Moves passed to the game's Pmove can be captured with "pmovetest record"
+and later replayed on the current world through both Pmove and
+PmoveBatch, to verify that the two give bit identical results.
+
+==============================================================================
+*/
+
+typedef struct {
+    pmove_t         pm;     // input state and command
+    edict_t         *passent;
+    pmoveParams_t   pmp;
+} pmrecord_t;
+
+static struct {
+    pmrecord_t  *records;
+    int         numrecords;
+    int         maxrecords;
+    edict_t     *passent;
+} pm_replay;
+
+static void PF_RecordPmove(const pmove_t *pm, const pmoveParams_t *pmp)
+{
+    pmrecord_t *rec = &pm_replay.records[pm_replay.numrecords++];
+
+    rec->pm = *pm;
+    rec->passent = sv_player;
+    rec->pmp = *pmp;
+
+    if (pm_replay.numrecords == pm_replay.maxrecords)
+        Com_Printf("Recorded %d moves.\n", pm_replay.numrecords);
+}
+
 void PF_Pmove(pmove_t *pm)
 {
-    if (sv_client) {
-        Pmove(pm, &sv_client->pmp);
-    } else {
-        Pmove(pm, &sv_pmp);
+    pmoveParams_t *pmp = sv_client ? &sv_client->pmp : &sv_pmp;
+
+    if (pm_replay.numrecords < pm_replay.maxrecords)
+        PF_RecordPmove(pm, pmp);
+
+    Pmove(pm, pmp);
+}
+
+static trace_t q_gameabi SV_ReplayTrace(const vec3_t start, const vec3_t mins, const vec3_t maxs, const vec3_t end)
+{
+    return SV_Trace(start, mins, maxs, end, pm_replay.passent, MASK_PLAYERSOLID);
+}
+
+static void SV_ReplayStart(pmove_t *pm, const pmrecord_t *rec)
+{
+    *pm = rec->pm;
+    pm->trace = SV_ReplayTrace;
+    pm->pointcontents = SV_PointContents;
+}
+
+static bool SV_ReplayEqual(const pmove_t *a, const pmove_t *b)
+{
+    int i;
+
+    if (memcmp(&a->s, &b->s, sizeof(a->s)))
+        return false;
+    if (!VectorCompare(a->viewangles, b->viewangles) || a->viewheight != b->viewheight)
+        return false;
+    if (!VectorCompare(a->mins, b->mins) || !VectorCompare(a->maxs, b->maxs))
+        return false;
+    if (a->groundentity != b->groundentity || a->watertype != b->watertype || a->waterlevel != b->waterlevel)
+        return false;
+    if (a->numtouch != b->numtouch)
+        return false;
+    for (i = 0; i < a->numtouch; i++)
+        if (a->touchents[i] != b->touchents[i])
+            return false;
+
+    return true;
+}
+
+// replay moves in runs that share passent and parameters
+static int SV_ReplayMoves(pmove_t *ref, pmove_t *batch, pmove_t **list, unsigned *ref_msec, unsigned *batch_msec)
+{
+    const pmrecord_t *rec = pm_replay.records;
+    int i, j, n, mismatches = 0;
+    unsigned time;
+
+    for (i = 0; i < pm_replay.numrecords; i += n) {
+        for (n = 1; i + n < pm_replay.numrecords; n++)
+            if (rec[i + n].passent != rec[i].passent || memcmp(&rec[i + n].pmp, &rec[i].pmp, sizeof(rec[i].pmp)))
+                break;
+
+        pm_replay.passent = rec[i].passent;
+
+        for (j = 0; j < n; j++) {
+            SV_ReplayStart(&ref[j], &rec[i + j]);
+            SV_ReplayStart(&batch[j], &rec[i + j]);
+            list[j] = &batch[j];
+        }
+
+        time = Sys_Milliseconds();
+        for (j = 0; j < n; j++)
+            Pmove(&ref[j], &pm_replay.records[i].pmp);
+        *ref_msec += Sys_Milliseconds() - time;
+
+        time = Sys_Milliseconds();
+        PmoveBatch(list, n, &pm_replay.records[i].pmp);
+        *batch_msec += Sys_Milliseconds() - time;
+
+        for (j = 0; j < n; j++)
+            if (!SV_ReplayEqual(&ref[j], &batch[j]))
+                mismatches++;
+    }
+
+    return mismatches;
+}
+
+static int replaycmp(const void *p1, const void *p2)
+{
+    const pmrecord_t *r1 = p1;
+    const pmrecord_t *r2 = p2;
+
+    if (r1->passent != r2->passent)
+        return r1->passent < r2->passent ? -1 : 1;
+    return memcmp(&r1->pmp, &r2->pmp, sizeof(r1->pmp));
+}
+
+/*
+==================
+SV_PmoveTest_f
+
+pmovetest record [count]
+pmovetest [repeat]
+==================
+*/
+void SV_PmoveTest_f(void)
+{
+    pmove_t     *ref, *batch, **list;
+    unsigned    ref_msec = 0, batch_msec = 0;
+    int         i, count, mismatches = 0;
+
+    if (!sv.cm.cache) {
+        Com_Printf("No map loaded.\n");
+        return;
+    }
+
+    if (!strcmp(Cmd_Argv(1), "record")) {
+        count = Cmd_Argc() > 2 ? Q_atoi(Cmd_Argv(2)) : 4096;
+        count = Q_clip(count, 1, 1 << 20);
+        Z_Free(pm_replay.records);
+        pm_replay.records = Z_Malloc(count * sizeof(pm_replay.records[0]));
+        pm_replay.numrecords = 0;
+        pm_replay.maxrecords = count;
+        Com_Printf("Recording next %d moves.\n", count);
+        return;
+    }
+
+    if (!pm_replay.numrecords) {
+        Com_Printf("No moves recorded.\n");
+        return;
     }
+
+    count = Cmd_Argc() > 1 ? Q_clip(Q_atoi(Cmd_Argv(1)), 1, 1000) : 1;
+
+    // stop recording, replays must not add to the list
+    pm_replay.maxrecords = pm_replay.numrecords;
+
+    // group moves of the same player together for batching
+    qsort(pm_replay.records, pm_replay.numrecords, sizeof(pm_replay.records[0]), replaycmp);
+
+    ref = Z_Malloc(pm_replay.numrecords * sizeof(ref[0]));
+    batch = Z_Malloc(pm_replay.numrecords * sizeof(batch[0]));
+    list = Z_Malloc(pm_replay.numrecords * sizeof(list[0]));
+
+    for (i = 0; i < count; i++)
+        mismatches += SV_ReplayMoves(ref, batch, list, &ref_msec, &batch_msec);
+
+    Z_Free(ref);
+    Z_Free(batch);
+    Z_Free(list);
+
+    Com_Printf("%d moves x %d: %d mismatches, Pmove %u msec, PmoveBatch %u msec\n",
+               pm_replay.numrecords, count, mismatches, ref_msec, batch_msec);
 }
 
 static cvar_t *PF_cvar(const char *name, const char *value, int flags)
@@ -861,6 +1037,10 @@ void SV_ShutdownGameProgs(void)
     }
     Cvar_Set("g_features", "0");
 
+    // recorded moves point to game edicts
+    Z_Freep((void **)&pm_replay.records);
+    pm_replay.numrecords = pm_replay.maxrecords = 0;
+
     Z_LeakTest(TAG_FREE);
 }
 
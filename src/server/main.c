@@ -100,6 +100,8 @@ cvar_t  *sv_iplimit;
 cvar_t  *sv_status_limit;
 cvar_t  *sv_status_show;
 cvar_t  *sv_uptime;
+cvar_t  *sv_netstats_log;
+cvar_t  *sv_netstats_log_name;
 cvar_t  *sv_auth_limit;
 cvar_t  *sv_rcon_limit;
 cvar_t  *sv_namechange_limit;
@@ -223,6 +225,8 @@ void SV_DropClient(client_t *client, const char *reason)
     client->state = cs_zombie;        // become free in a few seconds
     client->lastmessage = svs.realtime;
 
+    SV_InvalidateQueryCache();
+
     // print the reason
     if (reason)
         print_drop_reason(client, reason, oldstate);
@@ -466,6 +470,55 @@ static size_t SV_StatusString(char *status)
     return total;
 }
 
+/*
+================
+SV_InvalidateQueryCache
+
+Called when anything visible in status or info replies changes.
+================
+*/
+void SV_InvalidateQueryCache(void)
+{
+    svs.querycache.status_len = 0;
+    svs.querycache.info_len = 0;
+}
+
+/*
+================
+SV_CheckQueryCache
+
+Detects changes not caught by SV_InvalidateQueryCache callers: serverinfo
+cvars and scores or pings updated by the game.
+================
+*/
+static void SV_CheckQueryCache(void)
+{
+    client_t    *cl;
+    int         frags;
+    bool        changed = false;
+
+    if (cvar_modified & CVAR_SERVERINFO) {
+        cvar_modified &= ~CVAR_SERVERINFO;
+        changed = true;
+    }
+
+    FOR_EACH_CLIENT(cl) {
+        if (cl->state == cs_zombie) {
+            continue;
+        }
+        frags = cl->edict->client->ps.stats[STAT_FRAGS];
+        if (cl->status_frags != frags || cl->status_ping != cl->ping) {
+            cl->status_frags = frags;
+            cl->status_ping = cl->ping;
+            changed = true;
+        }
+    }
+
+    if (changed) {
+        SV_InvalidateQueryCache();
+    }
+}
+
 /*
 ================
 SVC_Status
@@ -475,8 +528,7 @@ Responds with all the info that qplug or qspy can see
 */
 static void SVC_Status(void)
 {
-    char    buffer[MAX_PACKETLEN_DEFAULT];
-    size_t  len;
+    time_t  now;
 
     if (!sv_status_show->integer) {
         return;
@@ -488,14 +540,23 @@ static void SVC_Status(void)
         return;
     }
 
-    // write the packet header
-    memcpy(buffer, "\xff\xff\xff\xffprint\n", 10);
-    len = 10;
+    // uptime changes every second
+    now = sv_uptime->integer > 0 ? time(NULL) : 0;
 
-    len += SV_StatusString(buffer + len);
+    if (!svs.querycache.status_len ||
+        svs.querycache.status_show != sv_status_show->integer ||
+        svs.querycache.status_time != now) {
+        // write the packet header
+        memcpy(svs.querycache.status, "\xff\xff\xff\xffprint\n", 10);
+        svs.querycache.status_len = 10 +
+            SV_StatusString(svs.querycache.status + 10);
+        svs.querycache.status_show = sv_status_show->integer;
+        svs.querycache.status_time = now;
+    }
 
     // send the datagram
-    NET_SendPacket(NS_SERVER, buffer, len, &net_from);
+    NET_SendPacket(NS_SERVER, svs.querycache.status,
+                   svs.querycache.status_len, &net_from);
 }
 
 /*
@@ -528,8 +589,6 @@ The second parameter should be the current protocol version number.
 */
 static void SVC_Info(void)
 {
-    char    buffer[MAX_QPATH+10];
-    size_t  len;
     int     version;
 
     if (sv_maxclients->integer == 1)
@@ -539,12 +598,16 @@ static void SVC_Info(void)
     if (version < PROTOCOL_VERSION_DEFAULT || version > PROTOCOL_VERSION_Q2PRO)
         return; // ignore invalid versions
 
-    len = Q_scnprintf(buffer, sizeof(buffer),
-                      "\xff\xff\xff\xffinfo\n%16s %8s %2i/%2i\n",
-                      sv_hostname->string, sv.name, SV_CountClients(),
-                      sv_maxclients->integer - sv_reserved_slots->integer);
+    if (!svs.querycache.info_len) {
+        svs.querycache.info_len = Q_scnprintf(
+            svs.querycache.info, sizeof(svs.querycache.info),
+            "\xff\xff\xff\xffinfo\n%16s %8s %2i/%2i\n",
+            sv_hostname->string, sv.name, SV_CountClients(),
+            sv_maxclients->integer - sv_reserved_slots->integer);
+    }
 
-    NET_SendPacket(NS_SERVER, buffer, len, &net_from);
+    NET_SendPacket(NS_SERVER, svs.querycache.info,
+                   svs.querycache.info_len, &net_from);
 }
 
 /*
@@ -1165,9 +1228,11 @@ static void SVC_DirectConnect(void)
         newcl->WriteFrame = SV_WriteFrameToClient_Enhanced;
     }
 
-    // loopback client doesn't need to reconnect
+    // loopback client doesn't need to reconnect, and compressing
+    // messages for it is a waste of time
     if (NET_IsLocalAddress(&net_from)) {
         newcl->reconnected = true;
+        newcl->has_zlib = false;
     }
 
     // add them to the linked list of connected clients
@@ -1900,6 +1965,8 @@ Returns amount of extra frametime available for sleeping on IO.
 */
 unsigned SV_Frame(unsigned msec)
 {
+    bool busy = false;
+
 #if USE_CLIENT
     time_before_game = time_after_game = 0;
 #endif
@@ -1915,6 +1982,9 @@ unsigned SV_Frame(unsigned msec)
 #if USE_MVD_CLIENT
     // run connections to MVD/GTV servers
     MVD_Frame();
+
+    // advance background demo conversions
+    busy = MVD_ConvertFrame();
 #endif
 
     // read packets from UDP clients
@@ -1934,7 +2004,7 @@ unsigned SV_Frame(unsigned msec)
     // move autonomous things around if enough time has passed
     sv.frameresidual += msec;
     if (sv.frameresidual < SV_FRAMETIME) {
-        return SV_FRAMETIME - sv.frameresidual;
+        return busy ? 0 : SV_FRAMETIME - sv.frameresidual;
     }
 
     if (svs.initialized && !check_paused()) {
@@ -1953,6 +2023,12 @@ unsigned SV_Frame(unsigned msec)
         // send messages back to the UDP clients
         SV_SendClientMessages();
 
+        // dump bandwidth statistics if needed
+        SV_NetStatsFrame();
+
+        // drop cached status replies if scores or pings changed
+        SV_CheckQueryCache();
+
         // send a heartbeat to the master if needed
         SV_MasterHeartbeat();
 
@@ -1971,7 +2047,7 @@ unsigned SV_Frame(unsigned msec)
     // decide how long to sleep next frame
     sv.frameresidual -= SV_FRAMETIME;
     if (sv.frameresidual < SV_FRAMETIME) {
-        return SV_FRAMETIME - sv.frameresidual;
+        return busy ? 0 : SV_FRAMETIME - sv.frameresidual;
     }
 
     // don't accumulate bogus residual
@@ -2030,6 +2106,8 @@ void SV_UserinfoChanged(client_t *cl)
     }
     memcpy(cl->name, name, len + 1);
 
+    SV_InvalidateQueryCache();
+
     // rate command
     val = Info_ValueForKey(cl->userinfo, "rate");
     if (*val) {
@@ -2250,6 +2328,9 @@ void SV_Init(void)
 
     sv_uptime = Cvar_Get("sv_uptime", "0", 0);
 
+    sv_netstats_log = Cvar_Get("sv_netstats_log", "0", 0);
+    sv_netstats_log_name = Cvar_Get("sv_netstats_log_name", "netstats", 0);
+
     sv_auth_limit = Cvar_Get("sv_auth_limit", "1", 0);
     sv_auth_limit->changed = sv_auth_limit_changed;
 
@@ -2371,6 +2452,8 @@ void SV_Shutdown(const char *finalmsg, error_type_t type)
 
     AC_Disconnect();
 
+    SV_FinishAutoSave();
+
     SV_MvdShutdown(type);
 
     SV_FinalMessage(finalmsg, type);
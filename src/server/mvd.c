@@ -35,14 +35,15 @@ typedef struct {
     clstate_t   state;
     netstream_t stream;
 #if USE_ZLIB
-    z_stream    z;
+    bool        deflate;    // receives output of the shared compressor
+    uLong       adler;      // checksum of uncompressed data sent
+    bool        header;     // zlib header not sent yet
 #endif
     unsigned    msglen;
     unsigned    lastmessage;
 
     unsigned    flags;
     unsigned    maxbuf;
-    unsigned    bufcount;
 
     byte        buffer[MAX_GTC_MSGLEN + 4]; // recv buffer
     byte        *data; // send buffer
@@ -79,6 +80,18 @@ typedef struct {
 
     // TCP client pool
     gtv_client_t    *clients; // [sv_mvd_maxclients]
+
+#if USE_ZLIB
+    // single raw deflate stream shared by all GTV clients. Output goes to
+    // z_owner, or to all active clients if NULL. Each switch of the owner
+    // is preceded by a full flush, so that every client receives a valid
+    // zlib stream made of independently decodable chunks.
+    z_stream        z;
+    gtv_client_t    *z_owner;
+    bool            z_pending;  // data fed since last full flush
+    bool            z_busy;     // inside deflate_stream()
+    unsigned        z_frames;   // frames fed since last full flush
+#endif
 } mvd_server_t;
 
 static mvd_server_t     mvd;
@@ -113,10 +126,14 @@ static bool     mvd_enable(void);
 static void     mvd_disable(void);
 static void     mvd_error(const char *reason);
 
+static void     drop_client(gtv_client_t *client, const char *error);
 static void     write_stream(gtv_client_t *client, void *data, size_t len);
 static void     write_message(gtv_client_t *client, gtv_serverop_t op);
+static void     write_active(void *data, size_t len);
+static void     write_active_message(gtv_serverop_t op);
+static void     flush_active(bool force);
 #if USE_ZLIB
-static void     flush_stream(gtv_client_t *client, int flush);
+static void     flush_stream(gtv_client_t *client);
 #endif
 
 static void     rec_stop(void);
@@ -182,7 +199,7 @@ static void dummy_record_f(void)
         return;
     }
 
-    f = FS_EasyOpenFile(buffer, sizeof(buffer), FS_MODE_WRITE,
+    f = FS_EasyOpenFile(buffer, sizeof(buffer), FS_MODE_WRITE | FS_FLAG_ASYNC,
                         "demos/", Cmd_Argv(1), ".mvd2");
     if (!f) {
         return;
@@ -811,16 +828,9 @@ static void emit_frame(void)
 
 static void suspend_streams(void)
 {
-    gtv_client_t *client;
-
-    FOR_EACH_ACTIVE_GTV(client) {
-        // send stream suspend marker
-        write_message(client, GTS_STREAM_DATA);
-#if USE_ZLIB
-        flush_stream(client, Z_SYNC_FLUSH);
-#endif
-        NET_UpdateStream(&client->stream);
-    }
+    // send stream suspend marker
+    write_active_message(GTS_STREAM_DATA);
+    flush_active(true);
 
     Com_DPrintf("Suspending MVD streams.\n");
     mvd.active = false;
@@ -828,20 +838,13 @@ static void suspend_streams(void)
 
 static void resume_streams(void)
 {
-    gtv_client_t *client;
-
     // build and emit gamestate
     build_gamestate();
     emit_gamestate();
 
-    FOR_EACH_ACTIVE_GTV(client) {
-        // send gamestate
-        write_message(client, GTS_STREAM_DATA);
-#if USE_ZLIB
-        flush_stream(client, Z_SYNC_FLUSH);
-#endif
-        NET_UpdateStream(&client->stream);
-    }
+    // send gamestate
+    write_active_message(GTS_STREAM_DATA);
+    flush_active(true);
 
     // write it to demofile
     if (mvd.recording) {
@@ -1009,7 +1012,6 @@ SV_MvdEndFrame
 */
 void SV_MvdEndFrame(void)
 {
-    gtv_client_t *client;
     size_t total;
     byte header[3];
 
@@ -1061,18 +1063,11 @@ void SV_MvdEndFrame(void)
     header[2] = GTS_STREAM_DATA;
 
     // send frame to clients
-    FOR_EACH_ACTIVE_GTV(client) {
-        write_stream(client, header, sizeof(header));
-        write_stream(client, mvd.message.data, mvd.message.cursize);
-        write_stream(client, msg_write.data, msg_write.cursize);
-        write_stream(client, mvd.datagram.data, mvd.datagram.cursize);
-#if USE_ZLIB
-        if (++client->bufcount > client->maxbuf) {
-            flush_stream(client, Z_SYNC_FLUSH);
-        }
-#endif
-        NET_UpdateStream(&client->stream);
-    }
+    write_active(header, sizeof(header));
+    write_active(mvd.message.data, mvd.message.cursize);
+    write_active(msg_write.data, msg_write.cursize);
+    write_active(mvd.datagram.data, mvd.datagram.cursize);
+    flush_active(false);
 
     // write frame to demofile
     if (mvd.recording) {
@@ -1310,42 +1305,146 @@ static void remove_client(gtv_client_t *client)
 }
 
 #if USE_ZLIB
-static void flush_stream(gtv_client_t *client, int flush)
+static void emit_stream(gtv_client_t *client, void *data, size_t len)
 {
-    fifo_t *fifo = &client->stream.send;
-    z_streamp z = &client->z;
-    byte *data;
-    size_t len;
-    int ret;
-
     if (client->state <= cs_zombie) {
         return;
     }
-    if (!z->state) {
-        return;
+
+    if (FIFO_Write(&client->stream.send, data, len) != len) {
+        drop_client(client, "overflowed");
     }
+}
+
+// zlib header is deferred until the first deflated output, so that it
+// doesn't arrive together with the uncompressed hello
+static void start_stream(gtv_client_t *client)
+{
+    static const byte header[2] = { 0x78, 0x9c };
+
+    if (client->header) {
+        client->header = false;
+        emit_stream(client, (void *)header, sizeof(header));
+    }
+}
+
+/*
+==================
+deflate_stream
+
+Compresses data once and sends output to the owner of the stream, or to
+all active deflate clients. Full flush resets the dictionary so that data
+that follows doesn't depend on anything sent before.
+==================
+*/
+static void deflate_stream(void *data, size_t len, int flush)
+{
+    byte buffer[MAX_GTS_MSGLEN];
+    z_streamp z = &mvd.z;
+    gtv_client_t *client;
+    int ret;
 
-    z->next_in = NULL;
-    z->avail_in = 0;
+    z->next_in = data;
+    z->avail_in = (uInt)len;
 
+    mvd.z_busy = true;
     do {
-        data = FIFO_Reserve(fifo, &len);
+        z->next_out = buffer;
+        z->avail_out = sizeof(buffer);
+
+        ret = deflate(z, flush);
+        Q_assert(ret != Z_STREAM_ERROR);
+
+        len = sizeof(buffer) - z->avail_out;
         if (!len) {
-            // FIXME: this is not an error when flushing
-            return;
+            continue;
+        }
+
+        if (mvd.z_owner) {
+            emit_stream(mvd.z_owner, buffer, len);
+            continue;
         }
 
-        z->next_out = data;
-        z->avail_out = (uInt)len;
+        FOR_EACH_ACTIVE_GTV(client) {
+            if (client->deflate) {
+                emit_stream(client, buffer, len);
+            }
+        }
+    } while (!z->avail_out);
+    mvd.z_busy = false;
 
-        ret = deflate(z, flush);
+    if (flush == Z_FULL_FLUSH) {
+        mvd.z_pending = false;
+        mvd.z_frames = 0;
+    } else {
+        mvd.z_pending = true;
+    }
 
-        len -= z->avail_out;
-        if (len) {
-            FIFO_Commit(fifo, len);
-            client->bufcount = 0;
+    // owner was dropped while compressing. Complete its block (output is
+    // discarded) so that the next owner doesn't continue it, even if it
+    // reuses the same client slot.
+    if (mvd.z_owner && mvd.z_owner->state <= cs_zombie) {
+        if (mvd.z_pending) {
+            deflate_stream(NULL, 0, Z_FULL_FLUSH);
         }
-    } while (ret == Z_OK);
+        mvd.z_owner = NULL;
+    }
+}
+
+// completes data pending for the previous owner and redirects compressor
+// output to the new one (NULL means all active clients)
+static void switch_stream(gtv_client_t *owner)
+{
+    if (mvd.z_owner == owner) {
+        return;
+    }
+
+    if (mvd.z_pending) {
+        deflate_stream(NULL, 0, Z_FULL_FLUSH);
+    }
+
+    mvd.z_owner = owner;
+}
+
+static void flush_stream(gtv_client_t *client)
+{
+    if (client->deflate && mvd.z_owner == client && mvd.z_pending) {
+        deflate_stream(NULL, 0, Z_FULL_FLUSH);
+    }
+}
+
+// terminates zlib stream with an empty final block and a checksum. Data
+// pending for the client (its own, or shared if it's active) is flushed
+// first. Clients dropped while compressing (i.e. overflowed) are left with
+// a truncated stream.
+static void end_stream(gtv_client_t *client)
+{
+    byte trailer[9];
+
+    if (mvd.z_busy) {
+        return;
+    }
+
+    start_stream(client);
+
+    if (mvd.z_pending && (mvd.z_owner == client || (!mvd.z_owner && client->state == cs_spawned))) {
+        deflate_stream(NULL, 0, Z_FULL_FLUSH);
+    }
+
+    if (mvd.z_owner == client) {
+        mvd.z_owner = NULL;
+    }
+
+    trailer[0] = 1;
+    trailer[1] = 0;
+    trailer[2] = 0;
+    trailer[3] = 0xff;
+    trailer[4] = 0xff;
+    trailer[5] = client->adler >> 24;
+    trailer[6] = client->adler >> 16;
+    trailer[7] = client->adler >> 8;
+    trailer[8] = client->adler;
+    emit_stream(client, trailer, sizeof(trailer));
 }
 #endif
 
@@ -1362,10 +1461,13 @@ static void drop_client(gtv_client_t *client, const char *error)
     }
 
 #if USE_ZLIB
-    if (client->z.state) {
-        // finish zlib stream
-        flush_stream(client, Z_FINISH);
-        deflateEnd(&client->z);
+    if (client->deflate) {
+        // finish zlib stream, still receiving shared data
+        end_stream(client);
+        client->deflate = false;
+        if (client->state <= cs_zombie) {
+            return; // overflowed
+        }
     }
 #endif
 
@@ -1388,50 +1490,99 @@ static void write_stream(gtv_client_t *client, void *data, size_t len)
     }
 
 #if USE_ZLIB
-    if (client->z.state) {
-        z_streamp z = &client->z;
+    if (client->deflate) {
+        start_stream(client);
+        switch_stream(client);
+        client->adler = adler32(client->adler, data, len);
+        deflate_stream(data, len, Z_NO_FLUSH);
+        return;
+    }
+#endif
 
-        z->next_in = data;
-        z->avail_in = (uInt)len;
+    if (FIFO_Write(fifo, data, len) != len) {
+        drop_client(client, "overflowed");
+    }
+}
 
-        do {
-            data = FIFO_Reserve(fifo, &len);
-            if (!len) {
-                drop_client(client, "overflowed");
-                return;
-            }
+static void write_message(gtv_client_t *client, gtv_serverop_t op)
+{
+    byte header[3];
 
-            z->next_out = data;
-            z->avail_out = (uInt)len;
+    WL16(header, msg_write.cursize + 1);
+    header[2] = op;
+    write_stream(client, header, sizeof(header));
 
-            if (deflate(z, Z_NO_FLUSH) != Z_OK) {
-                drop_client(client, "deflate() failed");
-                return;
-            }
+    write_stream(client, msg_write.data, msg_write.cursize);
+}
 
-            len -= z->avail_out;
-            if (len) {
-                FIFO_Commit(fifo, len);
-                client->bufcount = 0;
-            }
-        } while (z->avail_in);
-    } else
+// sends data to all active clients, compressing it only once
+static void write_active(void *data, size_t len)
+{
+    gtv_client_t *client;
+#if USE_ZLIB
+    uLong adler = 0;
+    bool deflate = false;
 #endif
 
-        if (FIFO_Write(fifo, data, len) != len) {
-            drop_client(client, "overflowed");
+    if (!len) {
+        return;
+    }
+
+    FOR_EACH_ACTIVE_GTV(client) {
+#if USE_ZLIB
+        if (client->deflate) {
+            start_stream(client);
+            if (!deflate) {
+                adler = adler32(adler32(0, NULL, 0), data, len);
+                deflate = true;
+            }
+            client->adler = adler32_combine(client->adler, adler, len);
+            continue;
         }
+#endif
+        write_stream(client, data, len);
+    }
+
+#if USE_ZLIB
+    if (deflate) {
+        switch_stream(NULL);
+        deflate_stream(data, len, Z_NO_FLUSH);
+    }
+#endif
 }
 
-static void write_message(gtv_client_t *client, gtv_serverop_t op)
+static void write_active_message(gtv_serverop_t op)
 {
     byte header[3];
 
     WL16(header, msg_write.cursize + 1);
     header[2] = op;
-    write_stream(client, header, sizeof(header));
+    write_active(header, sizeof(header));
 
-    write_stream(client, msg_write.data, msg_write.cursize);
+    write_active(msg_write.data, msg_write.cursize);
+}
+
+// flushes shared data once any client has buffered enough frames
+static void flush_active(bool force)
+{
+    gtv_client_t *client;
+#if USE_ZLIB
+    unsigned maxbuf = UINT_MAX;
+
+    FOR_EACH_ACTIVE_GTV(client) {
+        if (client->deflate) {
+            maxbuf = min(maxbuf, client->maxbuf);
+        }
+    }
+
+    if (!mvd.z_owner && mvd.z_pending && (force || ++mvd.z_frames > maxbuf)) {
+        deflate_stream(NULL, 0, Z_FULL_FLUSH);
+    }
+#endif
+
+    FOR_EACH_ACTIVE_GTV(client) {
+        NET_UpdateStream(&client->stream);
+    }
 }
 
 static bool auth_client(gtv_client_t *client, const char *password)
@@ -1514,12 +1665,20 @@ static void parse_hello(gtv_client_t *client)
 #if USE_ZLIB
     // the rest of the stream will be deflated
     if (flags & GTF_DEFLATE) {
-        client->z.zalloc = SV_zalloc;
-        client->z.zfree = SV_zfree;
-        if (deflateInit(&client->z, Z_DEFAULT_COMPRESSION) != Z_OK) {
-            drop_client(client, "deflateInit failed");
-            return;
+        if (!mvd.z.state) {
+            mvd.z.zalloc = SV_zalloc;
+            mvd.z.zfree = SV_zfree;
+            if (deflateInit2(&mvd.z, Z_DEFAULT_COMPRESSION, Z_DEFLATED,
+                             -MAX_WBITS, 8, Z_DEFAULT_STRATEGY) != Z_OK) {
+                drop_client(client, "deflateInit failed");
+                return;
+            }
         }
+
+        // shared stream is raw, zlib header is written by start_stream
+        client->deflate = true;
+        client->adler = adler32(0, NULL, 0);
+        client->header = true;
     }
 #endif
 
@@ -1537,7 +1696,7 @@ static void parse_ping(gtv_client_t *client)
     write_message(client, GTS_PONG);
 
 #if USE_ZLIB
-    flush_stream(client, Z_SYNC_FLUSH);
+    flush_stream(client);
 #endif
 }
 
@@ -1558,9 +1717,6 @@ static void parse_stream_start(gtv_client_t *client)
 
     maxbuf = MSG_ReadShort();
     client->maxbuf = max(maxbuf, 10);
-    client->state = cs_spawned;
-
-    List_Append(&gtv_active_list, &client->active);
 
     // send ack to client
     write_message(client, GTS_STREAM_START);
@@ -1576,8 +1732,13 @@ static void parse_stream_start(gtv_client_t *client)
     }
 
 #if USE_ZLIB
-    flush_stream(client, Z_SYNC_FLUSH);
+    // start receiving shared data at a full flush boundary
+    flush_stream(client);
 #endif
+
+    client->state = cs_spawned;
+
+    List_Append(&gtv_active_list, &client->active);
 }
 
 static void parse_stream_stop(gtv_client_t *client)
@@ -1587,15 +1748,19 @@ static void parse_stream_stop(gtv_client_t *client)
         return;
     }
 
-    client->state = cs_primed;
-
-    List_Delete(&client->active);
-
-    // send ack to client
+    // send ack to client, this also completes shared data pending
     write_message(client, GTS_STREAM_STOP);
 #if USE_ZLIB
-    flush_stream(client, Z_SYNC_FLUSH);
+    flush_stream(client);
 #endif
+
+    if (client->state != cs_spawned) {
+        return; // overflowed
+    }
+
+    client->state = cs_primed;
+
+    List_Delete(&client->active);
 }
 
 static void parse_stringcmd(gtv_client_t *client)
@@ -2154,6 +2319,12 @@ void SV_MvdShutdown(error_type_t type)
     Z_Free(mvd.entities);
     Z_Free(mvd.clients);
 
+#if USE_ZLIB
+    if (mvd.z.state) {
+        deflateEnd(&mvd.z);
+    }
+#endif
+
     // close server TCP socket
     NET_Listen(false);
 
@@ -2194,6 +2365,7 @@ fail:
 static void rec_stop(void)
 {
     uint16_t msglen;
+    unsigned stalls;
 
     if (!mvd.recording) {
         return;
@@ -2203,6 +2375,12 @@ static void rec_stop(void)
     msglen = 0;
     FS_Write(&msglen, 2, mvd.recording);
 
+    stalls = FS_WriteStalls(mvd.recording);
+    if (stalls) {
+        Com_WPrintf("MVD recording was stalled %u time%s by slow disk.\n",
+                    stalls, stalls == 1 ? "" : "s");
+    }
+
     FS_CloseFile(mvd.recording);
     mvd.recording = 0;
 }
@@ -2253,7 +2431,7 @@ void SV_MvdRecord_f(void)
 {
     char buffer[MAX_OSPATH];
     qhandle_t f;
-    unsigned mode = FS_MODE_WRITE;
+    unsigned mode = FS_MODE_WRITE | FS_FLAG_ASYNC;
     int c;
 
     if (sv.state != ss_game) {
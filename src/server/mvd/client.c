@@ -22,6 +22,8 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 
 #include "client.h"
 #include "server/mvd/protocol.h"
+#include "common/intreadwrite.h"
+#include "common/mdfour.h"
 
 #define FOR_EACH_GTV(gtv) \
     LIST_FOR_EACH(gtv_t, gtv, &mvd_gtv_list, entry)
@@ -43,6 +45,12 @@ typedef enum {
     GTV_NUM_STATES
 } gtv_state_t;
 
+typedef struct {
+    int64_t     filepos;        // offset of gamestate message
+    mvd_snap_t  **snapshots;    // owned by channel while map is played
+    int         numsnapshots;
+} mvd_demomap_t;
+
 typedef struct gtv_s {
     list_t      entry;
 
@@ -79,6 +87,13 @@ typedef struct gtv_s {
     int64_t         demosize, demoofs;
     float           demoprogress;
     bool            demowait;
+
+    // demo seek index
+    mvd_demomap_t   *demomaps;
+    int             numdemomaps;
+    int             demomap;        // map being played, -1 if unknown
+    bool            demoindexed;    // all maps in file are known
+    bool            demodirty;      // index needs to be saved
 } gtv_t;
 
 static const char *const gtv_states[GTV_NUM_STATES] = {
@@ -120,6 +135,7 @@ static cvar_t  *mvd_buffer_size;
 static cvar_t  *mvd_username;
 static cvar_t  *mvd_password;
 static cvar_t  *mvd_snaps;
+static cvar_t  *mvd_demoindex;
 
 // ====================================================================
 
@@ -492,11 +508,12 @@ static int demo_load_message(qhandle_t f)
     return read;
 }
 
-static int demo_skip_map(qhandle_t f)
+static int demo_skip_map(qhandle_t f, int64_t *pos)
 {
     int msglen;
 
     while (1) {
+        *pos = FS_Tell(f);
         if ((msglen = demo_load_message(f)) <= 0) {
             return msglen;
         }
@@ -643,6 +660,7 @@ static void demo_emit_snapshot(mvd_t *mvd)
     else
         mvd->snapshots = Z_Realloc(mvd->snapshots, sizeof(snap) * ALIGN(mvd->numsnapshots + 1, MIN_SNAPSHOTS));
     mvd->snapshots[mvd->numsnapshots++] = snap;
+    gtv->demodirty = true;
 
     Com_DPrintf("[%d] snaplen %zu\n", mvd->framenum, msg_write.cursize);
 
@@ -674,6 +692,333 @@ static mvd_snap_t *demo_find_snapshot(mvd_t *mvd, int64_t dest, bool byte_seek)
     return mvd->snapshots[max(r, 0)];
 }
 
+/*
+====================
+Demo seek index
+
+Gamestate offsets of all maps in the demo file are remembered along with
+snapshots of each map, so that snapshots survive map changes and maps can be
+jumped to directly. Once the end of file is reached, the index is saved into
+a sidecar file and loaded back when the demo is played again. The sidecar
+stores demo size and a checksum of its first and last blocks, so that an index
+of a different demo of the same size is not picked up.
+====================
+*/
+
+#define MVD_INDEX_MAGIC     MakeRawLong('M','I','D','X')
+#define MVD_INDEX_VERSION   2
+
+#define MVD_INDEX_HEADER    24
+#define MVD_INDEX_MAP       12
+#define MVD_INDEX_SNAP      16
+
+#define MVD_INDEX_SAMPLE    0x10000
+
+#define MIN_DEMOMAPS        16
+
+static void free_snapshots(mvd_snap_t **snapshots, int count)
+{
+    int i;
+
+    for (i = 0; i < count; i++) {
+        Z_Free(snapshots[i]);
+    }
+    Z_Free(snapshots);
+}
+
+static void demo_free_index(gtv_t *gtv)
+{
+    int i;
+
+    for (i = 0; i < gtv->numdemomaps; i++) {
+        free_snapshots(gtv->demomaps[i].snapshots, gtv->demomaps[i].numsnapshots);
+    }
+    Z_Free(gtv->demomaps);
+
+    gtv->demomaps = NULL;
+    gtv->numdemomaps = 0;
+    gtv->demomap = -1;
+    gtv->demoindexed = false;
+    gtv->demodirty = false;
+}
+
+// returns index of the map containing given file offset, or -1
+static int demo_find_map(gtv_t *gtv, int64_t pos)
+{
+    int l = 0;
+    int r = gtv->numdemomaps - 1;
+
+    while (l <= r) {
+        int m = (l + r) / 2;
+        int64_t filepos = gtv->demomaps[m].filepos;
+        if (filepos < pos)
+            l = m + 1;
+        else if (filepos > pos)
+            r = m - 1;
+        else
+            return m;
+    }
+
+    return r;
+}
+
+static int demo_add_map(gtv_t *gtv, int64_t pos)
+{
+    mvd_demomap_t *map;
+    int i;
+
+    i = demo_find_map(gtv, pos);
+    if (i >= 0 && gtv->demomaps[i].filepos == pos)
+        return i;
+
+    if (!gtv->demomaps)
+        gtv->demomaps = MVD_Malloc(sizeof(*map) * MIN_DEMOMAPS);
+    else
+        gtv->demomaps = Z_Realloc(gtv->demomaps, sizeof(*map) * ALIGN(gtv->numdemomaps + 1, MIN_DEMOMAPS));
+
+    i++;
+    memmove(gtv->demomaps + i + 1, gtv->demomaps + i, sizeof(*map) * (gtv->numdemomaps - i));
+    gtv->numdemomaps++;
+
+    map = &gtv->demomaps[i];
+    map->filepos = pos;
+    map->snapshots = NULL;
+    map->numsnapshots = 0;
+
+    if (gtv->demomap >= i)
+        gtv->demomap++;
+
+    gtv->demodirty = true;
+    return i;
+}
+
+// reads gamestate message of the given map
+static int demo_seek_map(gtv_t *gtv, int index, int64_t *pos)
+{
+    int ret;
+
+    if (index >= gtv->numdemomaps)
+        return 0;
+
+    *pos = gtv->demomaps[index].filepos;
+    ret = FS_Seek(gtv->demoplayback, *pos, SEEK_SET);
+    if (ret < 0)
+        return ret;
+
+    return demo_read_message(gtv->demoplayback);
+}
+
+// parses the message read from given file offset, moving snapshots of the
+// current map into the index on gamestate, and bringing them back when the
+// map is entered again
+static bool demo_parse_message(gtv_t *gtv, int64_t pos)
+{
+    mvd_t *mvd = gtv->mvd;
+    mvd_demomap_t *map;
+
+    if (msg_read.cursize && msg_read.data[0] == mvd_serverdata && gtv->demomap >= 0) {
+        map = &gtv->demomaps[gtv->demomap];
+        map->snapshots = mvd->snapshots;
+        map->numsnapshots = mvd->numsnapshots;
+        mvd->snapshots = NULL;
+        mvd->numsnapshots = 0;
+        gtv->demomap = -1;
+    }
+
+    if (!MVD_ParseMessage(mvd))
+        return false;
+
+    gtv->demomap = demo_add_map(gtv, pos);
+    map = &gtv->demomaps[gtv->demomap];
+    if (map->numsnapshots) {
+        mvd->snapshots = map->snapshots;
+        mvd->numsnapshots = map->numsnapshots;
+        mvd->last_snapshot = mvd->snapshots[mvd->numsnapshots - 1]->framenum;
+        map->snapshots = NULL;
+        map->numsnapshots = 0;
+    }
+
+    return true;
+}
+
+// checksum of the first and last blocks of demo file
+static uint32_t demo_checksum(qhandle_t f, int64_t filesize)
+{
+    int64_t pos = FS_Tell(f);
+    int64_t len = min(filesize, MVD_INDEX_SAMPLE);
+    byte *buf = MVD_Malloc(len * 2);
+    uint32_t sum = 0;
+
+    if (FS_Seek(f, 0, SEEK_SET) >= 0 &&
+        FS_Read(buf, len, f) == len &&
+        FS_Seek(f, filesize - len, SEEK_SET) >= 0 &&
+        FS_Read(buf + len, len, f) == len)
+        sum = Com_BlockChecksum(buf, len * 2);
+
+    FS_Seek(f, pos, SEEK_SET);
+    Z_Free(buf);
+    return sum;
+}
+
+static void write_index_header(byte *p, int64_t filesize, uint32_t checksum, int nummaps)
+{
+    WL32(p +  0, MVD_INDEX_MAGIC);
+    WL32(p +  4, MVD_INDEX_VERSION);
+    WL64(p +  8, filesize);
+    WL32(p + 16, checksum);
+    WL32(p + 20, nummaps);
+}
+
+static void demo_save_index(gtv_t *gtv)
+{
+    char buffer[MAX_OSPATH];
+    byte header[MVD_INDEX_HEADER];
+    mvd_demomap_t *map;
+    mvd_snap_t **snapshots, *snap;
+    int64_t filesize;
+    qhandle_t f;
+    int i, j, count, ret;
+
+    if (mvd_demoindex->integer <= 0 || !gtv->demodirty || !gtv->demosize)
+        return;
+
+    if (Q_concat(buffer, sizeof(buffer), gtv->demoentry->string, ".idx") >= sizeof(buffer))
+        return;
+
+    ret = FS_OpenFile(buffer, &f, FS_MODE_WRITE);
+    if (!f) {
+        Com_EPrintf("[%s] Couldn't write %s: %s\n", gtv->name, buffer, Q_ErrorString(ret));
+        return;
+    }
+
+    filesize = gtv->demoofs + gtv->demosize;
+    write_index_header(header, filesize, demo_checksum(gtv->demoplayback, filesize), gtv->numdemomaps);
+    FS_Write(header, MVD_INDEX_HEADER, f);
+
+    for (i = 0; i < gtv->numdemomaps; i++) {
+        map = &gtv->demomaps[i];
+
+        // snapshots of the current map are owned by channel
+        if (i == gtv->demomap && gtv->mvd) {
+            snapshots = gtv->mvd->snapshots;
+            count = gtv->mvd->numsnapshots;
+        } else {
+            snapshots = map->snapshots;
+            count = map->numsnapshots;
+        }
+
+        WL64(header + 0, map->filepos);
+        WL32(header + 8, count);
+        FS_Write(header, MVD_INDEX_MAP, f);
+
+        for (j = 0; j < count; j++) {
+            snap = snapshots[j];
+            WL64(header + 0, snap->filepos);
+            WL32(header + 8, snap->framenum);
+            WL32(header + 12, snap->msglen);
+            FS_Write(header, MVD_INDEX_SNAP, f);
+            FS_Write(snap->data, snap->msglen, f);
+        }
+    }
+
+    ret = FS_CloseFile(f);
+    if (ret < 0) {
+        Com_EPrintf("[%s] Couldn't write %s: %s\n", gtv->name, buffer, Q_ErrorString(ret));
+        return;
+    }
+
+    Com_DPrintf("[%s] Wrote %d maps to %s\n", gtv->name, gtv->numdemomaps, buffer);
+    gtv->demodirty = false;
+}
+
+static void demo_load_index(gtv_t *gtv, const char *path, int64_t filesize)
+{
+    char buffer[MAX_OSPATH];
+    byte header[MVD_INDEX_HEADER];
+    mvd_demomap_t *map;
+    mvd_snap_t *snap;
+    byte *data, *p, *end;
+    uint32_t i, j, nummaps, count;
+    int64_t filepos;
+    size_t msglen;
+    int len;
+
+    if (mvd_demoindex->integer <= 0 || filesize <= 0)
+        return;
+
+    if (Q_concat(buffer, sizeof(buffer), path, ".idx") >= sizeof(buffer))
+        return;
+
+    len = FS_LoadFile(buffer, (void **)&data);
+    if (!data)
+        return;
+
+    write_index_header(header, filesize, 0, 0);
+    if (len < MVD_INDEX_HEADER || memcmp(data, header, 16) ||
+        RL32(data + 16) != demo_checksum(gtv->demoplayback, filesize)) {
+        Com_DPrintf("[%s] Ignoring stale %s\n", gtv->name, buffer);
+        goto done;
+    }
+
+    nummaps = RL32(data + 20);
+    p = data + MVD_INDEX_HEADER;
+    end = data + len;
+
+    for (i = 0; i < nummaps; i++) {
+        if (end - p < MVD_INDEX_MAP)
+            break;
+        filepos = RL64(p);
+        count = RL32(p + 8);
+        p += MVD_INDEX_MAP;
+
+        // maps must be sorted
+        if (filepos >= filesize || (gtv->numdemomaps && filepos <= gtv->demomaps[gtv->numdemomaps - 1].filepos))
+            break;
+        if (count > MAX_SNAPSHOTS)
+            break;
+
+        j = demo_add_map(gtv, filepos);
+        map = &gtv->demomaps[j];
+
+        for (j = 0; j < count; j++) {
+            if (end - p < MVD_INDEX_SNAP)
+                break;
+            msglen = RL32(p + 12);
+            if (end - p - MVD_INDEX_SNAP < msglen || msglen > MAX_MSGLEN)
+                break;
+
+            snap = MVD_Malloc(sizeof(*snap) + msglen - 1);
+            snap->filepos = RL64(p);
+            snap->framenum = RL32(p + 8);
+            snap->msglen = msglen;
+            memcpy(snap->data, p + MVD_INDEX_SNAP, msglen);
+            p += MVD_INDEX_SNAP + msglen;
+
+            if (!map->snapshots)
+                map->snapshots = MVD_Malloc(sizeof(snap) * MIN_SNAPSHOTS);
+            else
+                map->snapshots = Z_Realloc(map->snapshots, sizeof(snap) * ALIGN(map->numsnapshots + 1, MIN_SNAPSHOTS));
+            map->snapshots[map->numsnapshots++] = snap;
+        }
+
+        if (j < count)
+            break;
+    }
+
+    if (i < nummaps || !nummaps) {
+        Com_WPrintf("[%s] %s is corrupt\n", gtv->name, buffer);
+        demo_free_index(gtv);
+        goto done;
+    }
+
+    Com_DPrintf("[%s] Loaded %d maps from %s\n", gtv->name, gtv->numdemomaps, buffer);
+    gtv->demoindexed = true;
+    gtv->demodirty = false;
+
+done:
+    FS_FreeFile(data);
+}
+
 static void demo_update(gtv_t *gtv)
 {
     if (gtv->demosize) {
@@ -692,12 +1037,17 @@ static void demo_finish(gtv_t *gtv, int ret)
         gtv_destroyf(gtv, "Couldn't read %s: %s", gtv->demoentry->string, Q_ErrorString(ret));
     }
 
+    // every map has been seen by now
+    gtv->demoindexed = true;
+    demo_save_index(gtv);
+
     demo_play_next(gtv, gtv->demoentry->next);
 }
 
 static bool demo_read_frame(mvd_t *mvd)
 {
     gtv_t *gtv = mvd->gtv;
+    int64_t pos;
     int count;
     int ret;
 
@@ -719,13 +1069,24 @@ static bool demo_read_frame(mvd_t *mvd)
 
     if (count) {
         Com_Printf("[%s] -=- Skipping map%s...\n", gtv->name, count == 1 ? "" : "s");
-        do {
-            ret = demo_skip_map(gtv->demoplayback);
+        if (gtv->demoindexed && gtv->demomap >= 0) {
+            ret = demo_seek_map(gtv, gtv->demomap + count, &pos);
             if (ret <= 0) {
                 goto next;
             }
-        } while (--count);
+        } else {
+            do {
+                ret = demo_skip_map(gtv->demoplayback, &pos);
+                if (ret <= 0) {
+                    goto next;
+                }
+                if (count > 1) {
+                    demo_add_map(gtv, pos);
+                }
+            } while (--count);
+        }
     } else {
+        pos = FS_Tell(gtv->demoplayback);
         ret = demo_read_message(gtv->demoplayback);
         if (ret <= 0) {
             goto next;
@@ -734,7 +1095,7 @@ static bool demo_read_frame(mvd_t *mvd)
 
     demo_update(gtv);
 
-    MVD_ParseMessage(mvd);
+    demo_parse_message(gtv, pos);
     demo_emit_snapshot(mvd);
     return true;
 
@@ -763,12 +1124,21 @@ static void demo_play_next(gtv_t *gtv, string_entry_t *entry)
         gtv->demoplayback = 0;
     }
 
+    // index is kept when looping over the same file
+    if (entry != gtv->demoentry) {
+        demo_free_index(gtv);
+    }
+
     // open new file
     len = FS_OpenFile(entry->string, &gtv->demoplayback, FS_MODE_READ | FS_FLAG_GZIP);
     if (!gtv->demoplayback) {
         gtv_destroyf(gtv, "Couldn't open %s: %s", entry->string, Q_ErrorString(len));
     }
 
+    if (!gtv->numdemomaps) {
+        demo_load_index(gtv, entry->string, len);
+    }
+
     // read the first message
     ret = demo_read_first(gtv->demoplayback);
     if (ret < 0) {
@@ -785,8 +1155,8 @@ static void demo_play_next(gtv_t *gtv, string_entry_t *entry)
 
     Com_Printf("[%s] -=- Reading from %s\n", gtv->name, entry->string);
 
-    // parse gamestate
-    MVD_ParseMessage(gtv->mvd);
+    // parse gamestate, which immediately follows magic
+    demo_parse_message(gtv, 4);
     if (!gtv->mvd->state) {
         gtv_destroyf(gtv, "First message of %s does not contain gamestate", entry->string);
     }
@@ -838,6 +1208,7 @@ static void demo_destroy(gtv_t *gtv)
     }
 
     demo_free_playlist(gtv);
+    demo_free_index(gtv);
 
     Z_Free(gtv);
 }
@@ -1921,7 +2292,7 @@ void MVD_StreamedRecord_f(void)
     mvd_t *mvd;
     uint32_t magic;
     uint16_t msglen;
-    unsigned mode = FS_MODE_WRITE;
+    unsigned mode = FS_MODE_WRITE | FS_FLAG_ASYNC;
     int ret;
     int c;
 
@@ -2223,7 +2594,7 @@ static void MVD_Seek_f(void)
     mvd_client_t *client;
     mvd_snap_t *snap;
     int i, j, ret, index, frames;
-    int64_t dest;
+    int64_t dest, filepos;
     char *from, *to;
     edict_t *ent;
     bool gamestate, back_seek, byte_seek;
@@ -2308,10 +2679,36 @@ static void MVD_Seek_f(void)
 
     Com_DPrintf("[%d] seeking to %"PRId64"\n", mvd->framenum, dest);
 
+    // jump to gamestate of another map directly
+    if (byte_seek && gtv->demoindexed) {
+        index = demo_find_map(gtv, dest);
+        if (index >= 0 && index != gtv->demomap) {
+            Com_DPrintf("found map at %"PRId64"\n", gtv->demomaps[index].filepos);
+            ret = demo_seek_map(gtv, index, &filepos);
+            if (ret <= 0) {
+                demo_finish(gtv, ret);
+                return;
+            }
+            gamestate = demo_parse_message(gtv, filepos);
+            demo_emit_snapshot(mvd);
+
+            if (gamestate) {
+                // map changed, same as gamestate while seeking
+                Com_DPrintf("jumped to gamestate while seeking\n");
+                goto done;
+            }
+            back_seek = false;
+        }
+    }
+
     // seek to the previous most recent snapshot
     if (back_seek || mvd->last_snapshot > mvd->framenum) {
         snap = demo_find_snapshot(mvd, dest, byte_seek);
 
+        // don't go backwards when seeking forward
+        if (snap && !back_seek && snap->framenum <= mvd->framenum)
+            snap = NULL;
+
         if (snap) {
             Com_DPrintf("found snap at %d\n", snap->framenum);
             ret = FS_Seek(gtv->demoplayback, snap->filepos, SEEK_SET);
@@ -2355,13 +2752,14 @@ static void MVD_Seek_f(void)
         if (pos >= dest)
             break;
 
+        filepos = FS_Tell(gtv->demoplayback);
         ret = demo_read_message(gtv->demoplayback);
         if (ret <= 0) {
             demo_finish(gtv, ret);
             return;
         }
 
-        gamestate = MVD_ParseMessage(mvd);
+        gamestate = demo_parse_message(gtv, filepos);
 
         demo_emit_snapshot(mvd);
 
@@ -2605,6 +3003,7 @@ static void MVD_Play_f(void)
         gtv->drop = demo_destroy;
         gtv->destroy = demo_destroy;
         gtv->demoloop = 1;
+        gtv->demomap = -1;
         Q_snprintf(gtv->name, sizeof(gtv->name), "dem%d", gtv->id);
     }
 
@@ -2634,6 +3033,9 @@ void MVD_Shutdown(void)
     gtv_t *gtv, *gtv_next;
     mvd_t *mvd, *mvd_next;
 
+    // stop background demo conversions
+    MVD_ConvertShutdown();
+
     // kill all GTV connections
     LIST_FOR_EACH_SAFE(gtv_t, gtv, gtv_next, &mvd_gtv_list, entry) {
         gtv->destroy(gtv);
@@ -2673,6 +3075,7 @@ static const cmdreg_t c_mvd[] = {
     { "mvdpause", MVD_Pause_f },
     { "mvdskip", MVD_Skip_f },
     { "mvdseek", MVD_Seek_f },
+    { "mvdconvert", MVD_Convert_f, MVD_Convert_c },
 
     { NULL }
 };
@@ -2706,6 +3109,7 @@ void MVD_Register(void)
     mvd_username = Cvar_Get("mvd_username", "unnamed", 0);
     mvd_password = Cvar_Get("mvd_password", "", CVAR_PRIVATE);
     mvd_snaps = Cvar_Get("mvd_snaps", "10", 0);
+    mvd_demoindex = Cvar_Get("mvd_demoindex", "1", 0);
 
     Cmd_Register(c_mvd);
 }
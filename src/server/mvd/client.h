@@ -244,3 +244,11 @@ void MVD_WriteStringList(mvd_client_t *client, mvd_cs_t *cs);
 void MVD_SetPlayerNames(mvd_t *mvd);
 void MVD_LinkEdict(mvd_t *mvd, edict_t *ent);
 
+//
+// mvd_convert.c
+//
+
+void MVD_Convert_f(void);
+void MVD_Convert_c(genctx_t *ctx, int argnum);
+void MVD_ConvertShutdown(void);
+
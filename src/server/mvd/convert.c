@@ -0,0 +1,2321 @@
+/*
+Copyright (C) 2003-2006 Andrey Nazarov
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with this program; if not, write to the Free Software Foundation, Inc.,
+51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+
+//
+// mvd_convert.c -- offline demo transcoding
+//
+
+#include "client.h"
+#include "server/mvd/protocol.h"
+
+/*
+====================================================================
+
+DEMO CONVERSION
+
+Both MVD and .dm2 demos are parsed into a common game state, which is then
+written out in either format. Every output frame is delta compressed against
+the last frame actually written, so frames can be freely dropped: duplicate,
+out of order and undecodable input frames are removed, as are frames that
+don't fit into the output message size.
+
+Input is read and output is written one message at a time, so demo size is not
+limited by available memory. Conversion runs in the background from the server
+frame loop, CONVERT_MSEC per frame. Several files are interleaved in round
+robin on the main thread (message buffers aren't thread safe), while gzip
+compression and disk writes are done by the async writer thread of each output
+file. Unfinished conversions are stopped when the MVD subsystem shuts down.
+
+====================================================================
+*/
+
+#define MAX_CONVERT_JOBS    32
+#define CONVERT_SLICE       64      // messages processed per job turn
+#define CONVERT_MSEC        10      // time spent converting per frame
+
+#define MAX_PACKETPLAYER_BYTES  256 // rough estimate
+
+#define DM2_ES_EXTENDED_MASK \
+    (MSG_ES_LONGSOLID | MSG_ES_UMASK | MSG_ES_BEAMORIGIN | MSG_ES_EXTENSIONS)
+
+typedef struct {
+    entity_state_t              s;
+    entity_state_extension_t    x;
+} convert_state_t;
+
+typedef struct {
+    convert_state_t s;
+    bool            inuse;
+} convert_entity_t;
+
+typedef struct {
+    player_state_t  ps;
+    bool            inuse;
+} convert_player_t;
+
+typedef struct {
+    int             number;
+    bool            valid;
+    player_state_t  ps;
+    int             areabytes;
+    byte            areabits[MAX_MAP_AREA_BYTES];
+    int             firstEntity;
+    int             numEntities;
+} convert_frame_t;
+
+typedef struct {
+    char        name[MAX_OSPATH];
+    char        outname[MAX_OSPATH];
+    qhandle_t   in, out;
+    bool        mvd_in, mvd_out;
+    int64_t     firstlen;           // already read length of first dm2 message
+    size_t      msglen;             // output message size limit
+    int         povnum;             // player to follow, -1 to pick any
+
+    // game state shared by both formats
+    int         protocol;           // dm2 input protocol
+    int         servercount;
+    int         clientNum;
+    int         flags;              // MVD stream flags
+    char        gamedir[MAX_QPATH];
+    const cs_remap_t    *csr;
+    msgEsFlags_t        esFlags, outEsFlags;
+    msgPsFlags_t        psFlags;
+    int         maxclients;
+    int         num_edicts;
+    configstring_t      configstrings[MAX_CONFIGSTRINGS];
+    convert_player_t    players[MAX_CLIENTS];
+    convert_entity_t    entities[MAX_EDICTS];
+    int         portalbytes;
+    byte        portalbits[MAX_MAP_PORTAL_BYTES];
+    cm_t        cm;
+
+    // dm2 input delta state
+    convert_state_t     baselines[MAX_EDICTS];
+    convert_frame_t     frames[UPDATE_BACKUP];
+    convert_frame_t     frame;      // last good frame
+    convert_state_t     entityStates[MAX_PARSE_ENTITIES];
+    int         numEntityStates;
+
+    // output delta state
+    bool        ingame;             // gamestate has been written
+    int         pov;                // followed player for MVD -> dm2
+    mleaf_t     *povleaf;
+    byte        povmask[VIS_MAX_BYTES];
+    byte        visible[MAX_EDICTS / CHAR_BIT];
+    bool        nodelta;
+    int         framenum;
+    player_packed_t     outps;
+    player_packed_t     outplayers[MAX_CLIENTS];
+    entity_packed_t     outentities[MAX_EDICTS];
+    entity_packed_t     outbaselines[MAX_EDICTS];
+
+    // statistics
+    int64_t     inbytes, outbytes;
+    int         frames_written;
+    int         frames_dropped;
+    int         others_dropped;
+    bool        truncated;
+    bool        finished;
+} convert_job_t;
+
+typedef struct {
+    list_t      entry;
+    int         format;
+    int         pov;
+    bool        gzip;
+    char        name[1];
+} convert_request_t;
+
+static LIST_DECL(convert_queue);
+static convert_job_t    *convert_jobs[MAX_CONVERT_JOBS];
+static int              convert_numjobs;
+static int              convert_maxjobs = 4;
+
+static jmp_buf      convert_jmpbuf;
+
+static byte         convert_buffer[MAX_MSGLEN];
+static sizebuf_t    convert_msg;    // output message being built
+
+static void convert_error(convert_job_t *job, const char *fmt, ...) q_noreturn q_printf(2, 3);
+
+static void convert_error(convert_job_t *job, const char *fmt, ...)
+{
+    va_list     argptr;
+    char        text[MAXERRORMSG];
+
+    va_start(argptr, fmt);
+    Q_vsnprintf(text, sizeof(text), fmt, argptr);
+    va_end(argptr);
+
+    Com_EPrintf("%s: %s\n", job->name, text);
+
+    longjmp(convert_jmpbuf, -1);
+}
+
+/*
+====================================================================
+
+OUTPUT
+
+====================================================================
+*/
+
+static void write_message(convert_job_t *job)
+{
+    uint32_t msglen;
+    uint16_t us;
+    int ret;
+
+    // empty MVD message would be taken as end of demo
+    if (!convert_msg.cursize) {
+        return;
+    }
+
+    if (job->mvd_out) {
+        us = LittleShort(convert_msg.cursize);
+        ret = FS_Write(&us, 2, job->out);
+        job->outbytes += 2;
+    } else {
+        msglen = LittleLong(convert_msg.cursize);
+        ret = FS_Write(&msglen, 4, job->out);
+        job->outbytes += 4;
+    }
+    if (ret >= 0) {
+        ret = FS_Write(convert_msg.data, convert_msg.cursize, job->out);
+        job->outbytes += convert_msg.cursize;
+    }
+
+    SZ_Clear(&convert_msg);
+
+    if (ret < 0) {
+        convert_error(job, "couldn't write %s: %s", job->outname, Q_ErrorString(ret));
+    }
+}
+
+// appends a complete command to the output message
+static bool write_data(convert_job_t *job, const void *data, size_t len)
+{
+    if (convert_msg.cursize + len > job->msglen) {
+        // MVD messages are played back one per frame, don't split them
+        if (job->mvd_out || len > job->msglen) {
+            return false;
+        }
+        write_message(job);
+    }
+
+    SZ_Write(&convert_msg, data, len);
+    return true;
+}
+
+static void flush_cmd(convert_job_t *job)
+{
+    if (!write_data(job, msg_write.data, msg_write.cursize)) {
+        job->others_dropped++;
+    }
+    SZ_Clear(&msg_write);
+}
+
+// copies input command starting at `start' verbatim
+static void copy_cmd(convert_job_t *job, size_t start)
+{
+    if (msg_read.readcount > msg_read.cursize) {
+        convert_error(job, "read past end of message");
+    }
+    if (!write_data(job, msg_read.data + start, msg_read.readcount - start)) {
+        job->others_dropped++;
+    }
+}
+
+// MVD and vanilla dm2 bboxes are 16 bit, extended dm2 ones are 32 bit
+static uint32_t convert_solid(uint32_t solid, bool to32)
+{
+    vec3_t mins, maxs;
+
+    if (!solid || solid == PACKED_BSP) {
+        return solid;
+    }
+
+    if (to32) {
+        MSG_UnpackSolid16(solid, mins, maxs);
+        return MSG_PackSolid32_Ver2(mins, maxs);
+    }
+
+    MSG_UnpackSolid32_Ver2(solid, mins, maxs);
+    return MSG_PackSolid16(mins, maxs);
+}
+
+static void pack_entity(convert_job_t *job, entity_packed_t *out, const convert_state_t *in)
+{
+    bool long_in = !job->mvd_in && job->csr->extended;
+    bool long_out = !job->mvd_out && job->csr->extended;
+
+    MSG_PackEntity(out, &in->s, &in->x);
+    if (long_in != long_out) {
+        out->solid = convert_solid(out->solid, long_out);
+    }
+}
+
+static void copy_entity_state(entity_packed_t *dst, const entity_packed_t *src, int flags)
+{
+    if (!(flags & MSG_ES_FIRSTPERSON)) {
+        VectorCopy(src->origin, dst->origin);
+        VectorCopy(src->angles, dst->angles);
+        VectorCopy(src->old_origin, dst->old_origin);
+    }
+    dst->modelindex = src->modelindex;
+    dst->modelindex2 = src->modelindex2;
+    dst->modelindex3 = src->modelindex3;
+    dst->modelindex4 = src->modelindex4;
+    dst->frame = src->frame;
+    dst->skinnum = src->skinnum;
+    dst->effects = src->effects;
+    dst->renderfx = src->renderfx;
+    dst->solid = src->solid;
+    dst->sound = src->sound;
+    dst->event = 0;
+    dst->morefx = src->morefx;
+    dst->alpha = src->alpha;
+    dst->scale = src->scale;
+    dst->loop_volume = src->loop_volume;
+    dst->loop_attenuation = src->loop_attenuation;
+}
+
+static int mvd_entity_flags(convert_job_t *job, int number)
+{
+    convert_player_t *player;
+
+    if (number > job->maxclients) {
+        return job->outEsFlags;
+    }
+
+    // client will recover origin/angles from player state
+    player = &job->players[number - 1];
+    if (player->inuse && player->ps.pmove.pm_type == PM_NORMAL) {
+        return job->outEsFlags | MSG_ES_FIRSTPERSON;
+    }
+
+    return job->outEsFlags;
+}
+
+// writes serverdata, configstrings and baseline frame as a single command
+static void mvd_write_gamestate(convert_job_t *job)
+{
+    entity_packed_t *es;
+    player_packed_t *ps;
+    size_t length;
+    int i, flags, extra;
+    char *s;
+
+    // serverdata must start a message for seeking to work
+    write_message(job);
+
+    if (job->mvd_in) {
+        extra = job->flags;
+    } else {
+        if (job->clientNum < 0 || job->clientNum >= job->maxclients) {
+            convert_error(job, "can't convert demo with client number %d", job->clientNum);
+        }
+        extra = MVF_SINGLEPOV;
+    }
+    if (job->csr->extended) {
+        extra |= MVF_EXTLIMITS;
+    } else {
+        extra &= ~MVF_EXTLIMITS;
+    }
+
+    MSG_WriteByte(mvd_serverdata | (extra << SVCMD_BITS));
+    MSG_WriteLong(PROTOCOL_VERSION_MVD);
+    if (job->csr->extended)
+        MSG_WriteShort(PROTOCOL_VERSION_MVD_CURRENT);
+    else
+        MSG_WriteShort(PROTOCOL_VERSION_MVD_DEFAULT);
+    MSG_WriteLong(job->servercount);
+    MSG_WriteString(job->gamedir);
+    MSG_WriteShort(job->mvd_in ? job->clientNum : -1);
+
+    for (i = 0; i < job->csr->end; i++) {
+        s = job->configstrings[i];
+        if (!*s) {
+            continue;
+        }
+        if (msg_write.cursize + MAX_QPATH + 3 > job->msglen) {
+            convert_error(job, "oversize gamestate");
+        }
+        length = Q_strnlen(s, MAX_QPATH);
+        MSG_WriteShort(i);
+        MSG_WriteData(s, length);
+        MSG_WriteByte(0);
+    }
+    if (msg_write.cursize + 3 + MAX_MAP_PORTAL_BYTES > job->msglen) {
+        convert_error(job, "oversize gamestate");
+    }
+    MSG_WriteShort(i);
+
+    MSG_WriteByte(job->portalbytes);
+    MSG_WriteData(job->portalbits, job->portalbytes);
+
+    memset(job->outplayers, 0, sizeof(job->outplayers));
+    for (i = 0, ps = job->outplayers; i < job->maxclients; i++, ps++) {
+        if (!job->players[i].inuse) {
+            continue;
+        }
+        if (msg_write.cursize + MAX_PACKETPLAYER_BYTES > job->msglen) {
+            convert_error(job, "oversize gamestate");
+        }
+        MSG_PackPlayer(ps, &job->players[i].ps);
+        MSG_WriteDeltaPlayerstate_Packet(NULL, ps, i, job->psFlags);
+        PPS_INUSE(ps) = true;
+    }
+    MSG_WriteByte(CLIENTNUM_NONE);
+
+    memset(job->outentities, 0, sizeof(job->outentities));
+    for (i = 1, es = job->outentities + 1; i < job->num_edicts; i++, es++) {
+        entity_packed_t newes;
+
+        if (!job->entities[i].inuse) {
+            continue;
+        }
+        if (msg_write.cursize + MAX_PACKETENTITY_BYTES > job->msglen) {
+            convert_error(job, "oversize gamestate");
+        }
+        flags = mvd_entity_flags(job, i);
+        pack_entity(job, &newes, &job->entities[i].s);
+        MSG_WriteDeltaEntity(NULL, &newes, flags);
+        copy_entity_state(es, &newes, flags);
+        es->number = i;
+    }
+
+    if (msg_write.cursize + 2 > job->msglen) {
+        convert_error(job, "oversize gamestate");
+    }
+    MSG_WriteShort(0);
+
+    MSG_FlushTo(&convert_msg);
+    write_message(job);
+
+    job->ingame = true;
+    job->frames_written++;
+}
+
+static bool mvd_write_frame(convert_job_t *job)
+{
+    player_packed_t *oldps, newps;
+    entity_packed_t *oldes, newes;
+    int i, flags;
+
+    MSG_WriteByte(mvd_frame);
+    MSG_WriteByte(job->portalbytes);
+    MSG_WriteData(job->portalbits, job->portalbytes);
+
+    for (i = 0; i < job->maxclients; i++) {
+        if (msg_write.cursize + MAX_PACKETPLAYER_BYTES > job->msglen) {
+            return false;
+        }
+
+        oldps = &job->outplayers[i];
+        if (!job->players[i].inuse) {
+            if (PPS_INUSE(oldps)) {
+                MSG_WriteDeltaPlayerstate_Packet(NULL, NULL, i, job->psFlags);
+            }
+            continue;
+        }
+
+        MSG_PackPlayer(&newps, &job->players[i].ps);
+        if (PPS_INUSE(oldps)) {
+            MSG_WriteDeltaPlayerstate_Packet(oldps, &newps, i, job->psFlags);
+        } else {
+            MSG_WriteDeltaPlayerstate_Packet(oldps, &newps, i, job->psFlags | MSG_PS_FORCE);
+        }
+    }
+    MSG_WriteByte(CLIENTNUM_NONE);
+
+    for (i = 1; i < job->num_edicts; i++) {
+        if (msg_write.cursize + MAX_PACKETENTITY_BYTES > job->msglen) {
+            return false;
+        }
+
+        oldes = &job->outentities[i];
+        if (!job->entities[i].inuse) {
+            if (oldes->number) {
+                MSG_WriteDeltaEntity(oldes, NULL, MSG_ES_FORCE);
+            }
+            continue;
+        }
+
+        flags = mvd_entity_flags(job, i);
+        if (!oldes->number) {
+            flags |= MSG_ES_FORCE | MSG_ES_NEWENTITY;
+        }
+
+        pack_entity(job, &newes, &job->entities[i].s);
+        MSG_WriteDeltaEntity(oldes, &newes, flags);
+    }
+
+    if (msg_write.cursize + 2 > job->msglen) {
+        return false;
+    }
+    MSG_WriteShort(0);
+
+    return true;
+}
+
+// frame has been written, shuffle current state to previous
+static void mvd_update_frame(convert_job_t *job)
+{
+    player_packed_t *ps;
+    entity_packed_t *es, newes;
+    int i;
+
+    for (i = 0, ps = job->outplayers; i < job->maxclients; i++, ps++) {
+        if (job->players[i].inuse) {
+            MSG_PackPlayer(ps, &job->players[i].ps);
+            PPS_INUSE(ps) = true;
+        } else {
+            PPS_INUSE(ps) = false;
+        }
+    }
+
+    for (i = 1, es = job->outentities + 1; i < job->num_edicts; i++, es++) {
+        if (job->entities[i].inuse) {
+            pack_entity(job, &newes, &job->entities[i].s);
+            copy_entity_state(es, &newes, mvd_entity_flags(job, i));
+            es->number = i;
+        } else {
+            es->number = 0;
+        }
+    }
+}
+
+static bool pov_valid(convert_job_t *job, int number)
+{
+    convert_player_t *player = &job->players[number];
+
+    return player->inuse && player->ps.fov;
+}
+
+// keeps following current player while possible, dummy MVD client is the
+// last resort
+static int mvd_find_pov(convert_job_t *job)
+{
+    int i;
+
+    if (job->povnum >= 0) {
+        if (job->povnum < job->maxclients && pov_valid(job, job->povnum)) {
+            return job->povnum;
+        }
+        return -1;
+    }
+
+    if (job->pov >= 0 && job->pov != job->clientNum && pov_valid(job, job->pov)) {
+        return job->pov;
+    }
+
+    for (i = 0; i < job->maxclients; i++) {
+        if (i != job->clientNum && pov_valid(job, i)) {
+            return i;
+        }
+    }
+
+    if (job->clientNum >= 0 && pov_valid(job, job->clientNum)) {
+        return job->clientNum;
+    }
+
+    return -1;
+}
+
+// MVD streams carry all entities, cull those the followed player can't see
+static void mvd_cull_entities(convert_job_t *job, const player_state_t *ps)
+{
+    convert_entity_t *ent;
+    mleaf_t *leaf;
+    vec3_t org;
+    int i, count;
+
+    VectorScale(ps->pmove.origin, 0.125f, org);
+    VectorAdd(org, ps->viewoffset, org);
+    job->povleaf = CM_PointLeaf(&job->cm, org);
+    BSP_ClusterVis(job->cm.cache, job->povmask, job->povleaf->cluster, DVIS_PVS);
+
+    memset(job->visible, 0, sizeof(job->visible));
+    for (i = 1, count = 0; i < job->num_edicts && count < MAX_PACKET_ENTITIES; i++) {
+        ent = &job->entities[i];
+        if (!ent->inuse) {
+            continue;
+        }
+
+        // bmodels, beams and sound sources span multiple clusters
+        if (job->cm.cache && i != job->pov + 1 && ent->s.s.solid != PACKED_BSP &&
+            !(ent->s.s.renderfx & RF_BEAM) && !ent->s.s.sound) {
+            leaf = CM_PointLeaf(&job->cm, ent->s.s.origin);
+            if (!CM_AreasConnected(&job->cm, leaf->area, job->povleaf->area))
+                continue;
+            if (leaf->cluster == -1)
+                continue;
+            if (!Q_IsBitSet(job->povmask, leaf->cluster))
+                continue;
+        }
+
+        Q_SetBit(job->visible, i);
+        count++;
+    }
+}
+
+static void dm2_write_gamestate(convert_job_t *job)
+{
+    entity_packed_t *base;
+    convert_state_t *ent;
+    size_t len;
+    int i;
+    char *s;
+
+    write_message(job);
+
+    MSG_WriteByte(svc_serverdata);
+    if (!job->mvd_in)
+        MSG_WriteLong(job->protocol);
+    else if (job->csr->extended)
+        MSG_WriteLong(PROTOCOL_VERSION_EXTENDED);
+    else
+        MSG_WriteLong(PROTOCOL_VERSION_DEFAULT);
+    MSG_WriteLong(job->servercount);
+    MSG_WriteByte(1);      // demos are always attract loops
+    MSG_WriteString(job->gamedir);
+    MSG_WriteShort(job->mvd_in ? job->pov : job->clientNum);
+    MSG_WriteString(job->configstrings[CS_NAME]);
+    flush_cmd(job);
+
+    for (i = 0; i < job->csr->end; i++) {
+        s = job->configstrings[i];
+        if (!*s) {
+            continue;
+        }
+        len = Q_strnlen(s, MAX_QPATH);
+        MSG_WriteByte(svc_configstring);
+        MSG_WriteShort(i);
+        MSG_WriteData(s, len);
+        MSG_WriteByte(0);
+        flush_cmd(job);
+    }
+
+    // MVD has no baselines, make current entities baselines
+    memset(job->outbaselines, 0, sizeof(job->outbaselines));
+    for (i = 1, base = job->outbaselines + 1; i < job->csr->max_edicts; i++, base++) {
+        if (job->mvd_in) {
+            if (i >= job->num_edicts || !job->entities[i].inuse) {
+                continue;
+            }
+            ent = &job->entities[i].s;
+        } else {
+            ent = &job->baselines[i];
+            if (!ent->s.number) {
+                continue;
+            }
+        }
+        pack_entity(job, base, ent);
+        base->number = i;
+        base->event = 0;
+        MSG_WriteByte(svc_spawnbaseline);
+        MSG_WriteDeltaEntity(NULL, base, job->outEsFlags | MSG_ES_FORCE);
+        flush_cmd(job);
+    }
+
+    MSG_WriteByte(svc_stufftext);
+    MSG_WriteString("precache\n");
+    flush_cmd(job);
+    write_message(job);
+
+    memset(job->outentities, 0, sizeof(job->outentities));
+    job->nodelta = true;
+    job->framenum = 0;
+    job->ingame = true;
+}
+
+static bool dm2_write_frame(convert_job_t *job, const player_state_t *ps,
+                            const byte *areabits, int areabytes)
+{
+    player_packed_t newps;
+    entity_packed_t *oldes, newes;
+    int i, flags;
+
+    MSG_WriteByte(svc_frame);
+    MSG_WriteLong(job->framenum + 1);
+    MSG_WriteLong(job->nodelta ? -1 : job->framenum);
+    if (job->mvd_in || job->protocol != PROTOCOL_VERSION_OLD)
+        MSG_WriteByte(0);   // rate dropped packets
+
+    MSG_WriteByte(areabytes);
+    MSG_WriteData(areabits, areabytes);
+
+    MSG_WriteByte(svc_playerinfo);
+    MSG_PackPlayer(&newps, ps);
+    MSG_WriteDeltaPlayerstate_Default(job->nodelta ? NULL : &job->outps, &newps, job->psFlags);
+
+    MSG_WriteByte(svc_packetentities);
+    for (i = 1; i < job->num_edicts; i++) {
+        if (msg_write.cursize + MAX_PACKETENTITY_BYTES > job->msglen) {
+            return false;
+        }
+
+        // uncompressed frame has no entities to remove or delta from
+        oldes = &job->outentities[i];
+        if (job->nodelta || !oldes->number) {
+            oldes = NULL;
+        }
+
+        if (!Q_IsBitSet(job->visible, i)) {
+            if (oldes) {
+                MSG_WriteDeltaEntity(oldes, NULL, MSG_ES_FORCE);
+            }
+            continue;
+        }
+
+        pack_entity(job, &newes, &job->entities[i].s);
+        if (oldes) {
+            // players are always new entities to update their old_origin
+            flags = job->outEsFlags;
+            if (i <= job->maxclients)
+                flags |= MSG_ES_NEWENTITY;
+            MSG_WriteDeltaEntity(oldes, &newes, flags);
+        } else {
+            // this is a new entity, send it from the baseline
+            MSG_WriteDeltaEntity(&job->outbaselines[i], &newes,
+                                 job->outEsFlags | MSG_ES_FORCE | MSG_ES_NEWENTITY);
+        }
+    }
+
+    if (msg_write.cursize + 2 > job->msglen) {
+        return false;
+    }
+    MSG_WriteShort(0);
+
+    return true;
+}
+
+static void dm2_update_frame(convert_job_t *job, const player_state_t *ps)
+{
+    entity_packed_t *es;
+    int i;
+
+    MSG_PackPlayer(&job->outps, ps);
+
+    for (i = 1, es = job->outentities + 1; i < job->num_edicts; i++, es++) {
+        if (Q_IsBitSet(job->visible, i)) {
+            pack_entity(job, es, &job->entities[i].s);
+            es->number = i;
+        } else {
+            es->number = 0;
+        }
+    }
+
+    job->nodelta = false;
+    job->framenum++;
+}
+
+static void dm2_emit_frame(convert_job_t *job)
+{
+    const player_state_t *ps;
+    byte areabits[MAX_MAP_AREA_BYTES];
+    int areabytes, pov, i;
+
+    if (job->mvd_in) {
+        // a different player means a different demo client
+        pov = mvd_find_pov(job);
+        if (pov != job->pov) {
+            job->ingame = false;
+            job->pov = pov;
+        }
+        if (pov == -1) {
+            job->frames_dropped++;
+            return;
+        }
+        ps = &job->players[pov].ps;
+        mvd_cull_entities(job, ps);
+        areabytes = CM_WriteAreaBits(&job->cm, areabits, job->povleaf->area);
+    } else {
+        ps = &job->frame.ps;
+        areabytes = job->frame.areabytes;
+        memcpy(areabits, job->frame.areabits, areabytes);
+        memset(job->visible, 0, sizeof(job->visible));
+        for (i = 1; i < job->num_edicts; i++) {
+            if (job->entities[i].inuse) {
+                Q_SetBit(job->visible, i);
+            }
+        }
+    }
+
+    if (!job->ingame) {
+        dm2_write_gamestate(job);
+    }
+
+    if (!dm2_write_frame(job, ps, areabits, areabytes) ||
+        !write_data(job, msg_write.data, msg_write.cursize)) {
+        SZ_Clear(&msg_write);
+        job->frames_dropped++;
+        return;
+    }
+
+    SZ_Clear(&msg_write);
+    dm2_update_frame(job, ps);
+    job->frames_written++;
+}
+
+static void emit_frame(convert_job_t *job)
+{
+    if (!job->mvd_out) {
+        dm2_emit_frame(job);
+        return;
+    }
+
+    if (!job->ingame) {
+        mvd_write_gamestate(job);
+        return;
+    }
+
+    if (!mvd_write_frame(job) || !write_data(job, msg_write.data, msg_write.cursize)) {
+        SZ_Clear(&msg_write);
+        job->frames_dropped++;
+        return;
+    }
+
+    SZ_Clear(&msg_write);
+    mvd_update_frame(job);
+    job->frames_written++;
+}
+
+/*
+====================================================================
+
+MVD INPUT
+
+====================================================================
+*/
+
+static void reset_state(convert_job_t *job)
+{
+    memset(job->configstrings, 0, sizeof(job->configstrings));
+    memset(job->players, 0, sizeof(job->players));
+    memset(job->entities, 0, sizeof(job->entities));
+    memset(job->baselines, 0, sizeof(job->baselines));
+    memset(job->frames, 0, sizeof(job->frames));
+    memset(&job->frame, 0, sizeof(job->frame));
+    job->numEntityStates = 0;
+    job->num_edicts = 1;
+    job->maxclients = 0;
+    job->portalbytes = 0;
+    job->ingame = false;
+    job->pov = -1;
+    CM_FreeMap(&job->cm);
+}
+
+static void set_flags(convert_job_t *job)
+{
+    if (job->mvd_in)
+        job->esFlags = MSG_ES_UMASK;
+    else
+        job->esFlags = 0;
+
+    if (job->mvd_out)
+        job->outEsFlags = MSG_ES_UMASK;
+    else
+        job->outEsFlags = 0;
+
+    job->psFlags = 0;
+
+    if (job->csr->extended) {
+        job->esFlags |= job->mvd_in ? MSG_ES_EXTENSIONS : DM2_ES_EXTENDED_MASK;
+        job->outEsFlags |= job->mvd_out ? MSG_ES_EXTENSIONS : DM2_ES_EXTENDED_MASK;
+        job->psFlags |= MSG_PS_EXTENSIONS;
+    }
+
+    if (!job->mvd_out && job->csr->extended) {
+        job->msglen = MAX_MSGLEN;
+    }
+}
+
+static void mvd_parse_players(convert_job_t *job)
+{
+    convert_player_t *player;
+    int number, bits;
+
+    while (1) {
+        if (msg_read.readcount > msg_read.cursize) {
+            convert_error(job, "read past end of message");
+        }
+
+        number = MSG_ReadByte();
+        if (number == CLIENTNUM_NONE) {
+            break;
+        }
+        if (number < 0 || number >= job->maxclients) {
+            convert_error(job, "bad player number: %d", number);
+        }
+
+        player = &job->players[number];
+        bits = MSG_ReadWord();
+        MSG_ParseDeltaPlayerstate_Packet(&player->ps, &player->ps, bits, job->psFlags);
+        player->inuse = !(bits & PPS_REMOVE);
+    }
+}
+
+static void mvd_parse_entities(convert_job_t *job)
+{
+    convert_entity_t *ent;
+    uint64_t bits;
+    int number;
+
+    while (1) {
+        if (msg_read.readcount > msg_read.cursize) {
+            convert_error(job, "read past end of message");
+        }
+
+        number = MSG_ParseEntityBits(&bits, job->esFlags);
+        if (number < 0 || number >= job->csr->max_edicts) {
+            convert_error(job, "bad entity number: %d", number);
+        }
+        if (!number) {
+            break;
+        }
+
+        ent = &job->entities[number];
+        MSG_ParseDeltaEntity(&ent->s.s, &ent->s.x, number, bits, job->esFlags);
+
+        if (bits & U_REMOVE) {
+            if (!(ent->s.s.renderfx & RF_BEAM)) {
+                VectorCopy(ent->s.s.origin, ent->s.s.old_origin);
+            }
+            ent->inuse = false;
+            continue;
+        }
+
+        ent->inuse = true;
+        if (number >= job->num_edicts) {
+            job->num_edicts = number + 1;
+        }
+    }
+}
+
+static void mvd_parse_frame(convert_job_t *job)
+{
+    convert_player_t *player;
+    convert_entity_t *ent;
+    byte *data;
+    int i, length;
+
+    length = MSG_ReadByte();
+    data = MSG_ReadData(length);
+    if (!data || length > MAX_MAP_PORTAL_BYTES) {
+        convert_error(job, "bad portalbits");
+    }
+    memcpy(job->portalbits, data, length);
+    job->portalbytes = length;
+    CM_SetPortalStates(&job->cm, data, length);
+
+    mvd_parse_players(job);
+    mvd_parse_entities(job);
+
+    // fix origin and angles on each player entity
+    for (i = 1, player = job->players; i <= job->maxclients; i++, player++) {
+        if (!player->inuse || i - 1 == job->clientNum) {
+            continue;
+        }
+        if (player->ps.pmove.pm_type != PM_NORMAL) {
+            continue;
+        }
+        ent = &job->entities[i];
+        if (ent->inuse) {
+            Com_PlayerToEntityState(&player->ps, &ent->s.s);
+        }
+    }
+}
+
+// events and old origins only last one frame
+static void mvd_prep_frame(convert_job_t *job)
+{
+    convert_entity_t *ent;
+    int i;
+
+    for (i = 1, ent = job->entities + 1; i < job->num_edicts; i++, ent++) {
+        if (!ent->inuse) {
+            continue;
+        }
+        if (!(ent->s.s.renderfx & RF_BEAM)) {
+            VectorCopy(ent->s.s.origin, ent->s.s.old_origin);
+        }
+        ent->s.s.event = 0;
+    }
+}
+
+static void mvd_parse_serverdata(convert_job_t *job, int extrabits)
+{
+    int protocol, version, index, ret;
+    size_t maxlen;
+    char *string;
+
+    reset_state(job);
+
+    protocol = MSG_ReadLong();
+    if (protocol != PROTOCOL_VERSION_MVD) {
+        convert_error(job, "unsupported protocol: %d", protocol);
+    }
+
+    version = MSG_ReadWord();
+    if (!MVD_SUPPORTED(version)) {
+        convert_error(job, "unsupported MVD protocol version: %d", version);
+    }
+
+    job->servercount = MSG_ReadLong();
+    if (MSG_ReadString(job->gamedir, sizeof(job->gamedir)) >= sizeof(job->gamedir)) {
+        convert_error(job, "oversize gamedir string");
+    }
+    job->clientNum = MSG_ReadShort();
+    job->flags = extrabits;
+    job->csr = &cs_remap_old;
+    if (version >= PROTOCOL_VERSION_MVD_EXTENDED_LIMITS && job->flags & MVF_EXTLIMITS) {
+        job->csr = &cs_remap_new;
+    }
+    set_flags(job);
+
+    while (1) {
+        index = MSG_ReadWord();
+        if (index == job->csr->end) {
+            break;
+        }
+        if (index < 0 || index >= job->csr->end) {
+            convert_error(job, "bad configstring index: %d", index);
+        }
+
+        string = job->configstrings[index];
+        maxlen = CS_SIZE(job->csr, index);
+        if (MSG_ReadString(string, maxlen) >= maxlen) {
+            convert_error(job, "configstring %d overflowed", index);
+        }
+
+        if (msg_read.readcount > msg_read.cursize) {
+            convert_error(job, "read past end of message");
+        }
+    }
+
+    job->maxclients = Q_atoi(job->configstrings[job->csr->maxclients]);
+    if (job->maxclients < 1 || job->maxclients > MAX_CLIENTS) {
+        convert_error(job, "invalid maxclients");
+    }
+
+    if (job->clientNum != -1 && (job->clientNum < 0 || job->clientNum >= job->maxclients)) {
+        convert_error(job, "invalid client num: %d", job->clientNum);
+    }
+
+    // visibility info is only needed to cull MVD stream for a single player
+    if (!job->mvd_out) {
+        string = job->configstrings[job->csr->models + 1];
+        ret = CM_LoadMap(&job->cm, string);
+        if (ret) {
+            Com_WPrintf("%s: couldn't load %s: %s\n", job->name, string, BSP_ErrorString(ret));
+        } else if (job->cm.cache->checksum != Q_atoi(job->configstrings[job->csr->mapchecksum])) {
+            Com_WPrintf("%s: local map version differs from server\n", job->name);
+            CM_FreeMap(&job->cm);
+        }
+    }
+
+    mvd_parse_frame(job);
+    emit_frame(job);
+}
+
+static void mvd_parse_multicast(convert_job_t *job, mvd_ops_t op, int extrabits, size_t start)
+{
+    byte mask[VIS_MAX_BYTES];
+    mleaf_t *leaf1 = NULL, *leaf2;
+    int length, leafnum;
+    vec3_t org;
+    byte *data;
+
+    length = MSG_ReadByte();
+    length |= extrabits << 8;
+
+    switch (op) {
+    case mvd_multicast_all:
+    case mvd_multicast_all_r:
+        break;
+    case mvd_multicast_phs:
+    case mvd_multicast_phs_r:
+        leafnum = MSG_ReadWord();
+        if (job->ingame && !job->mvd_out) {
+            leaf1 = CM_LeafNum(&job->cm, leafnum);
+            BSP_ClusterVis(job->cm.cache, mask, leaf1->cluster, DVIS_PHS);
+        }
+        break;
+    case mvd_multicast_pvs:
+    case mvd_multicast_pvs_r:
+        leafnum = MSG_ReadWord();
+        if (job->ingame && !job->mvd_out) {
+            leaf1 = CM_LeafNum(&job->cm, leafnum);
+            BSP_ClusterVis(job->cm.cache, mask, leaf1->cluster, DVIS_PVS);
+        }
+        break;
+    default:
+        convert_error(job, "bad op");
+    }
+
+    data = MSG_ReadData(length);
+    if (!data) {
+        convert_error(job, "read past end of message");
+    }
+
+    if (!job->ingame) {
+        return;
+    }
+
+    if (job->mvd_out) {
+        copy_cmd(job, start);
+        return;
+    }
+
+    if (leaf1 && job->cm.cache) {
+        VectorScale(job->players[job->pov].ps.pmove.origin, 0.125f, org);
+        leaf2 = CM_PointLeaf(&job->cm, org);
+        if (!CM_AreasConnected(&job->cm, leaf1->area, leaf2->area))
+            return;
+        if (leaf2->cluster == -1)
+            return;
+        if (!Q_IsBitSet(mask, leaf2->cluster))
+            return;
+    }
+
+    if (!write_data(job, data, length)) {
+        job->others_dropped++;
+    }
+}
+
+// only keeps data followed player would receive
+static void mvd_parse_unicast(convert_job_t *job, int extrabits, size_t start)
+{
+    char string[8];
+    size_t length, last, cmdstart;
+    int clientNum, cmd;
+
+    length = MSG_ReadByte();
+    length |= extrabits << 8;
+    clientNum = MSG_ReadByte();
+
+    if (clientNum < 0 || clientNum >= job->maxclients) {
+        convert_error(job, "bad unicast number: %d", clientNum);
+    }
+
+    last = msg_read.readcount + length;
+    if (last > msg_read.cursize) {
+        convert_error(job, "read past end of message");
+    }
+
+    if (!job->ingame) {
+        msg_read.readcount = last;
+        return;
+    }
+
+    if (job->mvd_out) {
+        msg_read.readcount = last;
+        copy_cmd(job, start);
+        return;
+    }
+
+    if (clientNum != job->pov) {
+        msg_read.readcount = last;
+        return;
+    }
+
+    while (msg_read.readcount < last) {
+        cmdstart = msg_read.readcount;
+        cmd = MSG_ReadByte();
+
+        switch (cmd) {
+        case svc_layout:
+            MSG_ReadString(NULL, 0);
+            break;
+        case svc_configstring:
+            MSG_ReadWord();
+            MSG_ReadString(NULL, 0);
+            break;
+        case svc_print:
+            MSG_ReadByte();
+            MSG_ReadString(NULL, 0);
+            break;
+        case svc_stufftext:
+            MSG_ReadString(string, sizeof(string));
+            if (strncmp(string, "play ", 5)) {
+                continue;
+            }
+            break;
+        default:
+            // copy remaining data and return
+            msg_read.readcount = last;
+            break;
+        }
+
+        if (msg_read.readcount > last) {
+            convert_error(job, "read past end of unicast");
+        }
+
+        if (!write_data(job, msg_read.data + cmdstart, msg_read.readcount - cmdstart)) {
+            job->others_dropped++;
+        }
+    }
+}
+
+// entity sounds are explicitly positioned and PHS culled for followed player
+static void mvd_parse_sound(convert_job_t *job, int extrabits, size_t start)
+{
+    int flags, index, volume, attenuation, offset, sendchan, entnum, modelindex;
+    convert_entity_t *ent;
+    byte mask[VIS_MAX_BYTES];
+    mleaf_t *leaf1, *leaf2;
+    vec3_t origin, org;
+    mmodel_t *model;
+
+    flags = MSG_ReadByte();
+    if (job->csr->extended && flags & SND_INDEX16)
+        index = MSG_ReadWord();
+    else
+        index = MSG_ReadByte();
+
+    volume = attenuation = offset = 0;
+    if (flags & SND_VOLUME)
+        volume = MSG_ReadByte();
+    if (flags & SND_ATTENUATION)
+        attenuation = MSG_ReadByte();
+    if (flags & SND_OFFSET)
+        offset = MSG_ReadByte();
+
+    sendchan = MSG_ReadWord();
+    entnum = sendchan >> 3;
+    if (entnum < 0 || entnum >= job->csr->max_edicts) {
+        convert_error(job, "bad sound entnum: %d", entnum);
+    }
+
+    if (!job->ingame) {
+        return;
+    }
+
+    if (job->mvd_out) {
+        copy_cmd(job, start);
+        return;
+    }
+
+    ent = &job->entities[entnum];
+    if (!ent->inuse) {
+        return;
+    }
+
+    // use the entity origin unless it is a bmodel
+    VectorCopy(ent->s.s.origin, origin);
+    if (ent->s.s.solid == PACKED_BSP && job->cm.cache) {
+        modelindex = ent->s.s.modelindex;
+        if (modelindex > 1 && modelindex <= job->cm.cache->nummodels) {
+            model = &job->cm.cache->models[modelindex - 1];
+            VectorAvg(model->mins, model->maxs, org);
+            VectorAdd(origin, org, origin);
+        }
+    }
+
+    if (!(extrabits & 1) && job->cm.cache) {
+        leaf1 = CM_PointLeaf(&job->cm, origin);
+        BSP_ClusterVis(job->cm.cache, mask, leaf1->cluster, DVIS_PHS);
+        VectorScale(job->players[job->pov].ps.pmove.origin, 0.125f, org);
+        leaf2 = CM_PointLeaf(&job->cm, org);
+        if (!CM_AreasConnected(&job->cm, leaf1->area, leaf2->area))
+            return;
+        if (leaf2->cluster == -1)
+            return;
+        if (!Q_IsBitSet(mask, leaf2->cluster))
+            return;
+    }
+
+    MSG_WriteByte(svc_sound);
+    MSG_WriteByte(flags | SND_ENT | SND_POS);
+    if (job->csr->extended && flags & SND_INDEX16)
+        MSG_WriteShort(index);
+    else
+        MSG_WriteByte(index);
+
+    if (flags & SND_VOLUME)
+        MSG_WriteByte(volume);
+    if (flags & SND_ATTENUATION)
+        MSG_WriteByte(attenuation);
+    if (flags & SND_OFFSET)
+        MSG_WriteByte(offset);
+
+    MSG_WriteShort(sendchan);
+    MSG_WritePos(origin);
+    flush_cmd(job);
+}
+
+static void mvd_parse_configstring(convert_job_t *job, size_t start)
+{
+    size_t maxlen;
+    int index;
+
+    index = MSG_ReadWord();
+    if (index < 0 || index >= job->csr->end) {
+        convert_error(job, "bad configstring index: %d", index);
+    }
+
+    maxlen = CS_SIZE(job->csr, index);
+    if (MSG_ReadString(job->configstrings[index], maxlen) >= maxlen) {
+        convert_error(job, "configstring %d overflowed", index);
+    }
+
+    if (!job->ingame) {
+        return;
+    }
+
+    if (job->mvd_out) {
+        copy_cmd(job, start);
+        return;
+    }
+
+    // same layout as svc_configstring
+    MSG_WriteByte(svc_configstring);
+    MSG_WriteData(msg_read.data + start + 1, msg_read.readcount - start - 1);
+    flush_cmd(job);
+}
+
+static void mvd_parse_print(convert_job_t *job, size_t start)
+{
+    MSG_ReadByte();
+    MSG_ReadString(NULL, 0);
+
+    if (!job->ingame) {
+        return;
+    }
+
+    if (job->mvd_out) {
+        copy_cmd(job, start);
+        return;
+    }
+
+    MSG_WriteByte(svc_print);
+    MSG_WriteData(msg_read.data + start + 1, msg_read.readcount - start - 1);
+    flush_cmd(job);
+}
+
+static void mvd_parse_message(convert_job_t *job)
+{
+    int cmd, extrabits;
+    size_t start;
+
+    while (1) {
+        if (msg_read.readcount > msg_read.cursize) {
+            convert_error(job, "read past end of message");
+        }
+        if (msg_read.readcount == msg_read.cursize) {
+            break;
+        }
+
+        start = msg_read.readcount;
+        cmd = MSG_ReadByte();
+        extrabits = cmd >> SVCMD_BITS;
+        cmd &= SVCMD_MASK;
+
+        if (!job->csr && cmd != mvd_serverdata && cmd != mvd_nop) {
+            convert_error(job, "expected serverdata, got %d", cmd);
+        }
+
+        switch (cmd) {
+        case mvd_serverdata:
+            mvd_parse_serverdata(job, extrabits);
+            break;
+        case mvd_multicast_all:
+        case mvd_multicast_pvs:
+        case mvd_multicast_phs:
+        case mvd_multicast_all_r:
+        case mvd_multicast_pvs_r:
+        case mvd_multicast_phs_r:
+            mvd_parse_multicast(job, cmd, extrabits, start);
+            break;
+        case mvd_unicast:
+        case mvd_unicast_r:
+            mvd_parse_unicast(job, extrabits, start);
+            break;
+        case mvd_configstring:
+            mvd_parse_configstring(job, start);
+            break;
+        case mvd_frame:
+            mvd_prep_frame(job);
+            mvd_parse_frame(job);
+            emit_frame(job);
+            break;
+        case mvd_sound:
+            mvd_parse_sound(job, extrabits, start);
+            break;
+        case mvd_print:
+            mvd_parse_print(job, start);
+            break;
+        case mvd_nop:
+            break;
+        default:
+            convert_error(job, "illegible command at %zu: %d", start, cmd);
+        }
+    }
+}
+
+/*
+====================================================================
+
+DM2 INPUT
+
+====================================================================
+*/
+
+static void dm2_parse_serverdata(convert_job_t *job)
+{
+    reset_state(job);
+
+    job->protocol = MSG_ReadLong();
+    job->servercount = MSG_ReadLong();
+    MSG_ReadByte();     // attractloop
+
+    job->csr = &cs_remap_old;
+    if (job->protocol == PROTOCOL_VERSION_EXTENDED) {
+        job->csr = &cs_remap_new;
+    } else if (job->protocol < PROTOCOL_VERSION_OLD || job->protocol > PROTOCOL_VERSION_DEFAULT) {
+        convert_error(job, "unsupported protocol version %d", job->protocol);
+    }
+    set_flags(job);
+
+    if (MSG_ReadString(job->gamedir, sizeof(job->gamedir)) >= sizeof(job->gamedir)) {
+        convert_error(job, "oversize gamedir string");
+    }
+    job->clientNum = MSG_ReadShort();
+    MSG_ReadString(NULL, 0);    // levelname
+
+    if (!VALIDATE_CLIENTNUM(job->csr, job->clientNum)) {
+        job->clientNum = -1;
+    }
+}
+
+static void dm2_parse_configstring(convert_job_t *job, size_t start)
+{
+    int index;
+
+    index = MSG_ReadWord();
+    if (index < 0 || index >= job->csr->end) {
+        convert_error(job, "bad configstring index: %d", index);
+    }
+
+    // overflow is not fatal for dm2 demos
+    MSG_ReadString(job->configstrings[index], CS_SIZE(job->csr, index));
+
+    if (index == job->csr->maxclients) {
+        job->maxclients = Q_clip(Q_atoi(job->configstrings[index]), 0, MAX_CLIENTS);
+    }
+
+    if (!job->ingame) {
+        return;
+    }
+
+    if (!job->mvd_out) {
+        copy_cmd(job, start);
+        return;
+    }
+
+    MSG_WriteByte(mvd_configstring);
+    MSG_WriteShort(index);
+    MSG_WriteString(job->configstrings[index]);
+    flush_cmd(job);
+}
+
+static void dm2_parse_baseline(convert_job_t *job)
+{
+    convert_state_t *base;
+    entity_packed_t *pack;
+    uint64_t bits;
+    int index;
+
+    index = MSG_ParseEntityBits(&bits, job->esFlags);
+    if (index < 1 || index >= job->csr->max_edicts) {
+        convert_error(job, "bad baseline index: %d", index);
+    }
+
+    base = &job->baselines[index];
+    MSG_ParseDeltaEntity(&base->s, &base->x, index, bits, job->esFlags);
+
+    // MVD has no baselines
+    if (!job->ingame || job->mvd_out) {
+        return;
+    }
+
+    pack = &job->outbaselines[index];
+    pack_entity(job, pack, base);
+    pack->event = 0;
+    MSG_WriteByte(svc_spawnbaseline);
+    MSG_WriteDeltaEntity(NULL, pack, job->outEsFlags | MSG_ES_FORCE);
+    flush_cmd(job);
+}
+
+static void dm2_parse_delta(convert_job_t *job, convert_frame_t *frame,
+                            int newnum, const convert_state_t *old, uint64_t bits)
+{
+    convert_state_t *state;
+
+    if (frame->numEntities >= job->csr->max_edicts) {
+        convert_error(job, "too many entities");
+    }
+
+    state = &job->entityStates[job->numEntityStates & PARSE_ENTITIES_MASK];
+    job->numEntityStates++;
+    frame->numEntities++;
+
+    *state = *old;
+    MSG_ParseDeltaEntity(&state->s, &state->x, newnum, bits, job->esFlags);
+
+    // shuffle previous origin to old
+    if (!(bits & U_OLDORIGIN) && !(state->s.renderfx & RF_BEAM))
+        VectorCopy(old->s.origin, state->s.old_origin);
+}
+
+static void dm2_parse_entities(convert_job_t *job, const convert_frame_t *oldframe,
+                               convert_frame_t *frame)
+{
+    const convert_state_t *oldstate = NULL;
+    int oldindex, oldnum, newnum;
+    uint64_t bits;
+
+    frame->firstEntity = job->numEntityStates;
+    frame->numEntities = 0;
+
+#define NEXT_OLD \
+    if (!oldframe || oldindex >= oldframe->numEntities) { \
+        oldnum = 99999; \
+    } else { \
+        oldstate = &job->entityStates[(oldframe->firstEntity + oldindex) & PARSE_ENTITIES_MASK]; \
+        oldnum = oldstate->s.number; \
+    }
+
+    oldindex = 0;
+    NEXT_OLD
+
+    while (1) {
+        if (msg_read.readcount > msg_read.cursize) {
+            convert_error(job, "read past end of message");
+        }
+
+        newnum = MSG_ParseEntityBits(&bits, job->esFlags);
+        if (newnum < 0 || newnum >= job->csr->max_edicts) {
+            convert_error(job, "bad entity number: %d", newnum);
+        }
+        if (!newnum) {
+            break;
+        }
+
+        while (oldnum < newnum) {
+            // one or more entities from the old packet are unchanged
+            dm2_parse_delta(job, frame, oldnum, oldstate, 0);
+            oldindex++;
+            NEXT_OLD
+        }
+
+        if (bits & U_REMOVE) {
+            if (!oldframe) {
+                convert_error(job, "U_REMOVE with NULL oldframe");
+            }
+            oldindex++;
+            NEXT_OLD
+            continue;
+        }
+
+        if (oldnum == newnum) {
+            dm2_parse_delta(job, frame, newnum, oldstate, bits);
+            oldindex++;
+            NEXT_OLD
+            continue;
+        }
+
+        // delta from baseline
+        dm2_parse_delta(job, frame, newnum, &job->baselines[newnum], bits);
+    }
+
+    // any remaining entities in the old frame are copied over
+    while (oldnum != 99999) {
+        dm2_parse_delta(job, frame, oldnum, oldstate, 0);
+        oldindex++;
+        NEXT_OLD
+    }
+
+#undef NEXT_OLD
+}
+
+static void dm2_parse_frame(convert_job_t *job)
+{
+    convert_frame_t frame, *oldframe;
+    const convert_state_t *state;
+    convert_entity_t *ent;
+    player_state_t *from;
+    int i, deltaframe, length, bits;
+    byte *data;
+
+    memset(&frame, 0, sizeof(frame));
+
+    frame.number = MSG_ReadLong();
+    deltaframe = MSG_ReadLong();
+    if (job->protocol != PROTOCOL_VERSION_OLD) {
+        MSG_ReadByte();     // rate dropped packets
+    }
+
+    if (deltaframe > 0) {
+        oldframe = &job->frames[deltaframe & UPDATE_MASK];
+        if (deltaframe != frame.number && oldframe->number == deltaframe && oldframe->valid &&
+            job->numEntityStates - oldframe->firstEntity <= MAX_PARSE_ENTITIES - MAX_PACKET_ENTITIES) {
+            frame.valid = true;
+        } else if (job->frame.valid) {
+            // recover broken demo like the client does
+            oldframe = &job->frame;
+            frame.valid = true;
+        }
+        from = &oldframe->ps;
+    } else {
+        oldframe = NULL;
+        from = NULL;
+        frame.valid = true;
+    }
+
+    length = MSG_ReadByte();
+    if (length < 0 || length > sizeof(frame.areabits)) {
+        convert_error(job, "invalid areabits length");
+    }
+    data = MSG_ReadData(length);
+    if (!data) {
+        convert_error(job, "read past end of message");
+    }
+    memcpy(frame.areabits, data, length);
+    frame.areabytes = length;
+
+    if (MSG_ReadByte() != svc_playerinfo) {
+        convert_error(job, "not playerinfo");
+    }
+    bits = MSG_ReadWord();
+    MSG_ParseDeltaPlayerstate_Default(from, &frame.ps, bits, job->psFlags);
+
+    if (MSG_ReadByte() != svc_packetentities) {
+        convert_error(job, "not packetentities");
+    }
+    dm2_parse_entities(job, oldframe, &frame);
+
+    job->frames[frame.number & UPDATE_MASK] = frame;
+
+    // drop undecodable, repeated and out of order frames
+    if (!frame.valid || !frame.ps.fov ||
+        (job->frame.valid && frame.number <= job->frame.number)) {
+        if (!frame.valid) {
+            job->frame.valid = false;
+        }
+        job->frames_dropped++;
+        return;
+    }
+
+    job->frame = frame;
+
+    // rebuild current state from frame
+    for (i = 1; i < job->num_edicts; i++) {
+        job->entities[i].inuse = false;
+    }
+    for (i = 0; i < frame.numEntities; i++) {
+        state = &job->entityStates[(frame.firstEntity + i) & PARSE_ENTITIES_MASK];
+        ent = &job->entities[state->s.number];
+        ent->s = *state;
+        ent->inuse = true;
+        if (state->s.number >= job->num_edicts) {
+            job->num_edicts = state->s.number + 1;
+        }
+    }
+
+    memset(job->players, 0, sizeof(job->players));
+    if (job->clientNum >= 0 && job->clientNum < MAX_CLIENTS) {
+        job->players[job->clientNum].ps = frame.ps;
+        job->players[job->clientNum].inuse = true;
+    }
+
+    emit_frame(job);
+}
+
+static void dm2_skip_temp_entity(convert_job_t *job)
+{
+    int type = MSG_ReadByte();
+
+    switch (type) {
+    case TE_BLOOD:
+    case TE_GUNSHOT:
+    case TE_SPARKS:
+    case TE_BULLET_SPARKS:
+    case TE_SCREEN_SPARKS:
+    case TE_SHIELD_SPARKS:
+    case TE_SHOTGUN:
+    case TE_BLASTER:
+    case TE_GREENBLOOD:
+    case TE_BLASTER2:
+    case TE_FLECHETTE:
+    case TE_HEATBEAM_SPARKS:
+    case TE_HEATBEAM_STEAM:
+    case TE_MOREBLOOD:
+    case TE_ELECTRIC_SPARKS:
+    case TE_BLUEHYPERBLASTER_2:
+    case TE_BERSERK_SLAM:
+        MSG_ReadData(6 + 1);
+        break;
+    case TE_SPLASH:
+    case TE_LASER_SPARKS:
+    case TE_WELDING_SPARKS:
+    case TE_TUNNEL_SPARKS:
+        MSG_ReadData(1 + 6 + 1 + 1);
+        break;
+    case TE_BLUEHYPERBLASTER:
+    case TE_RAILTRAIL:
+    case TE_RAILTRAIL2:
+    case TE_BUBBLETRAIL:
+    case TE_DEBUGTRAIL:
+    case TE_BUBBLETRAIL2:
+    case TE_BFG_LASER:
+    case TE_BFG_ZAP:
+        MSG_ReadData(6 + 6);
+        break;
+    case TE_GRENADE_EXPLOSION:
+    case TE_GRENADE_EXPLOSION_WATER:
+    case TE_EXPLOSION2:
+    case TE_PLASMA_EXPLOSION:
+    case TE_ROCKET_EXPLOSION:
+    case TE_ROCKET_EXPLOSION_WATER:
+    case TE_EXPLOSION1:
+    case TE_EXPLOSION1_NP:
+    case TE_EXPLOSION1_BIG:
+    case TE_BFG_EXPLOSION:
+    case TE_BFG_BIGEXPLOSION:
+    case TE_BOSSTPORT:
+    case TE_PLAIN_EXPLOSION:
+    case TE_CHAINFIST_SMOKE:
+    case TE_TRACKER_EXPLOSION:
+    case TE_TELEPORT_EFFECT:
+    case TE_DBALL_GOAL:
+    case TE_WIDOWSPLASH:
+    case TE_NUKEBLAST:
+    case TE_EXPLOSION1_NL:
+    case TE_EXPLOSION2_NL:
+        MSG_ReadData(6);
+        break;
+    case TE_PARASITE_ATTACK:
+    case TE_MEDIC_CABLE_ATTACK:
+    case TE_HEATBEAM:
+    case TE_MONSTER_HEATBEAM:
+    case TE_GRAPPLE_CABLE_2:
+    case TE_LIGHTNING_BEAM:
+        MSG_ReadData(2 + 6 + 6);
+        break;
+    case TE_GRAPPLE_CABLE:
+        MSG_ReadData(2 + 6 + 6 + 6);
+        break;
+    case TE_LIGHTNING:
+        MSG_ReadData(2 + 2 + 6 + 6);
+        break;
+    case TE_FLASHLIGHT:
+        MSG_ReadData(6 + 2);
+        break;
+    case TE_FORCEWALL:
+        MSG_ReadData(6 + 6 + 1);
+        break;
+    case TE_STEAM:
+        if (MSG_ReadShort() != -1) {
+            MSG_ReadData(1 + 6 + 1 + 1 + 2 + 4);
+        } else {
+            MSG_ReadData(1 + 6 + 1 + 1 + 2);
+        }
+        break;
+    case TE_WIDOWBEAMOUT:
+        MSG_ReadData(2 + 6);
+        break;
+    case TE_POWER_SPLASH:
+        MSG_ReadData(2 + 1);
+        break;
+    case TE_FLARE:
+        MSG_ReadData(2 + 1 + 6 + 1);
+        break;
+    default:
+        convert_error(job, "bad temp entity type: %d", type);
+    }
+}
+
+static void dm2_skip_sound(convert_job_t *job)
+{
+    int flags = MSG_ReadByte();
+
+    if (job->csr->extended && flags & SND_INDEX16)
+        MSG_ReadWord();
+    else
+        MSG_ReadByte();
+
+    if (flags & SND_VOLUME)
+        MSG_ReadByte();
+    if (flags & SND_ATTENUATION)
+        MSG_ReadByte();
+    if (flags & SND_OFFSET)
+        MSG_ReadByte();
+    if (flags & SND_ENT)
+        MSG_ReadWord();
+    if (flags & SND_POS)
+        MSG_ReadData(6);
+}
+
+// forwards command that doesn't affect game state
+static void dm2_forward(convert_job_t *job, int cmd, size_t start)
+{
+    byte *data = msg_read.data + start;
+    size_t len = msg_read.readcount - start;
+
+    if (msg_read.readcount > msg_read.cursize) {
+        convert_error(job, "read past end of message");
+    }
+
+    if (!job->ingame) {
+        return;
+    }
+
+    if (!job->mvd_out) {
+        copy_cmd(job, start);
+        return;
+    }
+
+    // wrap it into MVD command like GTV does
+    switch (cmd) {
+    case svc_print:
+        MSG_WriteByte(mvd_print);
+        MSG_WriteData(data + 1, len - 1);
+        break;
+    case svc_layout:
+    case svc_stufftext:
+        if (len > 0x7ff) {
+            job->others_dropped++;
+            return;
+        }
+        MSG_WriteByte(mvd_unicast | ((len >> 8) << SVCMD_BITS));
+        MSG_WriteByte(len & 255);
+        MSG_WriteByte(job->clientNum);
+        MSG_WriteData(data, len);
+        break;
+    default:
+        if (len > 0x7ff) {
+            job->others_dropped++;
+            return;
+        }
+        MSG_WriteByte(mvd_multicast_all | ((len >> 8) << SVCMD_BITS));
+        MSG_WriteByte(len & 255);
+        MSG_WriteData(data, len);
+        break;
+    }
+
+    flush_cmd(job);
+}
+
+static void dm2_parse_message(convert_job_t *job)
+{
+    size_t start;
+    int cmd, size;
+
+    while (1) {
+        if (msg_read.readcount > msg_read.cursize) {
+            convert_error(job, "read past end of message");
+        }
+        if (msg_read.readcount == msg_read.cursize) {
+            break;
+        }
+
+        start = msg_read.readcount;
+        cmd = MSG_ReadByte();
+
+        if (!job->csr && cmd != svc_serverdata && cmd != svc_nop) {
+            convert_error(job, "expected serverdata, got %d", cmd);
+        }
+
+        switch (cmd) {
+        case svc_nop:
+        case svc_reconnect:
+            break;
+        case svc_disconnect:
+            job->finished = true;
+            return;
+        case svc_serverdata:
+            dm2_parse_serverdata(job);
+            break;
+        case svc_configstring:
+            dm2_parse_configstring(job, start);
+            break;
+        case svc_spawnbaseline:
+            dm2_parse_baseline(job);
+            break;
+        case svc_frame:
+            dm2_parse_frame(job);
+            break;
+        case svc_print:
+            MSG_ReadByte();
+            // fall through
+        case svc_centerprint:
+        case svc_stufftext:
+        case svc_layout:
+            MSG_ReadString(NULL, 0);
+            dm2_forward(job, cmd, start);
+            break;
+        case svc_sound:
+            dm2_skip_sound(job);
+            dm2_forward(job, cmd, start);
+            break;
+        case svc_temp_entity:
+            dm2_skip_temp_entity(job);
+            dm2_forward(job, cmd, start);
+            break;
+        case svc_muzzleflash:
+        case svc_muzzleflash2:
+            MSG_ReadWord();
+            MSG_ReadByte();
+            dm2_forward(job, cmd, start);
+            break;
+        case svc_inventory:
+            MSG_ReadData(MAX_ITEMS * 2);
+            dm2_forward(job, cmd, start);
+            break;
+        case svc_download:
+            size = MSG_ReadShort();
+            MSG_ReadByte();
+            if (size > 0) {
+                MSG_ReadData(size);
+            }
+            break;
+        default:
+            convert_error(job, "illegible server message at %zu: %d", start, cmd);
+        }
+    }
+}
+
+/*
+====================================================================
+
+COMMAND
+
+====================================================================
+*/
+
+// returns 1 if message was read, 0 on end of demo
+static int read_message(convert_job_t *job)
+{
+    uint32_t msglen;
+    uint16_t us;
+    int read;
+
+    if (job->mvd_in) {
+        read = FS_Read(&us, 2, job->in);
+        if (read != 2) {
+            return read < 0 ? read : Q_ERR_UNEXPECTED_EOF;
+        }
+        if (!us) {
+            return 0;
+        }
+        msglen = LittleShort(us);
+        job->inbytes += 2;
+    } else {
+        if (job->firstlen >= 0) {
+            msglen = job->firstlen;
+            job->firstlen = -1;
+        } else {
+            read = FS_Read(&msglen, 4, job->in);
+            if (read != 4) {
+                return read < 0 ? read : Q_ERR_UNEXPECTED_EOF;
+            }
+            if (msglen == (uint32_t)-1) {
+                return 0;
+            }
+            msglen = LittleLong(msglen);
+        }
+        job->inbytes += 4;
+    }
+
+    if (msglen > MAX_MSGLEN) {
+        return Q_ERR_INVALID_FORMAT;
+    }
+
+    SZ_Init(&msg_read, msg_read_buffer, sizeof(msg_read_buffer));
+    msg_read.cursize = msglen;
+
+    read = FS_Read(msg_read.data, msglen, job->in);
+    if (read != msglen) {
+        return read < 0 ? read : Q_ERR_UNEXPECTED_EOF;
+    }
+    job->inbytes += msglen;
+
+    // don't drop frames that fit in the original demo
+    if (!job->mvd_in && !job->mvd_out && msglen > job->msglen) {
+        job->msglen = msglen;
+    }
+
+    return 1;
+}
+
+// processes a slice of messages, returns false when done
+static bool convert_step(convert_job_t *job)
+{
+    int i, ret;
+
+    if (setjmp(convert_jmpbuf)) {
+        SZ_Clear(&msg_write);
+        return false;
+    }
+
+    for (i = 0; i < CONVERT_SLICE; i++) {
+        ret = read_message(job);
+        if (ret == Q_ERR_UNEXPECTED_EOF) {
+            job->truncated = true;
+            return false;
+        }
+        if (ret < 0) {
+            convert_error(job, "couldn't read message: %s", Q_ErrorString(ret));
+        }
+        if (!ret) {
+            return false;
+        }
+
+        if (job->mvd_in) {
+            mvd_parse_message(job);
+        } else {
+            dm2_parse_message(job);
+        }
+        write_message(job);
+
+        if (job->finished) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+// never writes over an existing file, including the input demo
+static bool convert_open_output(convert_job_t *job, bool gzip)
+{
+    char base[MAX_OSPATH];
+    const char *ext = job->mvd_out ? ".mvd2" : ".dm2";
+    const char *gz = gzip ? ".gz" : "";
+    unsigned mode = FS_MODE_WRITE | FS_FLAG_ASYNC | FS_FLAG_EXCL;
+    int64_t ret = Q_ERR(EEXIST);
+    size_t len;
+    char *p;
+    int i;
+
+    if (gzip) {
+        mode |= FS_FLAG_GZIP;
+    }
+
+    Q_strlcpy(base, job->name, sizeof(base));
+    p = COM_FileExtension(base);
+    if (!Q_stricmp(p, ".gz")) {
+        *p = 0;
+        p = COM_FileExtension(base);
+    }
+    if (!Q_stricmp(p, ".mvd2") || !Q_stricmp(p, ".dm2")) {
+        *p = 0;
+    }
+
+    for (i = 0; i < 100; i++) {
+        if (i) {
+            len = Q_snprintf(job->outname, sizeof(job->outname), "%s_%d%s%s", base, i, ext, gz);
+        } else {
+            len = Q_snprintf(job->outname, sizeof(job->outname), "%s%s%s", base, ext, gz);
+        }
+        if (len >= sizeof(job->outname)) {
+            ret = Q_ERR(ENAMETOOLONG);
+            break;
+        }
+        if (FS_FileExists(job->outname)) {
+            continue;
+        }
+        ret = FS_OpenFile(job->outname, &job->out, mode);
+        if (job->out) {
+            return true;
+        }
+        if (ret != Q_ERR(EEXIST)) {
+            break;
+        }
+    }
+
+    Com_EPrintf("Couldn't open %s: %s\n", job->outname, Q_ErrorString(ret));
+    return false;
+}
+
+static convert_job_t *convert_open(const char *arg, int format, int pov, bool gzip)
+{
+    char buffer[MAX_OSPATH];
+    convert_job_t *job;
+    uint32_t magic;
+    qhandle_t f;
+    int read;
+
+    f = FS_EasyOpenFile(buffer, sizeof(buffer), FS_MODE_READ | FS_FLAG_GZIP,
+                        "demos/", arg, ".mvd2");
+    if (!f) {
+        return NULL;
+    }
+
+    read = FS_Read(&magic, 4, f);
+    if (read != 4) {
+        Com_EPrintf("Couldn't read %s: %s\n", buffer,
+                    Q_ErrorString(read < 0 ? read : Q_ERR_UNEXPECTED_EOF));
+        FS_CloseFile(f);
+        return NULL;
+    }
+
+    // dm2 demos have no magic, first message length must be sane
+    if (magic != MVD_MAGIC && LittleLong(magic) > MAX_MSGLEN && magic != (uint32_t)-1) {
+        Com_EPrintf("%s is not a demo\n", buffer);
+        FS_CloseFile(f);
+        return NULL;
+    }
+
+    job = MVD_Mallocz(sizeof(*job));
+    Q_strlcpy(job->name, buffer, sizeof(job->name));
+    job->in = f;
+    job->mvd_in = magic == MVD_MAGIC;
+    job->mvd_out = format ? format == 'm' : job->mvd_in;
+    job->povnum = pov;
+    job->pov = -1;
+    job->firstlen = -1;
+
+    if (!job->mvd_in) {
+        if (magic == (uint32_t)-1) {
+            job->finished = true;
+        } else {
+            job->firstlen = LittleLong(magic);
+        }
+    }
+
+    if (job->mvd_out) {
+        job->msglen = MAX_MSGLEN - 1;
+    } else {
+        job->msglen = MAX_PACKETLEN_WRITABLE;
+    }
+
+    if (!convert_open_output(job, gzip)) {
+        FS_CloseFile(f);
+        Z_Free(job);
+        return NULL;
+    }
+
+    if (job->mvd_out) {
+        magic = MVD_MAGIC;
+        FS_Write(&magic, 4, job->out);
+        job->outbytes += 4;
+    }
+
+    return job;
+}
+
+static void convert_close(convert_job_t *job)
+{
+    char before[16], after[16];
+    uint32_t eof = (uint32_t)-1;
+    uint16_t eom = 0;
+    int ret;
+
+    // terminate the demo, what was written so far is still usable
+    if (job->mvd_out) {
+        FS_Write(&eom, 2, job->out);
+        job->outbytes += 2;
+    } else {
+        FS_Write(&eof, 4, job->out);
+        job->outbytes += 4;
+    }
+
+    ret = FS_CloseFile(job->out);
+    FS_CloseFile(job->in);
+    CM_FreeMap(&job->cm);
+
+    if (ret) {
+        Com_EPrintf("Couldn't write %s: %s\n", job->outname, Q_ErrorString(ret));
+    } else {
+        Com_FormatSizeLong(before, sizeof(before), job->inbytes);
+        Com_FormatSizeLong(after, sizeof(after), job->outbytes);
+        Com_Printf("%s -> %s: %d frames, %d dropped, %s -> %s%s\n",
+                   job->name, job->outname, job->frames_written,
+                   job->frames_dropped, before, after,
+                   job->truncated ? " (truncated)" : "");
+    }
+
+    Z_Free(job);
+}
+
+static const cmd_option_t o_mvdconvert[] = {
+    { "d", "dm2", "write .dm2 demos" },
+    { "h", "help", "display this message" },
+    { "j:number", "jobs", "convert up to <number> files at once" },
+    { "m", "mvd", "write MVD demos" },
+    { "p:slot", "pov", "follow player in <slot> when writing .dm2" },
+#if USE_ZLIB
+    { "z", "compress", "compress files with gzip" },
+#endif
+    { NULL }
+};
+
+static void convert_file_g(genctx_t *ctx)
+{
+    FS_File_g("demos", "*.mvd2;*.mvd2.gz;*.dm2;*.dm2.gz",
+              FS_SEARCH_SAVEPATH | FS_SEARCH_BYFILTER, ctx);
+}
+
+void MVD_Convert_c(genctx_t *ctx, int argnum)
+{
+    Cmd_Option_c(o_mvdconvert, convert_file_g, ctx, argnum);
+}
+
+void MVD_Convert_f(void)
+{
+    convert_request_t *req;
+    int c, maxjobs = 0, format = 0, pov = -1;
+    size_t len;
+    bool gzip = false;
+
+    while ((c = Cmd_ParseOptions(o_mvdconvert)) != -1) {
+        switch (c) {
+        case 'd':
+        case 'm':
+            format = c;
+            break;
+        case 'h':
+            Cmd_PrintUsage(o_mvdconvert, "[/]<filename> [...]");
+            Com_Printf("Convert MVD and .dm2 demos into new files.\n");
+            Cmd_PrintHelp(o_mvdconvert);
+            return;
+        case 'j':
+            maxjobs = Q_atoi(cmd_optarg);
+            if (maxjobs < 1 || maxjobs > MAX_CONVERT_JOBS) {
+                Com_Printf("Invalid value for %s option.\n", cmd_optopt);
+                Cmd_PrintHint();
+                return;
+            }
+            break;
+        case 'p':
+            pov = Q_atoi(cmd_optarg);
+            if (pov < 0 || pov >= MAX_CLIENTS) {
+                Com_Printf("Invalid value for %s option.\n", cmd_optopt);
+                Cmd_PrintHint();
+                return;
+            }
+            break;
+        case 'z':
+            gzip = true;
+            break;
+        default:
+            return;
+        }
+    }
+
+    if (cmd_optind == Cmd_Argc()) {
+        Com_Printf("Missing filename argument.\n");
+        Cmd_PrintHint();
+        return;
+    }
+
+    if (maxjobs) {
+        convert_maxjobs = maxjobs;
+    }
+
+    for (c = cmd_optind; c < Cmd_Argc(); c++) {
+        len = strlen(Cmd_Argv(c));
+        req = MVD_Malloc(sizeof(*req) + len);
+        memcpy(req->name, Cmd_Argv(c), len + 1);
+        req->format = format;
+        req->pov = pov;
+        req->gzip = gzip;
+        List_Append(&convert_queue, &req->entry);
+    }
+
+    Com_Printf("Queued %d file%s for conversion.\n",
+               Cmd_Argc() - cmd_optind, Cmd_Argc() - cmd_optind == 1 ? "" : "s");
+}
+
+/*
+==============
+MVD_ConvertFrame
+
+Runs queued conversions for a few milliseconds, interleaving up to -j
+files. Returns true while there is work left, so that the server doesn't
+sleep between frames.
+==============
+*/
+bool MVD_ConvertFrame(void)
+{
+    convert_request_t *req;
+    convert_job_t *job;
+    unsigned start;
+    bool active;
+    int i;
+
+    if (LIST_EMPTY(&convert_queue) && !convert_numjobs) {
+        return false;
+    }
+
+    SZ_Init(&convert_msg, convert_buffer, sizeof(convert_buffer));
+    start = Sys_Milliseconds();
+
+    do {
+        active = false;
+        for (i = 0; i < MAX_CONVERT_JOBS; i++) {
+            while (!convert_jobs[i] && i < convert_maxjobs && !LIST_EMPTY(&convert_queue)) {
+                req = LIST_FIRST(convert_request_t, &convert_queue, entry);
+                List_Remove(&req->entry);
+                convert_jobs[i] = convert_open(req->name, req->format, req->pov, req->gzip);
+                if (convert_jobs[i]) {
+                    convert_numjobs++;
+                }
+                Z_Free(req);
+            }
+            if (!(job = convert_jobs[i])) {
+                continue;
+            }
+            if (job->finished || !convert_step(job)) {
+                SZ_Clear(&convert_msg);
+                convert_close(job);
+                convert_jobs[i] = NULL;
+                convert_numjobs--;
+            }
+            active = true;
+        }
+    } while (active && Sys_Milliseconds() - start < CONVERT_MSEC);
+
+    return convert_numjobs || !LIST_EMPTY(&convert_queue);
+}
+
+// closes unfinished jobs, what has been converted so far is kept
+void MVD_ConvertShutdown(void)
+{
+    convert_request_t *req, *next;
+    int i;
+
+    for (i = 0; i < MAX_CONVERT_JOBS; i++) {
+        if (convert_jobs[i]) {
+            convert_jobs[i]->truncated = true;
+            convert_close(convert_jobs[i]);
+            convert_jobs[i] = NULL;
+        }
+    }
+    convert_numjobs = 0;
+
+    LIST_FOR_EACH_SAFE(convert_request_t, req, next, &convert_queue, entry) {
+        Z_Free(req);
+    }
+    List_Init(&convert_queue);
+}
@@ -17,6 +17,7 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 */
 
 #include "server.h"
+#include "system/pthread.h"
 
 #define SAVE_MAGIC1     MakeLittleLong('S','S','V','2')
 #define SAVE_MAGIC2     MakeLittleLong('S','A','V','2')
@@ -24,6 +25,8 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 
 #define SAVE_CURRENT    ".current"
 #define SAVE_AUTO       "save0"
+#define SAVE_AUTO_NEW   "save0.new"
+#define SAVE_AUTO_OLD   "save0.old"
 
 cvar_t *sv_savedir = NULL;
 /* Don't require GMF_ENHANCED_SAVEGAMES feature for savegame support.
@@ -31,6 +34,7 @@ cvar_t *sv_savedir = NULL;
  * Still, allow it as an option for cautious people. */
 cvar_t *sv_force_enhanced_savegames = NULL;
 static cvar_t   *sv_noreload;
+static cvar_t   *sv_async_autosave;
 
 static int write_binary_file(char const* name, void const* data, size_t size)
 {
@@ -151,7 +155,8 @@ static int write_level_file(void)
     return 0;
 }
 
-static int copy_file(const char *src, const char *dst, const char *name)
+// doesn't touch any engine state, may be called from autosave thread
+static int copy_path(const char *src, const char *dst)
 {
     char    path[MAX_OSPATH];
     byte    buf[0x10000];
@@ -159,14 +164,11 @@ static int copy_file(const char *src, const char *dst, const char *name)
     size_t  len, res;
     int     ret = -1;
 
-    if (Q_snprintf(path, MAX_OSPATH, "%s/%s/%s/%s", fs_gamedir, sv_savedir->string, src, name) >= MAX_OSPATH)
-        goto fail0;
-
-    ifp = fopen(path, "rb");
+    ifp = fopen(src, "rb");
     if (!ifp)
         goto fail0;
 
-    if (Q_snprintf(path, MAX_OSPATH, "%s/%s/%s/%s", fs_gamedir, sv_savedir->string, dst, name) >= MAX_OSPATH)
+    if (Q_strlcpy(path, dst, MAX_OSPATH) >= MAX_OSPATH)
         goto fail1;
 
     if (FS_CreatePath(path))
@@ -196,6 +198,20 @@ fail0:
     return ret;
 }
 
+static int copy_file(const char *src, const char *dst, const char *name)
+{
+    char    srcpath[MAX_OSPATH];
+    char    dstpath[MAX_OSPATH];
+
+    if (Q_snprintf(srcpath, MAX_OSPATH, "%s/%s/%s/%s", fs_gamedir, sv_savedir->string, src, name) >= MAX_OSPATH)
+        return -1;
+
+    if (Q_snprintf(dstpath, MAX_OSPATH, "%s/%s/%s/%s", fs_gamedir, sv_savedir->string, dst, name) >= MAX_OSPATH)
+        return -1;
+
+    return copy_path(srcpath, dstpath);
+}
+
 static int remove_file(const char *dir, const char *name)
 {
     char path[MAX_OSPATH];
@@ -216,9 +232,11 @@ static void **list_save_dir(const char *dir, int *count)
     if (Q_snprintf(path, MAX_OSPATH, "%s/%s/%s", fs_gamedir, sv_savedir->string, dir) >= MAX_OSPATH)
         return NULL;
 
+    // keep paths relative to dir, maps may be in subdirectories
     memset(&list, 0, sizeof(list));
     list.filter = ".ssv;.sav;.sv2";
-    list.flags = FS_SEARCH_RECURSIVE;
+    list.flags = FS_SEARCH_RECURSIVE | FS_SEARCH_SAVEPATH;
+    list.baselen = strlen(path) + 1;
     Sys_ListFiles_r(&list, path, 0);
 
     list.files = FS_ReallocList(list.files, list.count + 1);
@@ -268,6 +286,200 @@ static bool file_exists(const char* name)
     return true;
 }
 
+/*
+==============================================================================
+
+AUTOSAVE SNAPSHOTS
+
+The level and server files are written into the current save directory
+synchronously, since the next map reads them back right away. Publishing
+them to the autosave slot is done in the background: the files are copied
+into a new directory, which is then renamed over the old slot. The old slot
+is moved aside first, so a crash between the two renames leaves only
+save0.old behind. It is moved back before the next autosave or load.
+
+All file lists and paths are prepared on the main thread, the worker only
+makes C library calls.
+
+==============================================================================
+*/
+
+typedef struct {
+    char    src[MAX_OSPATH];    // .current
+    char    dst[MAX_OSPATH];    // save0
+    char    tmp[MAX_OSPATH];    // save0.new
+    char    old[MAX_OSPATH];    // save0.old
+    void    **files;            // to copy from src
+    int     numfiles;
+    void    **stale;            // left in dst by the previous autosave
+    int     numstale;
+    void    **leftover_tmp;     // from an interrupted autosave
+    int     numleftover_tmp;
+    void    **leftover_old;
+    int     numleftover_old;
+    int     ret;
+} autosave_job_t;
+
+static autosave_job_t   *autosave_job;
+static pthread_t        autosave_thread;
+static bool             autosave_threaded;
+
+static void remove_tree(const char *dir, void **files, int count)
+{
+    char    path[MAX_OSPATH];
+    char    *p;
+    int     i;
+
+    for (i = 0; i < count; i++) {
+        if (Q_concat(path, sizeof(path), dir, "/", files[i]) >= sizeof(path))
+            continue;
+        os_unlink(path);
+
+        // remove now empty subdirectories, failures are harmless
+        while ((p = strrchr(path, '/')) && p > path + strlen(dir)) {
+            *p = 0;
+            if (os_rmdir(path))
+                break;
+        }
+    }
+
+    os_rmdir(dir);
+}
+
+static int autosave_run(autosave_job_t *job)
+{
+    char    src[MAX_OSPATH];
+    char    dst[MAX_OSPATH];
+    int     i;
+
+    remove_tree(job->tmp, job->leftover_tmp, job->numleftover_tmp);
+    remove_tree(job->old, job->leftover_old, job->numleftover_old);
+
+    for (i = 0; i < job->numfiles; i++) {
+        if (Q_concat(src, sizeof(src), job->src, "/", job->files[i]) >= sizeof(src))
+            return -1;
+        if (Q_concat(dst, sizeof(dst), job->tmp, "/", job->files[i]) >= sizeof(dst))
+            return -1;
+        if (copy_path(src, dst))
+            return -1;
+    }
+
+    // there may be no previous autosave
+    if (rename(job->dst, job->old) && job->numstale)
+        return -1;
+
+    if (rename(job->tmp, job->dst)) {
+        rename(job->old, job->dst);
+        return -1;
+    }
+
+    remove_tree(job->old, job->stale, job->numstale);
+    return 0;
+}
+
+static void *autosave_func(void *arg)
+{
+    autosave_job_t *job = arg;
+
+    job->ret = autosave_run(job);
+    return NULL;
+}
+
+static void free_autosave_job(autosave_job_t *job)
+{
+    FS_FreeList(job->files);
+    FS_FreeList(job->stale);
+    FS_FreeList(job->leftover_tmp);
+    FS_FreeList(job->leftover_old);
+    Z_Free(job);
+}
+
+/*
+==================
+SV_FinishAutoSave
+
+Waits for the background autosave to complete. Must be called before
+anything else touches the save directories.
+==================
+*/
+void SV_FinishAutoSave(void)
+{
+    autosave_job_t *job = autosave_job;
+
+    if (!job)
+        return;
+
+    if (autosave_threaded)
+        pthread_join(autosave_thread, NULL);
+
+    if (job->ret)
+        Com_EPrintf("Couldn't write '%s' directory.\n", SAVE_AUTO);
+
+    free_autosave_job(job);
+    autosave_job = NULL;
+    autosave_threaded = false;
+}
+
+static int make_save_path(char *buf, const char *dir)
+{
+    if (Q_snprintf(buf, MAX_OSPATH, "%s/%s/%s", fs_gamedir, sv_savedir->string, dir) >= MAX_OSPATH)
+        return -1;
+    return 0;
+}
+
+// undo an autosave that was interrupted between the renames
+static void recover_autosave(void)
+{
+    char dst[MAX_OSPATH], old[MAX_OSPATH];
+
+    if (make_save_path(dst, SAVE_AUTO) || make_save_path(old, SAVE_AUTO_OLD))
+        return;
+    if (file_exists(va("%s/server.ssv", dst)) || !file_exists(va("%s/server.ssv", old)))
+        return;
+
+    Com_WPrintf("Restoring '%s' from interrupted autosave.\n", SAVE_AUTO);
+    if (rename(old, dst))
+        Com_EPrintf("Couldn't rename '%s' to '%s'.\n", SAVE_AUTO_OLD, SAVE_AUTO);
+}
+
+static int start_autosave(void)
+{
+    autosave_job_t *job;
+
+    SV_FinishAutoSave();
+    recover_autosave();
+
+    job = Z_TagMallocz(sizeof(*job), TAG_SERVER);
+    if (make_save_path(job->src, SAVE_CURRENT) ||
+        make_save_path(job->dst, SAVE_AUTO) ||
+        make_save_path(job->tmp, SAVE_AUTO_NEW) ||
+        make_save_path(job->old, SAVE_AUTO_OLD)) {
+        Z_Free(job);
+        return -1;
+    }
+
+    job->files = list_save_dir(SAVE_CURRENT, &job->numfiles);
+    if (!job->files) {
+        Z_Free(job);
+        return -1;
+    }
+    job->stale = list_save_dir(SAVE_AUTO, &job->numstale);
+    job->leftover_tmp = list_save_dir(SAVE_AUTO_NEW, &job->numleftover_tmp);
+    job->leftover_old = list_save_dir(SAVE_AUTO_OLD, &job->numleftover_old);
+
+    autosave_job = job;
+
+    if (sv_async_autosave->integer) {
+        autosave_threaded = !pthread_create(&autosave_thread, NULL, autosave_func, job);
+        if (autosave_threaded)
+            return 0;
+    }
+
+    autosave_func(job);
+    SV_FinishAutoSave();
+    return 0;
+}
+
 static int read_binary_file(const char *name)
 {
     FILE* fp = fopen(name, "rb");
@@ -508,6 +720,8 @@ void SV_AutoSaveBegin(const mapcmd_t *cmd)
     edict_t     *ent;
     int         i;
 
+    SV_FinishAutoSave();
+
     // check for clearing the current savegame
     if (cmd->endofunit) {
         wipe_save_dir(SAVE_CURRENT);
@@ -552,6 +766,8 @@ void SV_AutoSaveEnd(void)
 	if (SV_NoSaveGames())
 		return;
 
+    SV_FinishAutoSave();
+
 	// save the map just entered to include the player position (client edict shell)
 	if (write_level_file())
 	{
@@ -565,14 +781,8 @@ void SV_AutoSaveEnd(void)
         return;
     }
 
-    // clear whatever savegames are there
-    if (wipe_save_dir(SAVE_AUTO)) {
-        Com_EPrintf("Couldn't wipe '%s' directory.\n", SAVE_AUTO);
-        return;
-    }
-
     // copy off the level to the autosave slot
-    if (copy_save_dir(SAVE_CURRENT, SAVE_AUTO)) {
+    if (start_autosave()) {
         Com_EPrintf("Couldn't write '%s' directory.\n", SAVE_AUTO);
         return;
     }
@@ -670,6 +880,11 @@ static void SV_Loadgame_f(void)
         return;
     }
 
+    SV_FinishAutoSave();
+
+    if (!strcmp(dir, SAVE_AUTO))
+        recover_autosave();
+
     // make sure the server files exist
     if (!file_exists(va("%s/%s/%s/server.ssv", fs_gamedir, sv_savedir->string, dir)) ||
         !file_exists(va("%s/%s/%s/game.ssv", fs_gamedir, sv_savedir->string, dir))) {
@@ -732,6 +947,8 @@ static void SV_Savegame_f(void)
         return;
     }
 
+    SV_FinishAutoSave();
+
     // archive current level, including all client edicts.
     // when the level is reloaded, they will be shells awaiting
     // a connecting client
@@ -770,6 +987,7 @@ static const cmdreg_t c_savegames[] = {
 void SV_RegisterSavegames(void)
 {
     sv_noreload = Cvar_Get("sv_noreload", "0", 0);
+    sv_async_autosave = Cvar_Get("sv_async_autosave", "1", 0);
 
     Cmd_Register(c_savegames);
 	sv_savedir = Cvar_Get("sv_savedir", "save", 0);
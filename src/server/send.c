@@ -79,6 +79,7 @@ static bool SV_RateDrop(client_t *client)
                    client->framenum, client->name, total);
         client->frameflags |= FF_SUPPRESSED;
         client->suppress_count++;
+        client->suppress_total++;
         client->message_size[client->framenum % RATE_MESSAGES] = 0;
         return true;
     }
@@ -88,6 +89,11 @@ static bool SV_RateDrop(client_t *client)
 
 static void SV_CalcSendTime(client_t *client, size_t size)
 {
+    client->netstats.sent += size;
+    client->netstats.packets++;
+    svs.netstats.sent += size;
+    svs.netstats.packets++;
+
     // never drop over the loopback
     if (!client->rate) {
         client->send_time = svs.realtime;
@@ -397,7 +403,8 @@ unless told otherwise.
 */
 void SV_ClientAddMessage(client_t *client, int flags)
 {
-    int len;
+    byte    *data;
+    int     len;
 
     if (!msg_write.cursize) {
         return;
@@ -408,15 +415,23 @@ void SV_ClientAddMessage(client_t *client, int flags)
     }
 
     if ((flags & MSG_COMPRESS) && (len = compress_message(client)) && len < msg_write.cursize) {
-        client->AddMessage(client, get_compressed_data(), len, flags & MSG_RELIABLE);
+        data = get_compressed_data();
+        client->AddMessage(client, data, len, flags & MSG_RELIABLE);
         SV_DPrintf(0, "Compressed %sreliable message to %s: %zu into %d\n",
                    (flags & MSG_RELIABLE) ? "" : "un", client->name, msg_write.cursize, len);
     } else {
-        client->AddMessage(client, msg_write.data, msg_write.cursize, flags & MSG_RELIABLE);
+        data = msg_write.data;
+        len = msg_write.cursize;
+        client->AddMessage(client, data, len, flags & MSG_RELIABLE);
         SV_DPrintf(1, "Added %sreliable message to %s: %zu bytes\n",
                    (flags & MSG_RELIABLE) ? "" : "un", client->name, msg_write.cursize);
     }
 
+    // unreliables are accounted when written into datagram
+    if (flags & MSG_RELIABLE) {
+        SV_AccountBytes(client, data[0] & SVCMD_MASK, len);
+    }
+
     if (flags & MSG_CLEAR) {
         SZ_Clear(&msg_write);
     }
@@ -533,6 +548,7 @@ static bool check_entity(client_t *client, int entnum)
 // sounds reliative to entities are handled specially
 static void emit_snd(client_t *client, message_packet_t *msg)
 {
+    size_t start = msg_write.cursize;
     int flags, entnum;
     int i;
 
@@ -567,6 +583,8 @@ static void emit_snd(client_t *client, message_packet_t *msg)
             MSG_WriteShort(msg->pos[i]);
         }
     }
+
+    SV_AccountBytes(client, svc_sound, msg_write.cursize - start);
 }
 
 static inline void write_snd(client_t *client, message_packet_t *msg, size_t maxsize)
@@ -584,6 +602,7 @@ static inline void write_msg(client_t *client, message_packet_t *msg, size_t max
     // if this msg fits, write it
     if (msg_write.cursize + msg->cursize <= maxsize) {
         MSG_WriteData(msg->data, msg->cursize);
+        SV_AccountBytes(client, msg->data[0] & SVCMD_MASK, msg->cursize);
     }
     free_msg_packet(client, msg);
 }
@@ -981,6 +1000,7 @@ static void write_pending_download(client_t *client)
     SZ_WriteShort(buf, chunk);
     SZ_WriteByte(buf, client->downloadcount * 100 / client->downloadsize);
     SZ_Write(buf, client->download + client->downloadcount - chunk, chunk);
+    SV_AccountBytes(client, client->downloadcmd, chunk + 4);
 
     if (client->downloadcount == client->downloadsize) {
         SV_CloseDownload(client);
@@ -249,6 +249,18 @@ typedef struct {
 
 #define RATE_MESSAGES   10
 
+// bandwidth accounting buckets, svc_* opcodes are used as is
+#define NETSTAT_FRAME       svc_num_types           // frame header and playerstate
+#define NETSTAT_ENTITIES    (svc_num_types + 1)     // packet entities
+#define NETSTAT_COUNT       (svc_num_types + 2)
+
+typedef struct {
+    uint64_t    bytes[NETSTAT_COUNT];
+    unsigned    count[NETSTAT_COUNT];
+    uint64_t    sent;       // transmitted including netchan overhead
+    unsigned    packets;
+} netstats_t;
+
 #define FOR_EACH_CLIENT(client) \
     LIST_FOR_EACH(client_t, client, &sv_clientlist, entry)
 
@@ -314,6 +326,7 @@ typedef struct client_s {
 
     int             ping, min_ping, max_ping;
     int             avg_ping_time, avg_ping_count;
+    int             status_ping, status_frags;  // values in cached status reply
 
     // frame encoding
     client_frame_t  frames[UPDATE_BACKUP];    // updates can be delta'd from here
@@ -327,6 +340,10 @@ typedef struct client_s {
     // rate dropping
     unsigned        message_size[RATE_MESSAGES];    // used to rate drop normal packets
     int             suppress_count;                 // number of messages rate suppressed
+    unsigned        suppress_total;                 // for statistics
+
+    // bandwidth accounting
+    netstats_t      netstats;
     unsigned        send_time, send_delta;          // used to rate drop async packets
 
     // current download
@@ -498,6 +515,19 @@ typedef struct server_static_s {
     ratelimit_t     ratelimit_rcon;
 
     challenge_t     challenges[MAX_CHALLENGES]; // to prevent invalid IPs from connecting
+
+    netstats_t      netstats;       // totals for all clients
+    unsigned        last_netstats_dump;
+
+    // cached replies to connectionless queries, len == 0 means invalid
+    struct {
+        char        status[MAX_PACKETLEN_DEFAULT];
+        size_t      status_len;
+        int         status_show;    // sv_status_show value used
+        time_t      status_time;    // for uptime
+        char        info[MAX_QPATH + 10];
+        size_t      info_len;
+    } querycache;
 } server_static_t;
 
 //=============================================================================
@@ -559,6 +589,8 @@ extern cvar_t       *sv_status_show;
 extern cvar_t       *sv_auth_limit;
 extern cvar_t       *sv_rcon_limit;
 extern cvar_t       *sv_uptime;
+extern cvar_t       *sv_netstats_log;
+extern cvar_t       *sv_netstats_log_name;
 
 extern cvar_t       *sv_allow_unconnected_cmds;
 
@@ -573,6 +605,18 @@ extern edict_t      *sv_player;
 
 extern bool     sv_pending_autosave;
 
+// attributes len bytes of message type to the client and server totals
+static inline void SV_AccountBytes(client_t *client, int type, size_t len)
+{
+    if (type < 0 || type >= NETSTAT_COUNT)
+        type = svc_bad;
+
+    client->netstats.bytes[type] += len;
+    client->netstats.count[type]++;
+    svs.netstats.bytes[type] += len;
+    svs.netstats.count[type]++;
+}
+
 
 //===========================================================
 
@@ -594,6 +638,7 @@ void SV_RateInit(ratelimit_t *r, const char *s);
 addrmatch_t *SV_MatchAddress(list_t *list, netadr_t *address);
 
 int SV_CountClients(void);
+void SV_InvalidateQueryCache(void);
 
 #if USE_ZLIB
 voidpf SV_zalloc(voidpf opaque, uInt items, uInt size);
@@ -749,6 +794,7 @@ void SV_DelMatch_f(list_t *list);
 void SV_ListMatches_f(list_t *list);
 client_t *SV_GetPlayer(const char *s, bool partial);
 void SV_PrintMiscInfo(void);
+void SV_NetStatsFrame(void);
 
 //
 // sv_ents.c
@@ -772,12 +818,14 @@ void SV_ShutdownGameProgs(void);
 void SV_InitEdict(edict_t *e);
 
 void PF_Pmove(pmove_t *pm);
+void SV_PmoveTest_f(void);
 
 //
 // sv_save.c
 //
 void SV_AutoSaveBegin(const mapcmd_t *cmd);
 void SV_AutoSaveEnd(void);
+void SV_FinishAutoSave(void);
 void SV_CheckForSavegame(const mapcmd_t *cmd);
 void SV_CheckForEnhancedSavegames(void);
 void SV_RegisterSavegames(void);